@@ -38,12 +38,43 @@ build "\$builddir/include/generated/pga3d.h" gen_geometric_algebra "" --flags "-
 build "\$builddir/include/generated/cga2d.h" gen_geometric_algebra "" --flags "-p 3 -n 1 --binary meet outer_product --binary join regressive_product"
 build "\$builddir/include/generated/cga3d.h" gen_geometric_algebra "" --flags "-p 4 -n 1 --binary meet outer_product --binary join regressive_product"
 
+build "\$builddir/include/generated/pga2d_soa.h" gen_geometric_algebra "" --flags "-p 2 -d 1 --binary meet outer_product --binary join regressive_product --code m02 --simd"
+build "\$builddir/include/generated/pga3d_soa.h" gen_geometric_algebra "" --flags "-p 3 -d 1 --binary meet outer_product --binary join regressive_product --code m024 --simd"
+build "\$builddir/include/generated/cga2d_soa.h" gen_geometric_algebra "" --flags "-p 3 -n 1 --binary meet outer_product --binary join regressive_product --simd"
+build "\$builddir/include/generated/cga3d_soa.h" gen_geometric_algebra "" --flags "-p 4 -n 1 --binary meet outer_product --binary join regressive_product --simd"
+
+build "\$builddir/include/generated/pga2d_fixed.h" gen_geometric_algebra "" --flags "-p 2 -d 1 --binary meet outer_product --binary join regressive_product --code m02 --fixed"
+build "\$builddir/include/generated/pga3d_fixed.h" gen_geometric_algebra "" --flags "-p 3 -d 1 --binary meet outer_product --binary join regressive_product --code m024 --fixed"
+
 phony geometric_algebra_headers \
   --include-directory "\$builddir/include" \
   "\$builddir/include/generated/pga2d.h" \
   "\$builddir/include/generated/pga3d.h" \
   "\$builddir/include/generated/cga2d.h" \
-  "\$builddir/include/generated/cga3d.h"
+  "\$builddir/include/generated/cga3d.h" \
+  "\$builddir/include/generated/pga2d_soa.h" \
+  "\$builddir/include/generated/pga3d_soa.h" \
+  "\$builddir/include/generated/cga2d_soa.h" \
+  "\$builddir/include/generated/cga3d_soa.h" \
+  "\$builddir/include/generated/pga2d_fixed.h" \
+  "\$builddir/include/generated/pga3d_fixed.h"
+
+# times every operation of pga2d and pga3d, scalar, batch and fixed point, in ns per op.
+# ninja geometric_algebra_benchmarks writes the tables next to the programs
+build build/geometric_algebra_benchmark_pga2d.c gen_geometric_algebra "" --flags "-p 2 -d 1 --binary meet outer_product --binary join regressive_product --code m02 --benchmark"
+build build/geometric_algebra_benchmark_pga3d.c gen_geometric_algebra "" --flags "-p 3 -d 1 --binary meet outer_product --binary join regressive_product --code m024 --benchmark"
+
+executable geometric_algebra_benchmark_pga2d geometric_algebra_headers --cflag -O2 build/geometric_algebra_benchmark_pga2d.c
+executable geometric_algebra_benchmark_pga3d geometric_algebra_headers --cflag -O2 build/geometric_algebra_benchmark_pga3d.c
+
+rule run_benchmark --command "\$in > \$out"
+
+build "\$builddir/geometric_algebra_benchmark_pga2d.txt" run_benchmark "\$builddir/geometric_algebra_benchmark_pga2d"
+build "\$builddir/geometric_algebra_benchmark_pga3d.txt" run_benchmark "\$builddir/geometric_algebra_benchmark_pga3d"
+
+phony geometric_algebra_benchmarks \
+  "\$builddir/geometric_algebra_benchmark_pga2d.txt" \
+  "\$builddir/geometric_algebra_benchmark_pga3d.txt"
 
 per_platform library ___-mir \
   --include-directory "third_party/mir" \
@@ -64,14 +95,19 @@ per_platform executable ___-city_of_shadows \
   src/configuration.c \
   src/display.c \
   src/draw.c \
+  src/draw_command.c \
   src/draw_screen.c \
+  src/draw_visibility.c \
   src/ecs_archetype.c \
   src/ecs.c \
   src/ecs_component.c \
+  src/ecs_delta.c \
   src/ecs_entity.c \
   src/ecs_layer.c \
   src/ecs_memory.c \
+  src/ecs_prefab.c \
   src/ecs_query.c \
+  src/ecs_resource.c \
   src/font.c \
   src/font-breeserif.c \
   src/format.c \
@@ -85,12 +121,17 @@ per_platform executable ___-city_of_shadows \
   src/game_terrain.c \
   src/gl.c \
   src/image.c \
+  src/image_atlas.c \
   src/input.c \
   src/log.c \
   src/main.c \
   src/memory.c \
   src/physics.c \
+  src/physics_collision.c \
+  src/physics_sleep.c \
+  src/physics_solver.c \
   src/platform.c \
+  src/profile.c \
   src/read.c \
   src/render.c \
   src/resource.c \
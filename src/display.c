@@ -3,6 +3,7 @@
 #include "configuration.h"
 #include "render.h"
 #include "platform.h"
+#include "profile.h"
 
 #define GLAD_GL_IMPLEMENTATION
 
@@ -74,6 +75,7 @@ static bool _iterate(void) {
   }
 
   glfwSwapBuffers(glfw_window);
+  profile_frame();
 
   return true;
 }
@@ -148,6 +150,7 @@ bool display_initialize(void) {
 }
 
 void display_shutdown(void) {
+  profile_shutdown();
   render_shutdown();
 }
 
@@ -7,6 +7,12 @@
 #include "display.h"
 #include "font.h"
 #include "resource.h"
+#include "platform.h"
+#include "profile.h"
+#include "configuration.h"
+#include "vector.h"
+
+#define SOURCE_NAMESPACE core.draw
 
 ECS_COMPONENT(DrawRectangle)
 ECS_COMPONENT(DrawCircle)
@@ -14,10 +20,65 @@ ECS_COMPONENT(DrawText)
 ECS_COMPONENT(Sprite)
 
 // ====================================================================================================================
-static void _draw_sprite(const struct LocalToWorld2D *t, const struct Sprite *s) {
-  struct LoadedResource *res = LoadedResource_from_image(s->image);
+// recording
+//
+// the visible entities of a camera are read into records on the GL thread,
+// queries are not safe to run on several threads. the workers then build the
+// vertexes and instances of page ranges of records into their command lists,
+// the record index is the sequence so the result is the same for any number of
+// workers
+#define RECORD_GRAIN 256
+
+// record sprites and shapes on the worker threads
+static CONFIGURATION_BOOLEAN(SOURCE_NAMESPACE, parallel_recording, true);
+
+typedef struct {
+  enum draw_Visible kind;
+  struct GraphicsImage * image;
+  const struct LocalToWorld2D * transform;
+  const void * component;
+} _Record;
+
+static Vector(_Record) _records;
+
+static void _push_record(enum draw_Visible kind, struct GraphicsImage * image, const struct LocalToWorld2D * t, const void * component) {
+  Vector_space_for(&_records, 1);
+  *Vector_push(&_records) = (_Record) { .kind = kind, .image = image, .transform = t, .component = component };
+}
+
+// images load on first use, which needs the GL thread
+ECS_QUERY(_read_sprites
+  , read(LocalToWorld2D, t)
+  , read(Sprite, s)
+  , action(
+    (void)state;
+    _push_record(draw_Visible_sprite, &LoadedResource_from_image(s->image)->image, t, s);
+  )
+)
+
+ECS_QUERY(_read_rectangles
+  , read(LocalToWorld2D, t)
+  , read(DrawRectangle, r)
+  , action(
+    (void)state;
+    _push_record(draw_Visible_rectangle, NULL, t, r);
+  )
+)
+
+ECS_QUERY(_read_circles
+  , read(LocalToWorld2D, t)
+  , read(DrawCircle, c)
+  , action(
+    (void)state;
+    _push_record(draw_Visible_circle, NULL, t, c);
+  )
+)
+
+static void _record_sprite(struct draw_CommandList * list, const _Record * record, uint32_t sequence) {
+  const struct LocalToWorld2D * t = record->transform;
+  const struct Sprite * s = record->component;
 
-  R hw = res->image.width / 2, hh = res->image.height / 2, bl = -hw, br = hw, bt = -hh, bb = hh;
+  R hw = record->image->width / 2, hh = record->image->height / 2, bl = -hw, br = hw, bt = -hh, bb = hh;
 
   pga2d_Point box[] = {pga2d_point(br, bb), pga2d_point(br, bt), pga2d_point(bl, bt),
                              pga2d_point(bl, bb)};
@@ -27,137 +88,108 @@ static void _draw_sprite(const struct LocalToWorld2D *t, const struct Sprite *s)
   box[2] = pga2d_sandwich_bm(box[2], t->motor);
   box[3] = pga2d_sandwich_bm(box[3], t->motor);
 
-  uint32_t *indexes;
-  struct draw_ScreenVertex *vertexes;
-  draw_ScreenVertex_begin_draw(6, &indexes, 4, &vertexes);
+  // the sprite's coordinates are within its image, the image may be a part of an atlas page
+  const struct GraphicsImage * image = record->image;
+  R s0 = image->s0 + s->s0 * (image->s1 - image->s0), s1 = image->s0 + s->s1 * (image->s1 - image->s0);
+  R t0 = image->t0 + s->t0 * (image->t1 - image->t0), t1 = image->t0 + s->t1 * (image->t1 - image->t0);
+
+  struct draw_ScreenVertex * vertexes = draw_record_sprite(list, record->image, sequence);
 
   vertexes[0] = (struct draw_ScreenVertex){.xy = {pga2d_point_x(box[0]), pga2d_point_y(box[0])},
                                       .rgba = {s->color.r, s->color.g, s->color.b, s->color.a},
-                                      .st = {s->s1, s->t1}};
+                                      .st = {s1, t1}};
   vertexes[1] = (struct draw_ScreenVertex){.xy = {pga2d_point_x(box[1]), pga2d_point_y(box[1])},
                                       .rgba = {s->color.r, s->color.g, s->color.b, s->color.a},
-                                      .st = {s->s1, s->t0}};
+                                      .st = {s1, t0}};
   vertexes[2] = (struct draw_ScreenVertex){.xy = {pga2d_point_x(box[2]), pga2d_point_y(box[2])},
                                       .rgba = {s->color.r, s->color.g, s->color.b, s->color.a},
-                                      .st = {s->s0, s->t0}};
+                                      .st = {s0, t0}};
   vertexes[3] = (struct draw_ScreenVertex){.xy = {pga2d_point_x(box[3]), pga2d_point_y(box[3])},
                                       .rgba = {s->color.r, s->color.g, s->color.b, s->color.a},
-                                      .st = {s->s0, s->t1}};
-
-  indexes[0] = 0;
-  indexes[1] = 1;
-  indexes[2] = 2;
-  indexes[3] = 0;
-  indexes[4] = 2;
-  indexes[5] = 3;
-
-  draw_ScreenVertex_draw(&res->image, 0, 6);
-  draw_ScreenVertex_end_draw();
+                                      .st = {s0, t1}};
 }
 
-ECS_QUERY(_draw_sprites
-  , read(LocalToWorld2D, t)
-  , read(Sprite, s)
-  , action(
-    (void)state;
-    _draw_sprite(t, s);
-  )
-)
+// one instance each, expanded from the unit meshes on the GPU
+static void _record_rectangle(struct draw_CommandList * list, const _Record * record, uint32_t sequence) {
+  const struct LocalToWorld2D * t = record->transform;
+  const struct DrawRectangle * r = record->component;
 
-// ====================================================================================================================
-static void _draw_rectangle_action(const struct LocalToWorld2D *t, const struct DrawRectangle *r) {
- R
-      hw = r->width / 2
-    , hh = r->height / 2
-    , bl = -hw
-    , br =  hw
-    , bt = -hh
-    , bb =  hh
-    ;
-  pga2d_Point box[] = {
-      pga2d_point(br, bb)
-    , pga2d_point(br, bt)
-    , pga2d_point(bl, bt)
-    , pga2d_point(bl, bb)
+  pga2d_Direction x_axis = pga2d_sandwich_bm(pga2d_direction(1, 0), t->motor);
+  pga2d_Direction y_axis = pga2d_sandwich_bm(pga2d_direction(0, 1), t->motor);
+
+  *draw_record_shape(list, draw_Shape_rectangle, sequence) = (struct draw_ShapeInstance) {
+      .xy = {pga2d_point_x(t->position), pga2d_point_y(t->position)}
+    , .x_axis = {pga2d_direction_x(x_axis), pga2d_direction_y(x_axis)}
+    , .y_axis = {pga2d_direction_x(y_axis), pga2d_direction_y(y_axis)}
+    , .size = {r->width, r->height}
+    , .rgba = {r->color.r, r->color.g, r->color.b, r->color.a}
     };
-  box[0] = pga2d_sandwich_bm(box[0], t->motor);
-  box[1] = pga2d_sandwich_bm(box[1], t->motor);
-  box[2] = pga2d_sandwich_bm(box[2], t->motor);
-  box[3] = pga2d_sandwich_bm(box[3], t->motor);
-  uint32_t * indexes;
-  struct draw_ScreenVertex * vertexes;
-  draw_ScreenVertex_begin_draw(6, &indexes, 4, &vertexes);
-  vertexes[0] = (struct draw_ScreenVertex) { .xy[0] = pga2d_point_x(box[0]), .xy[1] = pga2d_point_y(box[0]), .rgba = { r->color.r, r->color.g, r->color.b, r->color.a } };
-  vertexes[1] = (struct draw_ScreenVertex) { .xy[0] = pga2d_point_x(box[1]), .xy[1] = pga2d_point_y(box[1]), .rgba = { r->color.r, r->color.g, r->color.b, r->color.a } };
-  vertexes[2] = (struct draw_ScreenVertex) { .xy[0] = pga2d_point_x(box[2]), .xy[1] = pga2d_point_y(box[2]), .rgba = { r->color.r, r->color.g, r->color.b, r->color.a } };
-  vertexes[3] = (struct draw_ScreenVertex) { .xy[0] = pga2d_point_x(box[3]), .xy[1] = pga2d_point_y(box[3]), .rgba = { r->color.r, r->color.g, r->color.b, r->color.a } };
-  indexes[0] = 0;
-  indexes[1] = 1;
-  indexes[2] = 2;
-  indexes[3] = 0;
-  indexes[4] = 2;
-  indexes[5] = 3;
-  draw_ScreenVertex_draw(NULL, 0, 6);
-  draw_ScreenVertex_end_draw();
 }
 
-ECS_QUERY(_draw_rectangles
-  , read(LocalToWorld2D, t)
-  , read(DrawRectangle, r)
-  , action(
-    (void)state;
-    _draw_rectangle_action(t, r);
-  )
-)
+// circles do not turn with their body
+static void _record_circle(struct draw_CommandList * list, const _Record * record, uint32_t sequence) {
+  const struct LocalToWorld2D * t = record->transform;
+  const struct DrawCircle * c = record->component;
+
+  *draw_record_shape(list, draw_Shape_circle, sequence) = (struct draw_ShapeInstance) {
+      .xy = {pga2d_point_x(t->position), pga2d_point_y(t->position)}
+    , .x_axis = {1, 0}
+    , .y_axis = {0, 1}
+    , .size = {c->radius, c->radius}
+    , .rgba = {c->color.r, c->color.g, c->color.b, c->color.a}
+    };
+}
 
-// ====================================================================================================================
-static void _draw_circle(float x, float y, float radius, Color color) {
-#define NUM_CIRCLE_SEGMENTS 32
-
-  struct draw_ScreenVertex * vertexes;
-  uint32_t * indexes;
-
-  draw_ScreenVertex_begin_draw(3 * (NUM_CIRCLE_SEGMENTS - 2), &indexes, NUM_CIRCLE_SEGMENTS, &vertexes);
-
-  for(uint32_t i = 0; i < NUM_CIRCLE_SEGMENTS; i++) {
-    R angle = (R)i / NUM_CIRCLE_SEGMENTS * R_PI * 2;
-    R s = R_sin(angle);
-    R c = R_cos(angle);
-    vertexes[i].xy[0] = x + s * radius;
-    vertexes[i].xy[1] = y + c * radius;
-    vertexes[i].rgba[0] = color.r;
-    vertexes[i].rgba[1] = color.g;
-    vertexes[i].rgba[2] = color.b;
-    vertexes[i].rgba[3] = color.a;
-    vertexes[i].st[0] = 0;
-    vertexes[i].st[1] = 0;
-
-    if(i >= 2) {
-      indexes[(i - 2) * 3 + 0] = 0;
-      indexes[(i - 2) * 3 + 1] = i - 1;
-      indexes[(i - 2) * 3 + 2] = i - 0;
+static void _record(void * user_data, uint32_t worker, uint32_t begin, uint32_t end) {
+  (void)user_data;
+
+  struct draw_CommandList * list = draw_command_list(worker);
+  for(uint32_t i = begin; i < end; i++) {
+    const _Record * record = &_records.data[i];
+    switch(record->kind) {
+    case draw_Visible_sprite:
+      _record_sprite(list, record, i);
+      break;
+    case draw_Visible_rectangle:
+      _record_rectangle(list, record, i);
+      break;
+    case draw_Visible_circle:
+      _record_circle(list, record, i);
+      break;
+    default:
+      break;
     }
   }
+}
 
-  draw_ScreenVertex_draw(NULL, 0, 3 * (NUM_CIRCLE_SEGMENTS - 2));
-  draw_ScreenVertex_end_draw();
+static void _draw_records(void) {
+  uint32_t num_visible;
+  const ecs_EntityHandle * visible;
+
+  _records.length = 0;
+  visible = draw_visible(draw_Visible_sprite, &num_visible);
+  _read_sprites_for(visible, num_visible);
+  visible = draw_visible(draw_Visible_rectangle, &num_visible);
+  _read_rectangles_for(visible, num_visible);
+  visible = draw_visible(draw_Visible_circle, &num_visible);
+  _read_circles_for(visible, num_visible);
+
+  draw_commands_begin();
+
+  uint32_t length = _records.length;
+  if(parallel_recording) {
+    platform_parallel_for(length, RECORD_GRAIN, _record, NULL);
+  } else {
+    _record(NULL, 0, 0, length);
+  }
 
-#undef NUM_CIRCLE_SEGMENTS
+  draw_commands_submit();
 }
 
-ECS_QUERY(_draw_circles
-  , read(LocalToWorld2D, transform)
-  , read(DrawCircle, c)
-  , action(
-    (void)state;
-    _draw_circle(pga2d_point_x(transform->position), pga2d_point_y(transform->position), c->radius, c->color);
-  )
-)
-
 // ====================================================================================================================
 extern struct Font BreeSerif;
 
-ECS_QUERY(_draw_text
+ECS_QUERY(_draw_text_entities
   , read(LocalToWorld2D, w)
   , read(DrawText, t)
   , action(
@@ -166,8 +198,43 @@ ECS_QUERY(_draw_text
   )
 )
 
+static void _draw_text(void) {
+  draw_layer = draw_Layer_text;
+
+  uint32_t num_visible;
+  const ecs_EntityHandle * visible = draw_visible(draw_Visible_text, &num_visible);
+  _draw_text_entities_for(visible, num_visible);
+}
+
 // ====================================================================================================================
-static void _draw_frame_action(const struct LocalToWorld2D * transform, const struct Camera * camera, uint32_t r_width, uint32_t r_height) {
+// the world rectangle the view projection maps onto the viewport, the corners
+// of clip space taken back through the inverse of its 2D part
+static void _view_bounds(R * min_x, R * min_y, R * max_x, R * max_y) {
+  float m[16];
+  matrix_multiply(draw_projection_matrix.uniform.data.mat, draw_view_matrix.uniform.data.mat, m);
+
+  // nothing sensible comes back through a singular projection, as on a frame
+  // before the camera set one, the view is unbounded then
+  float determinant = m[0] * m[5] - m[4] * m[1];
+  if(determinant == 0 || !isfinite(determinant)) {
+    *min_x = *min_y = -R_MAX;
+    *max_x = *max_y = R_MAX;
+    return;
+  }
+  *min_x = *min_y = R_MAX;
+  *max_x = *max_y = -R_MAX;
+  for(uint32_t i = 0; i < 4; i++) {
+    float cx = (i & 1 ? 1 : -1) - m[12], cy = (i & 2 ? 1 : -1) - m[13];
+    float x = (m[5] * cx - m[4] * cy) / determinant;
+    float y = (m[0] * cy - m[1] * cx) / determinant;
+    *min_x = min(*min_x, x);
+    *min_y = min(*min_y, y);
+    *max_x = max(*max_x, x);
+    *max_y = max(*max_y, y);
+  }
+}
+
+static void _draw_frame_action(ecs_EntityHandle entity, const struct LocalToWorld2D * transform, const struct Camera * camera, uint32_t r_width, uint32_t r_height) {
   int x = pga2d_point_x(camera->viewport_min) * r_width;
   int y = pga2d_point_y(camera->viewport_min) * r_height;
   int width = (pga2d_point_x(camera->viewport_max) * r_width) - x;
@@ -198,10 +265,17 @@ static void _draw_frame_action(const struct LocalToWorld2D * transform, const st
   glClearColor(0, 0, 0, 1);
   glClear(GL_COLOR_BUFFER_BIT);
 
-  _draw_sprites();
-  _draw_rectangles();
-  _draw_circles();
+  R min_x, min_y, max_x, max_y;
+  _view_bounds(&min_x, &min_y, &max_x, &max_y);
+  draw_visibility_query(entity, min_x, min_y, max_x, max_y);
+
+  profile_begin("draw_records");
+  _draw_records();
+  profile_end();
   _draw_text();
+
+  // before the next camera sets its viewport and matrices
+  gl_submitDraws();
 }
 
 ECS_QUERY(_draw_frame
@@ -216,18 +290,28 @@ ECS_QUERY(_draw_frame
     glClearColor(0.9, 0.9, 0.9, 1);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    gl_resetTemporaryBuffers();
+    gl_beginFrame();
+    draw_visibility_build();
+
+    draw_stats = draw_frame_stats;
+    memory_clear(&draw_frame_stats, sizeof(draw_frame_stats));
   )
   , action(
     (void)state;
-    _draw_frame_action(transform, camera, state->width, state->height);
+    profile_begin_gl("draw_camera");
+    _draw_frame_action(entity, transform, camera, state->width, state->height);
+    profile_end();
   )
   , post(
     matrix_ortho(0, state->width, state->height, 0, -99999, 99999, draw_projection_matrix.uniform.data.mat);
     matrix_identity(draw_view_matrix.uniform.data.mat);
     glViewport(0, 0, state->width, state->height);
 
+    profile_begin_gl("ui_iterate");
+    draw_layer = draw_Layer_ui;
     ui_iterate();
+    gl_submitDraws();
+    profile_end();
   )
 )
 
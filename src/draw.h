@@ -22,11 +22,88 @@ extern struct gl_ShaderResource draw_projection_matrix;
 extern struct gl_ShaderResource draw_view_projection_matrix;
 extern struct gl_ShaderResource draw_model_view_projection_matrix;
 
+// counted through a frame. draw_stats is the last whole frame, draw_frame_stats
+// the one in progress
+struct draw_Stats {
+  uint32_t draw_calls;
+  uint32_t vertexes;
+  uint32_t sprites;
+  uint32_t sprite_batches;
+  uint32_t shape_instances;
+  uint32_t commands;
+};
+
+extern struct draw_Stats draw_stats;
+extern struct draw_Stats draw_frame_stats;
+
+// draws are queued with gl_queueDrawElements and go out on gl_submitDraws,
+// grouped by state within the sprite and shape layers, in the order they were
+// drawn within text and ui. layers go out in this order
+enum draw_Layer { draw_Layer_sprites, draw_Layer_rectangles, draw_Layer_circles, draw_Layer_text, draw_Layer_ui };
+
+extern enum draw_Layer draw_layer;
+
 void draw_ScreenVertex_begin_draw(uint32_t num_indexes, uint32_t **indexes_ptr, uint32_t num_vertexes,
                                      struct draw_ScreenVertex **vertexes_ptr);
 void draw_ScreenVertex_draw(struct GraphicsImage * image, uint32_t index_offset, uint32_t num_indexes);
 void draw_ScreenVertex_end_draw(void);
 
+// one instance of a unit mesh, placed at xy along the two axes and scaled by
+// size. a rectangle is the unit quad around its center, a circle the unit
+// circle
+struct draw_ShapeInstance {
+  float xy[2];
+  float x_axis[2];
+  float y_axis[2];
+  float size[2];
+  float rgba[4];
+};
+
+enum draw_Shape { draw_Shape_rectangle, draw_Shape_circle, NUM_DRAW_SHAPES };
+
+void draw_shapes(enum draw_Shape shape, const struct draw_ShapeInstance * instances, uint32_t num_instances);
+
+// recorded draws, replayed by draw_commands_submit in key order. workers of
+// platform_parallel_for record into draw_command_list(worker) between
+// draw_commands_begin and draw_commands_submit, both on the GL thread. the
+// sequence orders draws of one kind and texture
+enum draw_CommandKind { draw_Command_sprite, draw_Command_rectangle, draw_Command_circle };
+
+struct draw_Command {
+  uint64_t key;
+  uint32_t list;
+  uint32_t first;
+  struct GraphicsImage * image;
+};
+
+struct draw_CommandList;
+
+void draw_commands_begin(void);
+struct draw_CommandList * draw_command_list(uint32_t worker);
+
+// the four corners to fill in, in the order of draw_ScreenVertex quads
+struct draw_ScreenVertex * draw_record_sprite(struct draw_CommandList * list, struct GraphicsImage * image, uint32_t sequence);
+struct draw_ShapeInstance * draw_record_shape(struct draw_CommandList * list, enum draw_Shape shape, uint32_t sequence);
+
+void draw_commands_submit(void);
+
+// drawables sorted into a grid once a frame, draw_visibility_query collects the
+// ones inside a world rectangle for draw_visible
+enum draw_Visible { draw_Visible_sprite, draw_Visible_rectangle, draw_Visible_circle, draw_Visible_text, NUM_DRAW_VISIBLE };
+
+struct draw_CameraVisibility {
+  ecs_EntityHandle camera;
+  uint32_t visible;
+  uint32_t culled;
+};
+
+void draw_visibility_build(void);
+void draw_visibility_query(ecs_EntityHandle camera, R min_x, R min_y, R max_x, R max_y);
+const ecs_EntityHandle * draw_visible(enum draw_Visible kind, uint32_t * count);
+
+// one per camera drawn this frame, in draw order
+const struct draw_CameraVisibility * draw_camera_visibility(uint32_t * count);
+
 ECS_DECLARE_COMPONENT(DrawRectangle, {
   float width;
   float height;
@@ -0,0 +1,172 @@
+#include "draw.h"
+
+#include "platform.h"
+#include "vector.h"
+
+// ====================================================================================================================
+// command lists
+//
+// one list per worker of platform_parallel_for, a worker only ever appends to
+// its own. nothing here touches GL until draw_commands_submit, which runs on
+// the GL thread after the workers are done
+struct draw_CommandList {
+  uint32_t index;
+  Vector(struct draw_Command) commands;
+  Vector(struct draw_ScreenVertex) vertexes;
+  Vector(struct draw_ShapeInstance) instances;
+};
+
+static struct {
+  uint32_t num_lists;
+  struct draw_CommandList * lists;
+
+  // every list merged and sorted by key
+  Vector(struct draw_Command) sorted;
+  Vector(struct draw_ShapeInstance) instances;
+} _commands;
+
+static int _compare_command(const void * ap, const void * bp, void * ud) {
+  const struct draw_Command * a = (const struct draw_Command *)ap;
+  const struct draw_Command * b = (const struct draw_Command *)bp;
+  return a->key < b->key ? -1 : a->key > b->key;
+}
+
+// kind first so everything of a kind replays together, then the texture so a
+// run of one texture is one draw, then the sequence the caller recorded with so
+// the result does not depend on which worker took which range
+static inline uint64_t _key(enum draw_CommandKind kind, uint32_t texture, uint32_t sequence) {
+  return (uint64_t)kind << 56 | (uint64_t)(texture & 0xFFFFFF) << 32 | sequence;
+}
+
+void draw_commands_begin(void) {
+  uint32_t count = platform_worker_count();
+  if(count > _commands.num_lists) {
+    _commands.lists = memory_realloc(_commands.lists, sizeof(*_commands.lists) * _commands.num_lists, sizeof(*_commands.lists) * count, alignof(struct draw_CommandList));
+    memory_clear(_commands.lists + _commands.num_lists, sizeof(*_commands.lists) * (count - _commands.num_lists));
+    _commands.num_lists = count;
+  }
+  for(uint32_t i = 0; i < _commands.num_lists; i++) {
+    _commands.lists[i].index = i;
+    _commands.lists[i].commands.length = 0;
+    _commands.lists[i].vertexes.length = 0;
+    _commands.lists[i].instances.length = 0;
+  }
+}
+
+struct draw_CommandList * draw_command_list(uint32_t worker) {
+  return &_commands.lists[worker];
+}
+
+struct draw_ScreenVertex * draw_record_sprite(struct draw_CommandList * list, struct GraphicsImage * image, uint32_t sequence) {
+  Vector_space_for(&list->commands, 1);
+  *Vector_push(&list->commands) = (struct draw_Command) {
+      .key = _key(draw_Command_sprite, image->gl.image, sequence)
+    , .list = list->index
+    , .first = list->vertexes.length
+    , .image = image
+    };
+
+  Vector_space_for(&list->vertexes, 4);
+  struct draw_ScreenVertex * vertexes = list->vertexes.data + list->vertexes.length;
+  list->vertexes.length += 4;
+  return vertexes;
+}
+
+struct draw_ShapeInstance * draw_record_shape(struct draw_CommandList * list, enum draw_Shape shape, uint32_t sequence) {
+  enum draw_CommandKind kind = shape == draw_Shape_rectangle ? draw_Command_rectangle : draw_Command_circle;
+  Vector_space_for(&list->commands, 1);
+  *Vector_push(&list->commands) = (struct draw_Command) {
+      .key = _key(kind, 0, sequence)
+    , .list = list->index
+    , .first = list->instances.length
+    };
+
+  Vector_space_for(&list->instances, 1);
+  return Vector_push(&list->instances);
+}
+
+// ====================================================================================================================
+// replay
+static uint32_t _submit_sprites(const struct draw_Command * commands, uint32_t count) {
+  uint32_t n = 0;
+  while(n < count && commands[n].key >> 56 == draw_Command_sprite) {
+    n++;
+  }
+  if(n == 0) {
+    return 0;
+  }
+
+  uint32_t *indexes;
+  struct draw_ScreenVertex *vertexes;
+  draw_layer = draw_Layer_sprites;
+  draw_ScreenVertex_begin_draw(6 * n, &indexes, 4 * n, &vertexes);
+
+  for(uint32_t i = 0; i < n; i++) {
+    const struct draw_CommandList * list = &_commands.lists[commands[i].list];
+    memory_copy(vertexes + 4 * i, 4 * sizeof(*vertexes), list->vertexes.data + commands[i].first, 4 * sizeof(*vertexes));
+
+    indexes[6 * i + 0] = 4 * i + 0;
+    indexes[6 * i + 1] = 4 * i + 1;
+    indexes[6 * i + 2] = 4 * i + 2;
+    indexes[6 * i + 3] = 4 * i + 0;
+    indexes[6 * i + 4] = 4 * i + 2;
+    indexes[6 * i + 5] = 4 * i + 3;
+  }
+
+  uint32_t first = 0;
+  for(uint32_t i = 1; i <= n; i++) {
+    if(i < n && commands[i].image->gl.image == commands[first].image->gl.image) {
+      continue;
+    }
+    draw_ScreenVertex_draw(commands[first].image, 6 * first, 6 * (i - first));
+    draw_frame_stats.sprite_batches++;
+    first = i;
+  }
+
+  draw_ScreenVertex_end_draw();
+
+  draw_frame_stats.sprites += n;
+  return n;
+}
+
+static uint32_t _submit_shapes(const struct draw_Command * commands, uint32_t count, enum draw_CommandKind kind, enum draw_Shape shape, enum draw_Layer layer) {
+  uint32_t n = 0;
+  while(n < count && commands[n].key >> 56 == kind) {
+    n++;
+  }
+
+  _commands.instances.length = 0;
+  Vector_space_for(&_commands.instances, n);
+  for(uint32_t i = 0; i < n; i++) {
+    const struct draw_CommandList * list = &_commands.lists[commands[i].list];
+    *Vector_push(&_commands.instances) = list->instances.data[commands[i].first];
+  }
+  draw_layer = layer;
+  draw_shapes(shape, _commands.instances.data, n);
+  return n;
+}
+
+void draw_commands_submit(void) {
+  _commands.sorted.length = 0;
+  for(uint32_t i = 0; i < _commands.num_lists; i++) {
+    const struct draw_CommandList * list = &_commands.lists[i];
+    if(list->commands.length == 0) {
+      continue;
+    }
+    Vector_space_for(&_commands.sorted, list->commands.length);
+    memory_copy(_commands.sorted.data + _commands.sorted.length, sizeof(struct draw_Command) * list->commands.length, list->commands.data, sizeof(struct draw_Command) * list->commands.length);
+    _commands.sorted.length += list->commands.length;
+  }
+
+  uint32_t count = _commands.sorted.length;
+  if(count == 0) {
+    return;
+  }
+  Vector_qsort(&_commands.sorted, _compare_command, NULL);
+  draw_frame_stats.commands += count;
+
+  const struct draw_Command * commands = _commands.sorted.data;
+  uint32_t done = _submit_sprites(commands, count);
+  done += _submit_shapes(commands + done, count - done, draw_Command_rectangle, draw_Shape_rectangle, draw_Layer_rectangles);
+  _submit_shapes(commands + done, count - done, draw_Command_circle, draw_Shape_circle, draw_Layer_circles);
+}
@@ -55,6 +55,20 @@ GL_SHADER_INSTANCE(draw_ScreenVertex_fragment,
   )
 )
 
+struct draw_Stats draw_stats;
+struct draw_Stats draw_frame_stats;
+
+enum draw_Layer draw_layer;
+
+// text and ui paint over what came before them in the same layer, they keep
+// the order they were drawn in. the layers below group by state
+static uint64_t _draw_key(const struct gl_DrawState * state, const struct gl_DrawAssets * assets) {
+  if(draw_layer >= draw_Layer_text) {
+    return gl_drawKey(draw_layer, NULL, NULL, 0);
+  }
+  return gl_drawKey(draw_layer, state, assets, 0);
+}
+
 static struct gl_Buffer _ScreenVertex_element_buffer;
 static struct gl_Buffer _ScreenVertex_vertexes_buffer;
 static struct gl_DrawState _ScreenVertex_draw_state = {
@@ -82,17 +96,123 @@ void draw_ScreenVertex_begin_draw(uint32_t num_indexes, uint32_t **indexes_ptr,
 
   *indexes_ptr = _ScreenVertex_element_buffer.mapping;
   *vertexes_ptr = _ScreenVertex_vertexes_buffer.mapping;
+
+  draw_frame_stats.vertexes += num_vertexes;
 }
 
 void draw_ScreenVertex_draw(struct GraphicsImage * image, uint32_t index_offset, uint32_t num_indexes) {
-  gl_drawElements(&_ScreenVertex_draw_state, &(struct gl_DrawAssets){
-    .image[0] = image->gl.image,
+  struct gl_DrawAssets assets = {
+    .image[0] = image != NULL ? image->gl.image : 0,
     .element_buffer = &_ScreenVertex_element_buffer,
     .element_buffer_offset = index_offset,
     .vertex_buffers[0] = &_ScreenVertex_vertexes_buffer
-  }, num_indexes, 1, 0, 0);
+  };
+  gl_queueDrawElements(_draw_key(&_ScreenVertex_draw_state, &assets), &_ScreenVertex_draw_state, &assets,
+                       num_indexes, 1, 0, 0);
+
+  draw_frame_stats.draw_calls++;
 }
 
 void draw_ScreenVertex_end_draw(void) {
 }
 
+
+// --------------------------------------------------------------------------------------------------------------------
+// instanced shapes, the meshes live on the GPU and only the instances are uploaded
+#define NUM_CIRCLE_SEGMENTS 32
+
+GL_SHADER_INSTANCE(draw_ShapeInstance_vertex,
+  code(
+    layout(location = 0) out vec4 out_rgba;
+  ),
+  main(
+    vec2 p = in_unit * in_size;
+    gl_Position = u_view_projection_matrix * vec4(in_xy + in_x_axis * p.x + in_y_axis * p.y, 0, 1);
+    out_rgba = in_rgba;
+  )
+)
+
+GL_SHADER_INSTANCE(draw_ShapeInstance_fragment,
+  code(
+    layout(location = 0) in vec4 in_rgba;
+
+    layout(location = 0) out vec4 out_color;
+  ),
+  main(
+    out_color = in_rgba;
+  )
+)
+
+static struct gl_DrawState _ShapeInstance_draw_state = {
+  .primitive = GL_TRIANGLES,
+  .attribute[0] = {0, memory_Format_Float32, 2, "unit", 0},
+  .attribute[1] = {1, memory_Format_Float32, 2, "xy", 0},
+  .attribute[2] = {1, memory_Format_Float32, 2, "x_axis", 8},
+  .attribute[3] = {1, memory_Format_Float32, 2, "y_axis", 16},
+  .attribute[4] = {1, memory_Format_Float32, 2, "size", 24},
+  .attribute[5] = {1, memory_Format_Float32, 4, "rgba", 32},
+  .binding[0] = {sizeof(float) * 2},
+  .binding[1] = {sizeof(struct draw_ShapeInstance), 1},
+  .global[0] = {GL_VERTEX_BIT, &draw_view_projection_matrix},
+  .vertex_shader = &draw_ShapeInstance_vertex_shader,
+  .fragment_shader = &draw_ShapeInstance_fragment_shader,
+  .depth_range_min = 0,
+  .depth_range_max = 1,
+  .blend_enable = true,
+  .blend_src_factor = GL_SRC_ALPHA,
+  .blend_dst_factor = GL_ONE_MINUS_SRC_ALPHA};
+
+static struct {
+  struct gl_Buffer vertexes;
+  struct gl_Buffer indexes;
+  uint32_t num_indexes;
+} _shape_mesh[NUM_DRAW_SHAPES];
+
+static void _shape_mesh_initialize(void) {
+  float quad[] = {0.5f, 0.5f, 0.5f, -0.5f, -0.5f, -0.5f, -0.5f, 0.5f};
+  uint32_t quad_indexes[] = {0, 1, 2, 0, 2, 3};
+  _shape_mesh[draw_Shape_rectangle].vertexes = gl_allocateStaticBuffer(GL_ARRAY_BUFFER, sizeof(quad), quad);
+  _shape_mesh[draw_Shape_rectangle].indexes = gl_allocateStaticBuffer(GL_ELEMENT_ARRAY_BUFFER, sizeof(quad_indexes), quad_indexes);
+  _shape_mesh[draw_Shape_rectangle].num_indexes = 6;
+
+  float circle[NUM_CIRCLE_SEGMENTS * 2];
+  uint32_t circle_indexes[3 * (NUM_CIRCLE_SEGMENTS - 2)];
+  for(uint32_t i = 0; i < NUM_CIRCLE_SEGMENTS; i++) {
+    R angle = (R)i / NUM_CIRCLE_SEGMENTS * R_PI * 2;
+    circle[i * 2 + 0] = R_sin(angle);
+    circle[i * 2 + 1] = R_cos(angle);
+    if(i >= 2) {
+      circle_indexes[(i - 2) * 3 + 0] = 0;
+      circle_indexes[(i - 2) * 3 + 1] = i - 1;
+      circle_indexes[(i - 2) * 3 + 2] = i - 0;
+    }
+  }
+  _shape_mesh[draw_Shape_circle].vertexes = gl_allocateStaticBuffer(GL_ARRAY_BUFFER, sizeof(circle), circle);
+  _shape_mesh[draw_Shape_circle].indexes = gl_allocateStaticBuffer(GL_ELEMENT_ARRAY_BUFFER, sizeof(circle_indexes), circle_indexes);
+  _shape_mesh[draw_Shape_circle].num_indexes = 3 * (NUM_CIRCLE_SEGMENTS - 2);
+}
+
+void draw_shapes(enum draw_Shape shape, const struct draw_ShapeInstance * instances, uint32_t num_instances) {
+  if(num_instances == 0) {
+    return;
+  }
+  if(_shape_mesh[shape].num_indexes == 0) {
+    _shape_mesh_initialize();
+  }
+
+  struct gl_Buffer instance_buffer =
+      gl_allocateTemporaryBufferFrom(GL_ARRAY_BUFFER, sizeof(*instances) * num_instances, instances);
+
+  struct gl_DrawAssets assets = {
+    .element_buffer = &_shape_mesh[shape].indexes,
+    .vertex_buffers[0] = &_shape_mesh[shape].vertexes,
+    .vertex_buffers[1] = &instance_buffer
+  };
+  gl_queueDrawElements(_draw_key(&_ShapeInstance_draw_state, &assets), &_ShapeInstance_draw_state, &assets,
+                       _shape_mesh[shape].num_indexes, num_instances, 0, 0);
+
+  draw_frame_stats.draw_calls++;
+  draw_frame_stats.shape_instances += num_instances;
+}
+
+#undef NUM_CIRCLE_SEGMENTS
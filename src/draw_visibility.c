@@ -0,0 +1,269 @@
+#include "draw.h"
+
+#include "transform.h"
+#include "font.h"
+#include "resource.h"
+#include "configuration.h"
+#include "vector.h"
+
+#define SOURCE_NAMESPACE core.draw
+
+// edge of a grid cell in world units
+static CONFIGURATION_REAL(SOURCE_NAMESPACE, visibility_cell_size, 256.0f);
+
+// a drawable over more cells than this skips the grid and is tested by every view
+#define VISIBILITY_MAX_CELLS 64
+
+// cell coordinates are clamped to this either way, so a span of cells and the
+// product of two spans fit their integers whatever the bounds
+#define VISIBILITY_CELL_LIMIT (1 << 20)
+
+// ====================================================================================================================
+// grid
+//
+// rebuilt every frame from LocalToWorld2D. cells hash into a power of two number
+// of buckets, counting sort lays out the entries of each bucket next to each
+// other. a bucket may hold entries of other cells, the bounds test filters them
+typedef struct {
+  ecs_EntityHandle entity;
+  enum draw_Visible kind;
+  uint32_t stamp;
+  R min_x, min_y, max_x, max_y;
+} _Drawable;
+
+static struct {
+  Vector(_Drawable) drawables;
+  Vector(uint32_t) bucket_start;
+  Vector(uint32_t) entries;
+  Vector(uint32_t) large;
+  uint32_t num_buckets;
+  R cell_size;
+  uint32_t stamp;
+
+  Vector(ecs_EntityHandle) visible[NUM_DRAW_VISIBLE];
+  Vector(struct draw_CameraVisibility) cameras;
+} _visibility;
+
+extern struct Font BreeSerif;
+
+static void _push_drawable(ecs_EntityHandle entity, enum draw_Visible kind, R x, R y, R extent_x, R extent_y) {
+  Vector_space_for(&_visibility.drawables, 1);
+  *Vector_push(&_visibility.drawables) = (_Drawable) {
+      .entity = entity
+    , .kind = kind
+    , .min_x = x - extent_x
+    , .min_y = y - extent_y
+    , .max_x = x + extent_x
+    , .max_y = y + extent_y
+    };
+}
+
+// rotated shapes use the circle around them
+ECS_QUERY(_visibility_sprites
+  , read(LocalToWorld2D, t)
+  , read(Sprite, s)
+  , action(
+    (void)state;
+    struct LoadedResource *res = LoadedResource_from_image(s->image);
+    R hw = res->image.width / 2, hh = res->image.height / 2, r = R_sqrt(hw * hw + hh * hh);
+    _push_drawable(entity, draw_Visible_sprite, pga2d_point_x(t->position), pga2d_point_y(t->position), r, r);
+  )
+)
+
+ECS_QUERY(_visibility_rectangles
+  , read(LocalToWorld2D, t)
+  , read(DrawRectangle, d)
+  , action(
+    (void)state;
+    R hw = d->width / 2, hh = d->height / 2, r = R_sqrt(hw * hw + hh * hh);
+    _push_drawable(entity, draw_Visible_rectangle, pga2d_point_x(t->position), pga2d_point_y(t->position), r, r);
+  )
+)
+
+ECS_QUERY(_visibility_circles
+  , read(LocalToWorld2D, t)
+  , read(DrawCircle, c)
+  , action(
+    (void)state;
+    _push_drawable(entity, draw_Visible_circle, pga2d_point_x(t->position), pga2d_point_y(t->position), c->radius, c->radius);
+  )
+)
+
+// text grows right and down from its position, the bounds reach both ways
+ECS_QUERY(_visibility_text
+  , read(LocalToWorld2D, t)
+  , read(DrawText, d)
+  , action(
+    (void)state;
+    float width, height;
+    Font_measure(&BreeSerif, d->text, d->size, 1.0, &width, &height);
+    _push_drawable(entity, draw_Visible_text, pga2d_point_x(t->position), pga2d_point_y(t->position), width, height);
+  )
+)
+
+static inline int32_t _cell(R x) {
+  R cell = floorf(x / _visibility.cell_size);
+  // NaN fails the first test too
+  if(!(cell > -VISIBILITY_CELL_LIMIT)) {
+    return -VISIBILITY_CELL_LIMIT;
+  }
+  if(cell > VISIBILITY_CELL_LIMIT) {
+    return VISIBILITY_CELL_LIMIT;
+  }
+  return (int32_t)cell;
+}
+
+static inline uint32_t _bucket(int32_t cx, int32_t cy) {
+  return ((uint32_t)cx * 73856093u ^ (uint32_t)cy * 19349663u) & (_visibility.num_buckets - 1);
+}
+
+static bool _large(const _Drawable * d) {
+  int64_t cells = (int64_t)(_cell(d->max_x) - _cell(d->min_x) + 1) * (_cell(d->max_y) - _cell(d->min_y) + 1);
+  return cells > VISIBILITY_MAX_CELLS;
+}
+
+void draw_visibility_build(void) {
+  _visibility.drawables.length = 0;
+  _visibility.large.length = 0;
+  _visibility.cameras.length = 0;
+  _visibility.cell_size = visibility_cell_size > 0 ? visibility_cell_size : 256.0f;
+
+  _visibility_sprites();
+  _visibility_rectangles();
+  _visibility_circles();
+  _visibility_text();
+
+  uint32_t length = _visibility.drawables.length;
+  uint32_t num_buckets = 1;
+  while(num_buckets < length) {
+    num_buckets <<= 1;
+  }
+  _visibility.num_buckets = num_buckets;
+
+  Vector_set_capacity(&_visibility.bucket_start, num_buckets + 1);
+  _visibility.bucket_start.length = num_buckets + 1;
+  uint32_t * start = _visibility.bucket_start.data;
+  memory_clear(start, sizeof(*start) * (num_buckets + 1));
+
+  // counts first, shifted by one so the prefix sum leaves the start of each bucket
+  for(uint32_t i = 0; i < length; i++) {
+    const _Drawable * d = &_visibility.drawables.data[i];
+    if(_large(d)) {
+      continue;
+    }
+    for(int32_t cy = _cell(d->min_y); cy <= _cell(d->max_y); cy++) {
+      for(int32_t cx = _cell(d->min_x); cx <= _cell(d->max_x); cx++) {
+        start[_bucket(cx, cy) + 1]++;
+      }
+    }
+  }
+  for(uint32_t i = 0; i < num_buckets; i++) {
+    start[i + 1] += start[i];
+  }
+
+  Vector_set_capacity(&_visibility.entries, start[num_buckets]);
+  _visibility.entries.length = start[num_buckets];
+  for(uint32_t i = 0; i < length; i++) {
+    _Drawable * d = &_visibility.drawables.data[i];
+    d->stamp = 0;
+    if(_large(d)) {
+      Vector_space_for(&_visibility.large, 1);
+      *Vector_push(&_visibility.large) = i;
+      continue;
+    }
+    for(int32_t cy = _cell(d->min_y); cy <= _cell(d->max_y); cy++) {
+      for(int32_t cx = _cell(d->min_x); cx <= _cell(d->max_x); cx++) {
+        _visibility.entries.data[start[_bucket(cx, cy)]++] = i;
+      }
+    }
+  }
+
+  // the fill moved every start to the end of its bucket, which is the start of the next
+  for(uint32_t i = num_buckets; i > 0; i--) {
+    start[i] = start[i - 1];
+  }
+  start[0] = 0;
+}
+
+// ====================================================================================================================
+// views
+static void _test(uint32_t index, R min_x, R min_y, R max_x, R max_y) {
+  _Drawable * d = &_visibility.drawables.data[index];
+  if(d->stamp == _visibility.stamp) {
+    return;
+  }
+  d->stamp = _visibility.stamp;
+  if(d->max_x < min_x || d->min_x > max_x || d->max_y < min_y || d->min_y > max_y) {
+    return;
+  }
+  Vector_space_for(&_visibility.visible[d->kind], 1);
+  *Vector_push(&_visibility.visible[d->kind]) = d->entity;
+}
+
+void draw_visibility_query(ecs_EntityHandle camera, R min_x, R min_y, R max_x, R max_y) {
+  uint32_t length = _visibility.drawables.length;
+  for(uint32_t k = 0; k < NUM_DRAW_VISIBLE; k++) {
+    _visibility.visible[k].length = 0;
+  }
+
+  // a stamp per view so an entry over several cells is taken once
+  if(++_visibility.stamp == 0) {
+    for(uint32_t i = 0; i < length; i++) {
+      _visibility.drawables.data[i].stamp = 0;
+    }
+    _visibility.stamp = 1;
+  }
+
+  // an unbounded view, as a singular projection gives, and a view over more
+  // cells than there are drawables test them all
+  bool bounded = isfinite(min_x) && isfinite(min_y) && isfinite(max_x) && isfinite(max_y) &&
+                 max_x - min_x < _visibility.cell_size * VISIBILITY_CELL_LIMIT &&
+                 max_y - min_y < _visibility.cell_size * VISIBILITY_CELL_LIMIT;
+  int32_t cx0 = 0, cx1 = 0, cy0 = 0, cy1 = 0;
+  if(bounded) {
+    cx0 = _cell(min_x);
+    cx1 = _cell(max_x);
+    cy0 = _cell(min_y);
+    cy1 = _cell(max_y);
+  }
+
+  if(!bounded || (int64_t)(cx1 - cx0 + 1) * (cy1 - cy0 + 1) > length) {
+    for(uint32_t i = 0; i < length; i++) {
+      _test(i, min_x, min_y, max_x, max_y);
+    }
+  } else {
+    const uint32_t * start = _visibility.bucket_start.data;
+    for(int32_t cy = cy0; cy <= cy1; cy++) {
+      for(int32_t cx = cx0; cx <= cx1; cx++) {
+        uint32_t bucket = _bucket(cx, cy);
+        for(uint32_t j = start[bucket]; j < start[bucket + 1]; j++) {
+          _test(_visibility.entries.data[j], min_x, min_y, max_x, max_y);
+        }
+      }
+    }
+    for(uint32_t i = 0; i < _visibility.large.length; i++) {
+      _test(_visibility.large.data[i], min_x, min_y, max_x, max_y);
+    }
+  }
+
+  uint32_t visible = 0;
+  for(uint32_t k = 0; k < NUM_DRAW_VISIBLE; k++) {
+    visible += _visibility.visible[k].length;
+  }
+  Vector_space_for(&_visibility.cameras, 1);
+  *Vector_push(&_visibility.cameras) = (struct draw_CameraVisibility) {
+      .camera = camera
+    , .visible = visible
+    , .culled = length - visible
+    };
+}
+
+const ecs_EntityHandle * draw_visible(enum draw_Visible kind, uint32_t * count) {
+  *count = _visibility.visible[kind].length;
+  return _visibility.visible[kind].data;
+}
+
+const struct draw_CameraVisibility * draw_camera_visibility(uint32_t * count) {
+  *count = _visibility.cameras.length;
+  return _visibility.cameras.data;
+}
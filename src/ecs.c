@@ -6,12 +6,16 @@ struct ecs_global_Layer engine_ecs_layer;
 struct ecs_global_Entity engine_ecs_entity;
 struct ecs_global_Archetype engine_ecs_archetype;
 struct ecs_global_Component engine_ecs_component;
+struct ecs_global_Delta engine_ecs_delta;
+struct ecs_global_Resource engine_ecs_resource;
 
 ecs_Result ecs_initialize(void) {
   memory_clear(&engine_ecs_archetype, sizeof(engine_ecs_archetype));
   memory_clear(&engine_ecs_component, sizeof(engine_ecs_component));
   memory_clear(&engine_ecs_entity, sizeof(engine_ecs_entity));
   memory_clear(&engine_ecs_layer, sizeof(engine_ecs_layer));
+  memory_clear(&engine_ecs_delta, sizeof(engine_ecs_delta));
+  memory_clear(&engine_ecs_resource, sizeof(engine_ecs_resource));
 
   {
     ecs_EntityHandle e;
@@ -43,18 +47,23 @@ void ecs_shutdown(void) {
   }
   Vector_free(&engine_ecs_component);
 
-  FREE(engine_ecs_entity.capacity, engine_ecs_entity.generation);
-  FREE(engine_ecs_entity.capacity, engine_ecs_entity.layer_index);
-  FREE(engine_ecs_entity.capacity, engine_ecs_entity.archetype_index);
-  FREE(engine_ecs_entity.capacity, engine_ecs_entity.archetype_code);
+  for(uint32_t i = 0; i < engine_ecs_resource.length; i++) {
+    ecs_free(engine_ecs_resource.data[i].data, engine_ecs_resource.data[i].size, 16);
+  }
+  Vector_free(&engine_ecs_resource);
+
+  ecs_release_entities();
 
   for(uint32_t i = 0; i < engine_ecs_archetype.length; i++) {
     ecs_Archetype * archetype = &engine_ecs_archetype.data[i];
+    FREE(archetype->components.count, archetype->write);
     ecs_ComponentSet_free(&archetype->components);
     Vector_free(&archetype->free_codes);
     PagedSOA_free(&archetype->paged_soa);
   }
   FREE(engine_ecs_archetype.capacity, engine_ecs_archetype.components_index);
   FREE(engine_ecs_archetype.capacity, engine_ecs_archetype.data);
+
+  Vector_free(&engine_ecs_delta.events);
 }
 
@@ -9,6 +9,7 @@
 #include "assert.h"
 #include "log.h"
 #include "cpp.h"
+#include "profile.h"
 
 typedef enum ecs_Result {
   ECS_SUCCESS = 0,                       ///< command successfully completed
@@ -65,16 +66,42 @@ typedef struct ecs_ComponentCreateInfo {
   ecs_ComponentInit init;
   ecs_ComponentCleanup cleanup;
   void * user_data;
+
+  // optional, must outlive the component. used to match components across
+  // processes when importing deltas
+  const char *name;
 } ecs_ComponentCreateInfo;
 
 ecs_Result ecs_register_component(const ecs_ComponentCreateInfo *create_info,
                                   ecs_ComponentHandle *component_ptr);
 
+typedef uint32_t ecs_ResourceHandle;
+
+typedef struct ecs_ResourceCreateInfo {
+  size_t size;
+
+  // initial value, zero when NULL
+  const void *data;
+
+  const char *name;
+} ecs_ResourceCreateInfo;
+
+ecs_Result ecs_register_resource(const ecs_ResourceCreateInfo *create_info,
+                                 ecs_ResourceHandle *resource_ptr);
+
+ecs_Result ecs_read_resource(ecs_ResourceHandle resource, const void **out_ptr);
+
+ecs_Result ecs_write_resource(ecs_ResourceHandle resource, void **out_ptr);
+
+// world version of the last write access
+uint32_t ecs_resource_version(ecs_ResourceHandle resource);
+
 typedef struct ecs_EntitySpawnComponent {
   ecs_ComponentHandle component;
 
   uint32_t stride;
 
+  // zero when NULL
   const void *data;
 } ecs_EntitySpawnComponent;
 
@@ -91,6 +118,38 @@ typedef struct ecs_EntitySpawnInfo {
 ecs_Result ecs_spawn(const ecs_EntitySpawnInfo *spawn_info,
                      ecs_EntityHandle *entities_ptr);
 
+// safe to call from any thread. reserved entities have valid handles but no
+// components until they are given to ecs_spawn_reserved on the thread that
+// owns the world, or released with ecs_despawn
+ecs_Result ecs_reserve_entities(uint32_t count,
+                                ecs_EntityHandle *entities_ptr);
+
+ecs_Result ecs_spawn_reserved(const ecs_EntitySpawnInfo *spawn_info,
+                              const ecs_EntityHandle *entities_ptr);
+
+typedef struct ecs_Prefab ecs_Prefab;
+
+typedef struct ecs_PrefabCreateInfo {
+  ecs_LayerHandle layer;
+
+  uint32_t num_components;
+
+  // data is the value every instance starts with, stride is ignored
+  const ecs_EntitySpawnComponent *components;
+} ecs_PrefabCreateInfo;
+
+ecs_Result ecs_create_prefab(const ecs_PrefabCreateInfo *create_info,
+                             ecs_Prefab **prefab_ptr);
+
+// overrides are applied per instance after the prefab's row is copied, with
+// the same data/stride layout as ecs_EntitySpawnComponent
+ecs_Result ecs_spawn_prefab(const ecs_Prefab *prefab, uint32_t count,
+                            uint32_t num_overrides,
+                            const ecs_EntitySpawnComponent *overrides,
+                            ecs_EntityHandle *entities_ptr);
+
+void ecs_destroy_prefab(ecs_Prefab *prefab);
+
 ecs_Result ecs_add_component_to_entity(ecs_EntityHandle entity,
                                        ecs_ComponentHandle component,
                                        const void *data);
@@ -132,15 +191,88 @@ typedef struct ecs_QueryCreateInfo {
 
   uint32_t num_filters;
   ecs_QueryFilterCreateInfo *filters;
+
+  uint32_t num_write_resources;
+  const ecs_ResourceHandle *write_resources;
+
+  uint32_t num_read_resources;
+  const ecs_ResourceHandle *read_resources;
 } ecs_QueryCreateInfo;
 
 ecs_Result ecs_create_query(const ecs_QueryCreateInfo *create_info,
                             ecs_Query **query_ptr);
 
+// true when the two queries can not run at the same time, one of them writes
+// a component or resource the other reads or writes
+bool ecs_queries_conflict(const ecs_Query *a, const ecs_Query *b);
+
 ecs_Result ecs_execute_query(ecs_Query *query, ecs_QueryFunction cb, void *ud);
 
+// called once per page with the columns of the query's components, NULL for
+// missing optional ones. count covers every row up to the last live one, rows
+// whose entity index is zero are free and hold stale data. meant for batch
+// kernels that are cheaper to run over the free rows than to skip them
+typedef void (*ecs_QueryPageFunction)(void *ud, uint32_t count,
+                                      const uint32_t *entities, void **columns);
+
+ecs_Result ecs_execute_query_pages(ecs_Query *query, ecs_QueryPageFunction cb,
+                                   void *ud);
+
+// runs the query over the given entities only, grouped by archetype and page.
+// stale handles and entities the query does not match are skipped, modified
+// filters are not applied
+ecs_Result ecs_execute_query_for(ecs_Query *query,
+                                 const ecs_EntityHandle *entities,
+                                 uint32_t count, ecs_QueryFunction cb,
+                                 void *ud);
+
 void ecs_destroy_query(ecs_Query *query);
 
+// ---- delta export ----
+// a delta holds everything that changed after a world version: despawned
+// entities, entities whose component set changed with all of their
+// components, and for pages written since then the changed component
+// columns. exporting since version 0 gives a full snapshot
+
+typedef struct ecs_DeltaBuffer {
+  uint32_t capacity;
+  uint32_t length;
+  uint8_t *data;
+} ecs_DeltaBuffer;
+
+uint32_t ecs_current_version(void);
+
+// structural events are only kept while recording is on
+void ecs_record_structural_changes(bool enable);
+
+// appends the delta to buffer and returns the version to export from next.
+// when a structural event after since_version could not be recorded for lack
+// of memory the delta is a full snapshot instead, which the importer applies
+// by also despawning every entity it leaves out
+ecs_Result ecs_export_delta(uint32_t since_version, ecs_DeltaBuffer *buffer,
+                            uint32_t *version_ptr);
+
+// drops recorded structural events up to and including version, once every
+// consumer has exported past it
+void ecs_discard_structural_changes(uint32_t version);
+
+void ecs_free_delta_buffer(ecs_DeltaBuffer *buffer);
+
+typedef struct ecs_DeltaImporter ecs_DeltaImporter;
+
+// imported entities are spawned into layer, components are matched by name
+ecs_Result ecs_create_delta_importer(ecs_LayerHandle layer,
+                                     ecs_DeltaImporter **importer_ptr);
+
+ecs_Result ecs_import_delta(ecs_DeltaImporter *importer, const void *data,
+                            size_t size);
+
+// the local entity mirroring an exported one, 0 when unknown
+ecs_EntityHandle ecs_delta_importer_lookup(const ecs_DeltaImporter *importer,
+                                           ecs_EntityHandle remote);
+
+void ecs_destroy_delta_importer(ecs_DeltaImporter *importer);
+
 // --------------------------------------------------------------------------------------------------------------------
 #define ECS(F, ...) assert(ECS_SUCCESS == ecs_##F(__VA_ARGS__))
 
@@ -174,6 +306,29 @@ void ecs_destroy_query(ecs_Query *query);
   const struct IDENT *IDENT##_read(ecs_EntityHandle entity); \
   struct IDENT *IDENT##_write(ecs_EntityHandle entity);
 
+#define ECS_DECLARE_RESOURCE(IDENT, ...) \
+  struct IDENT __VA_ARGS__; \
+  ecs_ResourceHandle IDENT##_resource(void); \
+  const struct IDENT *IDENT##_read_resource(void); \
+  struct IDENT *IDENT##_write_resource(void);
+
+#define ECS_RESOURCE(IDENT) \
+  ECS_LAZY_GLOBAL(ecs_ResourceHandle, IDENT##_resource, \
+    ecs_ResourceCreateInfo create_info = {0}; \
+    create_info.name = #IDENT; \
+    create_info.size = sizeof(struct IDENT); \
+    ECS(register_resource, &create_info, &inner); \
+  ) \
+  const struct IDENT *IDENT##_read_resource(void) { \
+    const struct IDENT *ptr; \
+    ecs_read_resource(IDENT##_resource(), (const void **)&ptr); \
+    return ptr; \
+  } \
+  struct IDENT *IDENT##_write_resource(void) { \
+    struct IDENT *ptr; \
+    ecs_write_resource(IDENT##_resource(), (void **)&ptr); \
+    return ptr; \
+  }
 
 #define CPP_EQ__ECS_COMPONENTrequires_requires(...) CPP_PROBE
 
@@ -185,7 +340,8 @@ void ecs_destroy_query(ecs_Query *query);
 #define ECS_COMPONENT_impl(IDENT, ...) \
   ECS_LAZY_GLOBAL(ecs_ComponentHandle, IDENT##_component, \
     ecs_ComponentHandle required_components[] = {CPP_FILTER_MAP(ECS_COMPONENT_is_requires, ECS_COMPONENT_emit, __VA_ARGS__)}; \
-    ecs_ComponentCreateInfo create_info; \
+    ecs_ComponentCreateInfo create_info = {0}; \
+		create_info.name = #IDENT; \
 		create_info.size = sizeof(struct IDENT); \
 		create_info.num_required_components = (sizeof(required_components) / sizeof(ecs_ComponentHandle)); \
 		create_info.required_components = required_components; \
@@ -213,6 +369,8 @@ void ecs_destroy_query(ecs_Query *query);
 #define CPP_EQ__ECS_QUERYmodified_modified(...) CPP_PROBE
 #define CPP_EQ__ECS_QUERYaction_action(...) CPP_PROBE
 #define CPP_EQ__ECS_QUERYpost_post(...) CPP_PROBE
+#define CPP_EQ__ECS_QUERYresource_resource(...) CPP_PROBE
+#define CPP_EQ__ECS_QUERYwrite_resource_write_resource(...) CPP_PROBE
 
 #define ECS_QUERY_is_state(X) CPP_EQ(ECS_QUERY, state, X)
 #define ECS_QUERY_is_argument(X) CPP_EQ(ECS_QUERY, argument, X)
@@ -224,6 +382,9 @@ void ecs_destroy_query(ecs_Query *query);
                CPP_EQ(ECS_QUERY, modified, X))
 #define ECS_QUERY_is_action(X) CPP_EQ(ECS_QUERY, action, X)
 #define ECS_QUERY_is_post(X) CPP_EQ(ECS_QUERY, post, X)
+#define ECS_QUERY_is_resource(X) CPP_EQ(ECS_QUERY, resource, X)
+#define ECS_QUERY_is_write_resource(X) CPP_EQ(ECS_QUERY, write_resource, X)
+#define ECS_QUERY_is_any_resource(X) CPP_OR(ECS_QUERY_is_resource(X), ECS_QUERY_is_write_resource(X))
 
 #define ECS_QUERY_emit(X) CPP_CAT(ECS_QUERY_emit_, X)
 #define ECS_QUERY_emit_state(TYPE, NAME, ...) TYPE NAME;
@@ -233,6 +394,16 @@ void ecs_destroy_query(ecs_Query *query);
 #define ECS_QUERY_emit_pre(...) __VA_ARGS__
 #define ECS_QUERY_emit_action(...) __VA_ARGS__
 #define ECS_QUERY_emit_post(...) __VA_ARGS__
+#define ECS_QUERY_emit_resource(TYPE, NAME) const struct TYPE *NAME = state->NAME;
+#define ECS_QUERY_emit_write_resource(TYPE, NAME) struct TYPE *NAME = state->NAME;
+
+#define ECS_QUERY_emit_state_resource(X) CPP_CAT(ECS_QUERY_emit_state_resource_, X)
+#define ECS_QUERY_emit_state_resource_resource(TYPE, NAME) const struct TYPE *NAME;
+#define ECS_QUERY_emit_state_resource_write_resource(TYPE, NAME) struct TYPE *NAME;
+
+#define ECS_QUERY_emit_bind_resource(X) CPP_CAT(ECS_QUERY_emit_bind_resource_, X)
+#define ECS_QUERY_emit_bind_resource_resource(TYPE, NAME) state->NAME = TYPE##_read_resource();
+#define ECS_QUERY_emit_bind_resource_write_resource(TYPE, NAME) state->NAME = TYPE##_write_resource();
 
 #define ECS_QUERY_emit_create(X) CPP_CAT(ECS_QUERY_emit_create_, X)
 #define ECS_QUERY_emit_create_read(TYPE, NAME) TYPE##_component(),
@@ -240,6 +411,8 @@ void ecs_destroy_query(ecs_Query *query);
 #define ECS_QUERY_emit_create_optional(TYPE) {.component = TYPE##_component(), .filter = ECS_FILTER_OPTIONAL},
 #define ECS_QUERY_emit_create_exclude(TYPE) {.component = TYPE##_component(), .filter = ECS_FILTER_EXCLUDE},
 #define ECS_QUERY_emit_create_modified(TYPE) {.component = TYPE##_component(), .filter = ECS_FILTER_MODIFIED},
+#define ECS_QUERY_emit_create_resource(TYPE, NAME) TYPE##_resource(),
+#define ECS_QUERY_emit_create_write_resource(TYPE, NAME) TYPE##_resource(),
 
 #define ECS_QUERY_emit_arg1(X) CPP_CAT(ECS_QUERY_emit_arg1_, X)
 #define ECS_QUERY_emit_arg1_argument(TYPE, NAME) TYPE NAME,
@@ -253,6 +426,7 @@ void ecs_destroy_query(ecs_Query *query);
     ecs_Query *query; \
     CPP_FILTER_MAP(ECS_QUERY_is_state, ECS_QUERY_emit, __VA_ARGS__) \
     CPP_FILTER_MAP(ECS_QUERY_is_argument, ECS_QUERY_emit, __VA_ARGS__) \
+    CPP_FILTER_MAP(ECS_QUERY_is_any_resource, ECS_QUERY_emit_state_resource, __VA_ARGS__) \
   }; \
   static void CPP_CAT(NAME, _do)(void *ud, ecs_EntityHandle entity, \
                                        void **data) { \
@@ -260,14 +434,12 @@ void ecs_destroy_query(ecs_Query *query);
     struct CPP_CAT(NAME, _state) *state = (struct CPP_CAT(NAME, _state) *)ud; \
     CPP_FILTER_MAP(ECS_QUERY_is_write, ECS_QUERY_emit, __VA_ARGS__) \
     CPP_FILTER_MAP(ECS_QUERY_is_read, ECS_QUERY_emit, __VA_ARGS__) \
+    CPP_FILTER_MAP(ECS_QUERY_is_any_resource, ECS_QUERY_emit, __VA_ARGS__) \
     CPP_FILTER_MAP(ECS_QUERY_is_action, ECS_QUERY_emit, __VA_ARGS__) \
   } \
-  void NAME( \
-    CPP_FILTER_MAP(ECS_QUERY_is_argument, ECS_QUERY_emit_arg1, __VA_ARGS__) ... \
-  ) { \
+  static struct CPP_CAT(NAME, _state) *CPP_CAT(NAME, _prepare)(void) { \
     static struct CPP_CAT(NAME, _state) _state = {0}; \
     static struct CPP_CAT(NAME, _state) *state = &_state; \
-    CPP_FILTER_MAP(ECS_QUERY_is_argument, ECS_QUERY_emit_arg2, __VA_ARGS__) \
     if(state->query == NULL) { \
       ecs_ComponentHandle _rlist[] = { \
           CPP_FILTER_MAP(ECS_QUERY_is_read, ECS_QUERY_emit_create, __VA_ARGS__)}; \
@@ -275,18 +447,48 @@ void ecs_destroy_query(ecs_Query *query);
           CPP_FILTER_MAP(ECS_QUERY_is_write, ECS_QUERY_emit_create, __VA_ARGS__)}; \
       ecs_QueryFilterCreateInfo _flist[] = { \
           CPP_FILTER_MAP(ECS_QUERY_is_filter, ECS_QUERY_emit_create, __VA_ARGS__)}; \
+      ecs_ResourceHandle _rrlist[] = { \
+          CPP_FILTER_MAP(ECS_QUERY_is_resource, ECS_QUERY_emit_create, __VA_ARGS__)}; \
+      ecs_ResourceHandle _wrlist[] = { \
+          CPP_FILTER_MAP(ECS_QUERY_is_write_resource, ECS_QUERY_emit_create, __VA_ARGS__)}; \
       ecs_create_query( \
                              &(ecs_QueryCreateInfo){.num_write_components = sizeof(_wlist) / sizeof(_wlist[0]), \
                                                           .write_components = _wlist, \
                                                           .num_read_components = sizeof(_rlist) / sizeof(_rlist[0]), \
                                                           .read_components = _rlist, \
                                                           .num_filters = sizeof(_flist) / sizeof(_flist[0]), \
-                                                          .filters = _flist}, \
+                                                          .filters = _flist, \
+                                                          .num_write_resources = sizeof(_wrlist) / sizeof(_wrlist[0]), \
+                                                          .write_resources = _wrlist, \
+                                                          .num_read_resources = sizeof(_rrlist) / sizeof(_rrlist[0]), \
+                                                          .read_resources = _rrlist}, \
                              &state->query); \
     } \
+    return state; \
+  } \
+  void NAME( \
+    CPP_FILTER_MAP(ECS_QUERY_is_argument, ECS_QUERY_emit_arg1, __VA_ARGS__) ... \
+  ) { \
+    struct CPP_CAT(NAME, _state) *state = CPP_CAT(NAME, _prepare)(); \
+    profile_begin(#NAME); \
+    CPP_FILTER_MAP(ECS_QUERY_is_argument, ECS_QUERY_emit_arg2, __VA_ARGS__) \
+    CPP_FILTER_MAP(ECS_QUERY_is_any_resource, ECS_QUERY_emit_bind_resource, __VA_ARGS__) \
     CPP_FILTER_MAP(ECS_QUERY_is_pre, ECS_QUERY_emit, __VA_ARGS__) \
     ecs_execute_query(state->query, CPP_CAT(NAME, _do), state); \
     CPP_FILTER_MAP(ECS_QUERY_is_post, ECS_QUERY_emit, __VA_ARGS__) \
+    profile_end(); \
+  } \
+  void CPP_CAT(NAME, _for)(const ecs_EntityHandle *__entities, uint32_t __count, \
+    CPP_FILTER_MAP(ECS_QUERY_is_argument, ECS_QUERY_emit_arg1, __VA_ARGS__) ... \
+  ) { \
+    struct CPP_CAT(NAME, _state) *state = CPP_CAT(NAME, _prepare)(); \
+    profile_begin(#NAME); \
+    CPP_FILTER_MAP(ECS_QUERY_is_argument, ECS_QUERY_emit_arg2, __VA_ARGS__) \
+    CPP_FILTER_MAP(ECS_QUERY_is_any_resource, ECS_QUERY_emit_bind_resource, __VA_ARGS__) \
+    CPP_FILTER_MAP(ECS_QUERY_is_pre, ECS_QUERY_emit, __VA_ARGS__) \
+    ecs_execute_query_for(state->query, __entities, __count, CPP_CAT(NAME, _do), state); \
+    CPP_FILTER_MAP(ECS_QUERY_is_post, ECS_QUERY_emit, __VA_ARGS__) \
+    profile_end(); \
   }
 
 #endif
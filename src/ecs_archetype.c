@@ -67,6 +67,10 @@ ecs_Result ecs_resolve_archetype(
 
   archetype->components = components;
 
+  if(components.count > 0) {
+    ALLOC(components.count, archetype->write);
+  }
+
   size_t * sizes = memory_alloc(sizeof(size_t) * (1 + components.count), alignof(*sizes));
 
   sizes[0] = sizeof(uint32_t);
@@ -74,7 +78,7 @@ ecs_Result ecs_resolve_archetype(
     sizes[i + 1] = engine_ecs_component.data[components.index[i]].size;
 
     archetype->any_init |= engine_ecs_component.data[components.index[i]].init != NULL;
-    archetype->any_cleanup |= &engine_ecs_component.data[components.index[i]].cleanup != NULL;
+    archetype->any_cleanup |= engine_ecs_component.data[components.index[i]].cleanup != NULL;
   }
 
   PagedSOA_initialize(&archetype->paged_soa, sizeof(uint32_t) * (1 + components.count), 1 + components.count, sizes);
@@ -108,7 +112,16 @@ static ecs_Result _allocate_code(
     code = PagedSOA_push(&archetype->paged_soa);
   }
 
-  *(uint32_t *)PagedSOA_page(&archetype->paged_soa, code) += 1;
+  uint32_t * page = (uint32_t *)PagedSOA_page(&archetype->paged_soa, code);
+  page[0] += 1;
+
+  // a row that arrives is written as a whole, modified filters see spawned
+  // and moved entities the same as ones a query or write access touched
+  uint32_t version = ecs_next_version();
+  for(uint32_t i = 0; i < archetype->components.count; i++) {
+    archetype->write[i] = version;
+    page[1 + i] = version;
+  }
 
   *archetype_code = code;
 
@@ -138,6 +151,8 @@ ecs_Result ecs_unset_entity_archetype(
   uint32_t archetype_index = ENTITY_ARCHETYPE_INDEX(entity_index);
   uint32_t archetype_code = ENTITY_ARCHETYPE_CODE(entity_index);
   
+  ecs_record_delta_event(ECS_DELTA_EVENT_REMOVED, entity_index);
+
   ENTITY_DATA_ENTITY_INDEX(entity_index) = 0;
   ENTITY_ARCHETYPE_INDEX(entity_index) = 0;
   ENTITY_ARCHETYPE_CODE(entity_index) = 0;
@@ -157,6 +172,7 @@ ecs_Result ecs_set_entity_archetype(
     ENTITY_ARCHETYPE_INDEX(entity_index) = archetype_index;
     ENTITY_ARCHETYPE_CODE(entity_index) = code;
     ENTITY_DATA_ENTITY_INDEX(entity_index) = entity_index;
+    ecs_record_delta_event(ECS_DELTA_EVENT_PLACED, entity_index);
     return ECS_SUCCESS;
   }
 
@@ -199,6 +215,8 @@ ecs_Result ecs_set_entity_archetype(
 
     w++;
   }
+
+  ecs_record_delta_event(ECS_DELTA_EVENT_PLACED, entity_index);
   
   return ECS_SUCCESS;
 }
@@ -29,7 +29,9 @@ ecs_Result ecs_register_component(const ecs_ComponentCreateInfo *create_info,
       .num_required_components = create_info->num_required_components,
       .required_components = required_components,
       .init = create_info->init,
-      .cleanup = create_info->cleanup};
+      .cleanup = create_info->cleanup,
+      .user_data = create_info->user_data,
+      .name = create_info->name};
 
   if (!Vector_space_for(&engine_ecs_component, 1)) {
     return ECS_ERROR_OUT_OF_MEMORY;
@@ -64,12 +66,12 @@ ecs_Result ecs_init_component(uint32_t entity_index, uint32_t archetype_index,
   ALLOC(1 + component->num_required_components, pointers);
   struct ecs_Archetype *archetype = &engine_ecs_archetype.data[archetype_index];
 
-  pointers[0] = ecs_raw_access(entity_index, component_index, page, index);
+  pointers[0] = ecs_raw_access(archetype_index, component_index, page, index);
 
   for (uint32_t i = 0; i < component->num_required_components; i++) {
     uint32_t rindex = ecs_ComponentSet_order_of(
         &archetype->components, component->required_components[i]);
-    pointers[1 + i] = ecs_raw_access(entity_index, rindex, page, index);
+    pointers[1 + i] = ecs_raw_access(archetype_index, rindex, page, index);
   }
 
   component->init(component->user_data, ecs_construct_entity_handle_index_only(entity_index), pointers);
@@ -97,7 +99,7 @@ ecs_Result ecs_init_components(uint32_t entity_index,
   ALLOC(archetype->components.count, pointers2);
 
   for (uint32_t i = 0; i < archetype->components.count; i++) {
-    pointers1[i] = ecs_raw_access(entity_index, i, page, index);
+    pointers1[i] = ecs_raw_access(archetype_index, i, page, index);
   }
 
   for (uint32_t i = 0; i < archetype->components.count; i++) {
@@ -141,12 +143,12 @@ ecs_Result ecs_cleanup_component(uint32_t entity_index,
   ALLOC(1 + component->num_required_components, pointers);
   struct ecs_Archetype *archetype = &engine_ecs_archetype.data[archetype_index];
 
-  pointers[0] = ecs_raw_access(entity_index, component_index, page, index);
+  pointers[0] = ecs_raw_access(archetype_index, component_index, page, index);
 
   for (uint32_t i = 0; i < component->num_required_components; i++) {
     uint32_t rindex = ecs_ComponentSet_order_of(
         &archetype->components, component->required_components[i]);
-    pointers[1 + i] = ecs_raw_access(entity_index, rindex, page, index);
+    pointers[1 + i] = ecs_raw_access(archetype_index, rindex, page, index);
   }
 
   component->cleanup(component->user_data,
@@ -175,7 +177,7 @@ ecs_Result ecs_cleanup_components(uint32_t entity_index,
   ALLOC(archetype->components.count, pointers2);
 
   for (uint32_t i = 0; i < archetype->components.count; i++) {
-    pointers1[i] = ecs_raw_access(entity_index, i, page, index);
+    pointers1[i] = ecs_raw_access(archetype_index, i, page, index);
   }
 
   for (uint32_t i = 0; i < archetype->components.count; i++) {
@@ -203,12 +205,6 @@ ecs_Result ecs_cleanup_components(uint32_t entity_index,
   return ECS_SUCCESS;
 }
 
-static int _compar_component_index(const void *ap, const void *bp, void *ud) {
-  uint32_t a = *(uint32_t *)ap;
-  uint32_t b = *(uint32_t *)bp;
-  return a - b;
-}
-
 ecs_Result ecs_ComponentSet_init_0(ecs_ComponentSet *set, uint32_t a_count,
                                    const uint32_t *a_component_indexes,
                                    uint32_t b_count,
@@ -226,7 +222,7 @@ ecs_Result ecs_ComponentSet_init_0(ecs_ComponentSet *set, uint32_t a_count,
     memcpy(set->index + a_count, b_component_indexes,
            b_count * sizeof(*set->index));
   }
-  sort_qsort(set->index, set->count, sizeof(*set->index), _compar_component_index,
+  sort_qsort(set->index, set->count, sizeof(*set->index), ecs_compar_component_index,
         NULL);
   return ECS_SUCCESS;
 }
@@ -261,7 +257,7 @@ uint32_t ecs_ComponentSet_order_of(const ecs_ComponentSet *set,
                                    ecs_ComponentHandle component) {
   // if aeComponent ever changes, need to translate to the indexes
   uint32_t *p = sort_bsearch(&component, set->index, set->count, sizeof(*set->index),
-                        _compar_component_index, NULL);
+                        ecs_compar_component_index, NULL);
   if (p == NULL) {
     return UINT32_MAX;
   }
@@ -0,0 +1,657 @@
+#include "ecs_local.h"
+
+#include "sort.h"
+
+// delta stream layout, integers are LEB128 varints unless noted
+//
+//   "ECSD" u8 format
+//   since_version to_version
+//   num_components { handle size name_length name[name_length] }
+//   num_removed { entity }
+//   num_placed { entity num_components { component data[size] } }
+//   { num_components > 0 { component } num_rows { entity } { data[size * num_rows] } }
+//   0
+//
+// entities and components are given as the exporter's handles. the last
+// section holds one chunk per page with components written since since_version
+#define DELTA_MAGIC "ECSD"
+#define DELTA_FORMAT 1
+
+// versions wrap around, a is newer than b while it is less than half the range
+// ahead, as queries compare page versions
+static inline bool _newer(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) > 0;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------
+void ecs_record_delta_event(ecs_DeltaEventKind kind, uint32_t entity_index) {
+  if (!engine_ecs_delta.record) {
+    return;
+  }
+  if (!Vector_space_for(&engine_ecs_delta.events, 1)) {
+    engine_ecs_delta.lost = true;
+    engine_ecs_delta.lost_version = ecs_next_version();
+    return;
+  }
+  ecs_DeltaEvent *event = Vector_push(&engine_ecs_delta.events);
+  event->version = ecs_next_version();
+  event->kind = kind;
+  event->entity = ecs_construct_entity_handle_index_only(entity_index);
+}
+
+uint32_t ecs_current_version(void) { return engine_ecs_delta.version; }
+
+void ecs_record_structural_changes(bool enable) {
+  engine_ecs_delta.record = enable;
+  if (!enable) {
+    Vector_clear(&engine_ecs_delta.events);
+  }
+}
+
+void ecs_discard_structural_changes(uint32_t version) {
+  uint32_t i = 0;
+  while (i < engine_ecs_delta.events.length &&
+         !_newer(engine_ecs_delta.events.data[i].version, version)) {
+    i++;
+  }
+  if (i > 0) {
+    engine_ecs_delta.events.length -= i;
+    memmove(engine_ecs_delta.events.data, engine_ecs_delta.events.data + i,
+            engine_ecs_delta.events.length * sizeof(ecs_DeltaEvent));
+  }
+  if (engine_ecs_delta.lost && !_newer(engine_ecs_delta.lost_version, version)) {
+    engine_ecs_delta.lost = false;
+  }
+}
+
+void ecs_free_delta_buffer(ecs_DeltaBuffer *buffer) { Vector_free(buffer); }
+
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------
+static bool _put_bytes(ecs_DeltaBuffer *buffer, const void *data,
+                       size_t size) {
+  if (!Vector_space_for(buffer, size)) {
+    return false;
+  }
+  memcpy(buffer->data + buffer->length, data, size);
+  buffer->length += size;
+  return true;
+}
+
+static bool _put_varint(ecs_DeltaBuffer *buffer, uint64_t value) {
+  uint8_t bytes[10];
+  size_t length = 0;
+  do {
+    bytes[length] = value & 0x7F;
+    value >>= 7;
+    bytes[length++] |= value ? 0x80 : 0;
+  } while (value);
+  return _put_bytes(buffer, bytes, length);
+}
+
+#define PUT_VARINT(B, V)     do { if(!_put_varint(B, V)) { return ECS_ERROR_OUT_OF_MEMORY; } } while(0)
+#define PUT_BYTES(B, P, S)   do { if(!_put_bytes(B, P, S)) { return ECS_ERROR_OUT_OF_MEMORY; } } while(0)
+
+static int _compare_entity_handle(const void *ap, const void *bp, void *ud) {
+  ecs_EntityHandle a = *(const ecs_EntityHandle *)ap;
+  ecs_EntityHandle b = *(const ecs_EntityHandle *)bp;
+  return a < b ? -1 : a > b;
+}
+
+static void _sort_unique(ecs_EntityHandle *data, uint32_t *length) {
+  if (*length < 2) {
+    return;
+  }
+  sort_qsort(data, *length, sizeof(*data), _compare_entity_handle, NULL);
+  uint32_t w = 1;
+  for (uint32_t r = 1; r < *length; r++) {
+    if (data[r] != data[w - 1]) {
+      data[w++] = data[r];
+    }
+  }
+  *length = w;
+}
+
+static ecs_Result _export_entity(ecs_DeltaBuffer *buffer,
+                                 ecs_EntityHandle entity) {
+  uint32_t entity_index = (uint32_t)(entity & 0xFFFFFFFF);
+  const ecs_Archetype *archetype = ENTITY_ARCHETYPE_DATA(entity_index);
+
+  PUT_VARINT(buffer, entity);
+  PUT_VARINT(buffer, archetype->components.count);
+  for (uint32_t i = 0; i < archetype->components.count; i++) {
+    PUT_VARINT(buffer, archetype->components.index[i]);
+    PUT_BYTES(buffer, ecs_write(entity_index, i),
+              archetype->paged_soa.size_offset[i + 1] >> 16);
+  }
+  return ECS_SUCCESS;
+}
+
+// rows of a page that were ever pushed, and how many of them hold an entity
+static void _live_rows(const ecs_Archetype *archetype, uint32_t page,
+                       uint32_t *rows_ptr, uint32_t *num_rows_ptr) {
+  const PagedSOA *soa = &archetype->paged_soa;
+  const uint32_t *entity = (const uint32_t *)PagedSOA_read_first(soa, page, 0);
+  uint32_t first = page * soa->rows_per_page;
+  uint32_t rows = soa->length - first < soa->rows_per_page ? soa->length - first
+                                                           : soa->rows_per_page;
+  uint32_t num_rows = 0;
+  for (uint32_t r = 0; r < rows; r++) {
+    num_rows += entity[r] != 0;
+  }
+  *rows_ptr = rows;
+  *num_rows_ptr = num_rows;
+}
+
+static ecs_Result _export_page(ecs_DeltaBuffer *buffer,
+                               const ecs_Archetype *archetype, uint32_t page,
+                               uint32_t since_version) {
+  const uint8_t *data = archetype->paged_soa.pages[page];
+  const uint32_t *live_count = (const uint32_t *)data;
+  const uint32_t *page_last_seen_write = live_count + 1;
+
+  uint32_t num_changed = 0;
+  for (uint32_t c = 0; c < archetype->components.count; c++) {
+    num_changed += _newer(page_last_seen_write[c], since_version);
+  }
+  if (num_changed == 0 || *live_count == 0) {
+    return ECS_SUCCESS;
+  }
+
+  PUT_VARINT(buffer, num_changed);
+  for (uint32_t c = 0; c < archetype->components.count; c++) {
+    if (_newer(page_last_seen_write[c], since_version)) {
+      PUT_VARINT(buffer, archetype->components.index[c]);
+    }
+  }
+
+  // rows are walked in the same order for the entity list and every column
+  const uint32_t *entity =
+      (const uint32_t *)PagedSOA_read_first(&archetype->paged_soa, page, 0);
+  uint32_t rows, num_rows;
+  _live_rows(archetype, page, &rows, &num_rows);
+
+  PUT_VARINT(buffer, num_rows);
+  for (uint32_t r = 0; r < rows; r++) {
+    if (entity[r]) {
+      PUT_VARINT(buffer, ecs_construct_entity_handle_index_only(entity[r]));
+    }
+  }
+
+  for (uint32_t c = 0; c < archetype->components.count; c++) {
+    if (!_newer(page_last_seen_write[c], since_version)) {
+      continue;
+    }
+    uint32_t size, offset;
+    PagedSOA_decode_column(&archetype->paged_soa, c + 1, &size, &offset);
+    const uint8_t *column = data + offset;
+    for (uint32_t r = 0; r < rows; r++) {
+      if (entity[r]) {
+        PUT_BYTES(buffer, column + size * r, size);
+      }
+    }
+  }
+
+  return ECS_SUCCESS;
+}
+
+ecs_Result ecs_export_delta(uint32_t since_version, ecs_DeltaBuffer *buffer,
+                            uint32_t *version_ptr) {
+  return_ERROR_INVALID_ARGUMENT_if(buffer == NULL);
+  return_ERROR_INVALID_ARGUMENT_if(_newer(since_version, engine_ecs_delta.version));
+
+  // the events since then are incomplete, only a snapshot is right
+  if (engine_ecs_delta.lost && _newer(engine_ecs_delta.lost_version, since_version)) {
+    since_version = 0;
+  }
+
+  uint32_t version = engine_ecs_delta.version;
+
+  PUT_BYTES(buffer, DELTA_MAGIC, 4);
+  PUT_VARINT(buffer, DELTA_FORMAT);
+  PUT_VARINT(buffer, since_version);
+  PUT_VARINT(buffer, version);
+
+  PUT_VARINT(buffer, engine_ecs_component.length);
+  for (uint32_t i = 0; i < engine_ecs_component.length; i++) {
+    const ecs_Component *component = &engine_ecs_component.data[i];
+    size_t name_length = component->name ? strlen(component->name) : 0;
+    PUT_VARINT(buffer, i);
+    PUT_VARINT(buffer, component->size);
+    PUT_VARINT(buffer, name_length);
+    PUT_BYTES(buffer, component->name, name_length);
+  }
+
+  Vector(ecs_EntityHandle) removed = VECTOR_INIT;
+  Vector(ecs_EntityHandle) placed = VECTOR_INIT;
+  ecs_Result result = ECS_SUCCESS;
+
+  if (since_version == 0) {
+    // full snapshot, every live entity counts as placed
+    for (uint32_t a = 0; result == ECS_SUCCESS && a < engine_ecs_archetype.length; a++) {
+      const ecs_Archetype *archetype = &engine_ecs_archetype.data[a];
+      for (uint32_t p = 0; p < archetype->paged_soa.num_pages; p++) {
+        const uint32_t *entity = (const uint32_t *)PagedSOA_read_first(
+            &archetype->paged_soa, p, 0);
+        uint32_t rows, num_rows;
+        _live_rows(archetype, p, &rows, &num_rows);
+        if (!Vector_space_for(&placed, num_rows)) {
+          result = ECS_ERROR_OUT_OF_MEMORY;
+          break;
+        }
+        for (uint32_t r = 0; r < rows; r++) {
+          if (entity[r]) {
+            *Vector_push(&placed) = ecs_construct_entity_handle_index_only(entity[r]);
+          }
+        }
+      }
+    }
+  } else {
+    for (uint32_t i = 0; i < engine_ecs_delta.events.length; i++) {
+      const ecs_DeltaEvent *event = &engine_ecs_delta.events.data[i];
+      if (!_newer(event->version, since_version)) {
+        continue;
+      }
+      if (event->kind == ECS_DELTA_EVENT_REMOVED) {
+        if (!Vector_space_for(&removed, 1)) {
+          result = ECS_ERROR_OUT_OF_MEMORY;
+          break;
+        }
+        *Vector_push(&removed) = event->entity;
+      } else {
+        if (!Vector_space_for(&placed, 1)) {
+          result = ECS_ERROR_OUT_OF_MEMORY;
+          break;
+        }
+        *Vector_push(&placed) = event->entity;
+      }
+    }
+  }
+
+  _sort_unique(removed.data, &removed.length);
+  _sort_unique(placed.data, &placed.length);
+
+  // entities placed and then despawned again are only reported as removed
+  uint32_t num_placed = 0;
+  for (uint32_t i = 0; i < placed.length; i++) {
+    uint32_t entity_index;
+    if (ecs_validate_entity_handle(placed.data[i], &entity_index) == ECS_SUCCESS &&
+        !ENTITY_IS_RESERVED(entity_index) && entity_index != 0) {
+      placed.data[num_placed++] = placed.data[i];
+    }
+  }
+  placed.length = num_placed;
+
+  if (result == ECS_SUCCESS) {
+    result = _put_varint(buffer, removed.length) ? ECS_SUCCESS : ECS_ERROR_OUT_OF_MEMORY;
+  }
+  for (uint32_t i = 0; result == ECS_SUCCESS && i < removed.length; i++) {
+    result = _put_varint(buffer, removed.data[i]) ? ECS_SUCCESS : ECS_ERROR_OUT_OF_MEMORY;
+  }
+
+  if (result == ECS_SUCCESS) {
+    result = _put_varint(buffer, placed.length) ? ECS_SUCCESS : ECS_ERROR_OUT_OF_MEMORY;
+  }
+  for (uint32_t i = 0; result == ECS_SUCCESS && i < placed.length; i++) {
+    result = _export_entity(buffer, placed.data[i]);
+  }
+
+  // a snapshot already carries every component of every entity
+  if (since_version > 0) {
+    for (uint32_t a = 0; result == ECS_SUCCESS && a < engine_ecs_archetype.length; a++) {
+      const ecs_Archetype *archetype = &engine_ecs_archetype.data[a];
+      for (uint32_t p = 0; result == ECS_SUCCESS && p < archetype->paged_soa.num_pages; p++) {
+        result = _export_page(buffer, archetype, p, since_version);
+      }
+    }
+  }
+
+  if (result == ECS_SUCCESS) {
+    result = _put_varint(buffer, 0) ? ECS_SUCCESS : ECS_ERROR_OUT_OF_MEMORY;
+  }
+
+  Vector_free(&removed);
+  Vector_free(&placed);
+
+  if (result == ECS_SUCCESS && version_ptr != NULL) {
+    *version_ptr = version;
+  }
+
+  return result;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------
+typedef struct ecs_DeltaImporterEntity {
+  ecs_EntityHandle remote;
+  ecs_EntityHandle local;
+  uint32_t import;  // the last import that placed it
+} ecs_DeltaImporterEntity;
+
+typedef struct ecs_DeltaImporterComponent {
+  ecs_ComponentHandle local;  // UINT32_MAX when there is no local match
+  uint32_t size;
+} ecs_DeltaImporterComponent;
+
+struct ecs_DeltaImporter {
+  ecs_LayerHandle layer;
+  uint32_t imports;
+  // indexed by the remote entity index
+  Vector(ecs_DeltaImporterEntity) entities;
+  // indexed by the remote component handle, rebuilt for every delta
+  Vector(ecs_DeltaImporterComponent) components;
+  Vector(ecs_EntitySpawnComponent) incoming;
+  Vector(ecs_ComponentHandle) outgoing;
+};
+
+typedef struct _Reader {
+  const uint8_t *read;
+  const uint8_t *end;
+} _Reader;
+
+static bool _get_varint(_Reader *r, uint64_t *value) {
+  uint64_t result = 0;
+  for (uint32_t shift = 0; shift < 64; shift += 7) {
+    if (r->read >= r->end) {
+      return false;
+    }
+    uint8_t byte = *r->read++;
+    result |= (uint64_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+static const void *_get_bytes(_Reader *r, uint64_t size) {
+  if ((uint64_t)(r->end - r->read) < size) {
+    return NULL;
+  }
+  const void *result = r->read;
+  r->read += size;
+  return result;
+}
+
+#define GET_VARINT(R, V)  do { if(!_get_varint(R, V)) { return ECS_ERROR_INVALID_ARGUMENT; } } while(0)
+
+ecs_Result ecs_create_delta_importer(ecs_LayerHandle layer,
+                                     ecs_DeltaImporter **importer_ptr) {
+  return_ERROR_INVALID_ARGUMENT_if(importer_ptr == NULL);
+
+  ecs_DeltaImporter *importer;
+  ALLOC(1, importer);
+  importer->layer = layer;
+
+  *importer_ptr = importer;
+  return ECS_SUCCESS;
+}
+
+void ecs_destroy_delta_importer(ecs_DeltaImporter *importer) {
+  if (importer == NULL) {
+    return;
+  }
+  Vector_free(&importer->entities);
+  Vector_free(&importer->components);
+  Vector_free(&importer->incoming);
+  Vector_free(&importer->outgoing);
+  FREE(1, importer);
+}
+
+static ecs_DeltaImporterEntity *_find(const ecs_DeltaImporter *importer,
+                                      ecs_EntityHandle remote) {
+  uint32_t index = (uint32_t)(remote & 0xFFFFFFFF);
+  if (index >= importer->entities.length ||
+      importer->entities.data[index].remote != remote) {
+    return NULL;
+  }
+  return &importer->entities.data[index];
+}
+
+ecs_EntityHandle ecs_delta_importer_lookup(const ecs_DeltaImporter *importer,
+                                           ecs_EntityHandle remote) {
+  const ecs_DeltaImporterEntity *entity = _find(importer, remote);
+  return entity ? entity->local : 0;
+}
+
+static ecs_ComponentHandle _find_component(const char *name, size_t length,
+                                           uint32_t size) {
+  for (uint32_t i = 0; i < engine_ecs_component.length; i++) {
+    const ecs_Component *component = &engine_ecs_component.data[i];
+    if (component->name != NULL && component->size == size &&
+        strlen(component->name) == length &&
+        memcmp(component->name, name, length) == 0) {
+      return i;
+    }
+  }
+  return UINT32_MAX;
+}
+
+static ecs_Result _map(ecs_DeltaImporter *importer, ecs_EntityHandle remote,
+                       ecs_EntityHandle local) {
+  uint32_t index = (uint32_t)(remote & 0xFFFFFFFF);
+  if (index >= importer->entities.length) {
+    if (!Vector_space_for(&importer->entities,
+                          index + 1 - importer->entities.length)) {
+      return ECS_ERROR_OUT_OF_MEMORY;
+    }
+    memset(importer->entities.data + importer->entities.length, 0,
+           (index + 1 - importer->entities.length) * sizeof(ecs_DeltaImporterEntity));
+    importer->entities.length = index + 1;
+  }
+  importer->entities.data[index].remote = remote;
+  importer->entities.data[index].local = local;
+  importer->entities.data[index].import = importer->imports;
+  return ECS_SUCCESS;
+}
+
+// bring an existing entity's component set in line with the incoming one
+static ecs_Result _sync_entity(ecs_DeltaImporter *importer,
+                               ecs_EntityHandle local) {
+  uint32_t entity_index = (uint32_t)(local & 0xFFFFFFFF);
+  const ecs_Archetype *archetype = ENTITY_ARCHETYPE_DATA(entity_index);
+
+  importer->outgoing.length = 0;
+  for (uint32_t i = 0; i < archetype->components.count; i++) {
+    ecs_ComponentHandle component = archetype->components.index[i];
+    uint32_t j = 0;
+    while (j < importer->incoming.length &&
+           importer->incoming.data[j].component != component) {
+      j++;
+    }
+    if (j == importer->incoming.length) {
+      if (!Vector_space_for(&importer->outgoing, 1)) {
+        return ECS_ERROR_OUT_OF_MEMORY;
+      }
+      *Vector_push(&importer->outgoing) = component;
+    }
+  }
+  for (uint32_t i = 0; i < importer->outgoing.length; i++) {
+    ecs_remove_component_from_entity(local, importer->outgoing.data[i]);
+  }
+
+  for (uint32_t i = 0; i < importer->incoming.length; i++) {
+    const ecs_EntitySpawnComponent *incoming = &importer->incoming.data[i];
+    void *write;
+    if (ecs_write_entity_component(local, incoming->component, &write) ==
+        ECS_SUCCESS) {
+      memcpy(write, incoming->data,
+             engine_ecs_component.data[incoming->component].size);
+    } else {
+      return_if_ERROR(ecs_add_component_to_entity(local, incoming->component,
+                                                  incoming->data));
+    }
+  }
+
+  return ECS_SUCCESS;
+}
+
+static ecs_Result _import_placed(ecs_DeltaImporter *importer, _Reader *r) {
+  uint64_t remote, num_components;
+  GET_VARINT(r, &remote);
+  GET_VARINT(r, &num_components);
+
+  importer->incoming.length = 0;
+  for (uint64_t i = 0; i < num_components; i++) {
+    uint64_t component;
+    GET_VARINT(r, &component);
+    return_ERROR_INVALID_ARGUMENT_if(component >= importer->components.length);
+    const ecs_DeltaImporterComponent *mapping =
+        &importer->components.data[component];
+    const void *data = _get_bytes(r, mapping->size);
+    return_ERROR_INVALID_ARGUMENT_if(data == NULL);
+    if (mapping->local == UINT32_MAX) {
+      continue;
+    }
+    if (!Vector_space_for(&importer->incoming, 1)) {
+      return ECS_ERROR_OUT_OF_MEMORY;
+    }
+    *Vector_push(&importer->incoming) = (ecs_EntitySpawnComponent){
+        .component = mapping->local, .stride = 0, .data = data};
+  }
+
+  uint32_t entity_index;
+  ecs_DeltaImporterEntity *known = _find(importer, remote);
+  if (known != NULL &&
+      ecs_validate_entity_handle(known->local, &entity_index) == ECS_SUCCESS) {
+    known->import = importer->imports;
+    return _sync_entity(importer, known->local);
+  }
+
+  ecs_EntityHandle local;
+  return_if_ERROR(ecs_spawn(
+      &(ecs_EntitySpawnInfo){.layer = importer->layer,
+                             .count = 1,
+                             .num_components = importer->incoming.length,
+                             .components = importer->incoming.data},
+      &local));
+  return _map(importer, remote, local);
+}
+
+static ecs_Result _import_chunk(ecs_DeltaImporter *importer, _Reader *r,
+                                uint64_t num_components) {
+  const uint8_t *components = r->read;
+  for (uint64_t i = 0; i < num_components; i++) {
+    uint64_t component;
+    GET_VARINT(r, &component);
+    return_ERROR_INVALID_ARGUMENT_if(component >= importer->components.length);
+  }
+
+  uint64_t num_rows;
+  GET_VARINT(r, &num_rows);
+  const uint8_t *rows = r->read;
+  for (uint64_t i = 0; i < num_rows; i++) {
+    uint64_t remote;
+    GET_VARINT(r, &remote);
+  }
+
+  _Reader component_reader = {components, rows};
+  for (uint64_t i = 0; i < num_components; i++) {
+    uint64_t component;
+    _get_varint(&component_reader, &component);
+    const ecs_DeltaImporterComponent *mapping =
+        &importer->components.data[component];
+
+    const uint8_t *column = _get_bytes(r, num_rows * mapping->size);
+    return_ERROR_INVALID_ARGUMENT_if(column == NULL);
+    if (mapping->local == UINT32_MAX) {
+      continue;
+    }
+
+    _Reader row_reader = {rows, r->end};
+    for (uint64_t j = 0; j < num_rows; j++, column += mapping->size) {
+      uint64_t remote;
+      _get_varint(&row_reader, &remote);
+      const ecs_DeltaImporterEntity *known = _find(importer, remote);
+      void *write;
+      if (known != NULL &&
+          ecs_write_entity_component(known->local, mapping->local, &write) ==
+              ECS_SUCCESS) {
+        memcpy(write, column, mapping->size);
+      }
+    }
+  }
+
+  return ECS_SUCCESS;
+}
+
+ecs_Result ecs_import_delta(ecs_DeltaImporter *importer, const void *data,
+                            size_t size) {
+  return_ERROR_INVALID_ARGUMENT_if(importer == NULL);
+  return_ERROR_INVALID_ARGUMENT_if(data == NULL && size > 0);
+
+  _Reader reader = {data, (const uint8_t *)data + size};
+  _Reader *r = &reader;
+
+  const void *magic = _get_bytes(r, 4);
+  return_ERROR_INVALID_ARGUMENT_if(magic == NULL ||
+                                   memcmp(magic, DELTA_MAGIC, 4) != 0);
+
+  uint64_t format, since_version, version;
+  GET_VARINT(r, &format);
+  return_ERROR_INVALID_ARGUMENT_if(format != DELTA_FORMAT);
+  GET_VARINT(r, &since_version);
+  GET_VARINT(r, &version);
+
+  uint64_t num_components;
+  GET_VARINT(r, &num_components);
+  importer->components.length = 0;
+  for (uint64_t i = 0; i < num_components; i++) {
+    uint64_t handle, component_size, name_length;
+    GET_VARINT(r, &handle);
+    GET_VARINT(r, &component_size);
+    GET_VARINT(r, &name_length);
+    const char *name = _get_bytes(r, name_length);
+    return_ERROR_INVALID_ARGUMENT_if(name == NULL || handle != i);
+    if (!Vector_space_for(&importer->components, 1)) {
+      return ECS_ERROR_OUT_OF_MEMORY;
+    }
+    *Vector_push(&importer->components) = (ecs_DeltaImporterComponent){
+        .local = name_length ? _find_component(name, name_length, component_size)
+                             : UINT32_MAX,
+        .size = component_size};
+  }
+
+  uint64_t num_removed;
+  GET_VARINT(r, &num_removed);
+  for (uint64_t i = 0; i < num_removed; i++) {
+    uint64_t remote;
+    GET_VARINT(r, &remote);
+    ecs_DeltaImporterEntity *known = _find(importer, remote);
+    if (known != NULL) {
+      ecs_despawn(1, &known->local);
+      known->remote = 0;
+      known->local = 0;
+    }
+  }
+
+  uint64_t num_placed;
+  GET_VARINT(r, &num_placed);
+  importer->imports++;
+  for (uint64_t i = 0; i < num_placed; i++) {
+    return_if_ERROR(_import_placed(importer, r));
+  }
+
+  // a snapshot lists every entity, the ones it leaves out are gone. the
+  // exporter also falls back to one when it lost track of removals
+  if (since_version == 0) {
+    for (uint32_t i = 0; i < importer->entities.length; i++) {
+      ecs_DeltaImporterEntity *known = &importer->entities.data[i];
+      if (known->remote != 0 && known->import != importer->imports) {
+        ecs_despawn(1, &known->local);
+        known->remote = 0;
+        known->local = 0;
+      }
+    }
+  }
+
+  for (;;) {
+    uint64_t chunk_components;
+    GET_VARINT(r, &chunk_components);
+    if (chunk_components == 0) {
+      break;
+    }
+    return_if_ERROR(_import_chunk(importer, r, chunk_components));
+  }
+
+  return ECS_SUCCESS;
+}
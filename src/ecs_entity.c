@@ -3,14 +3,127 @@
 #include "log.h"
 #include "sort.h"
 
+// entity indexes are handed out from a small per thread cache so reserving an
+// entity needs no synchronization in the common case. an empty cache is
+// refilled with a whole block of indexes, either popped from the global stack
+// of free blocks or carved off the end of the entity range with one atomic
+// add. freed indexes go to the freeing thread's cache and overflow back to the
+// global stack a block at a time.
+
+static _Atomic uint32_t _epoch = 1;
+
+static _Thread_local struct {
+  uint32_t epoch;
+  uint32_t count;
+  uint32_t index[ECS_ENTITY_BLOCK_SIZE * 2];
+} _cache;
+
+static void _validate_cache(void) {
+  // the entity storage was released since this thread last touched it
+  uint32_t epoch = atomic_load_explicit(&_epoch, memory_order_relaxed);
+  if (_cache.epoch != epoch) {
+    _cache.epoch = epoch;
+    _cache.count = 0;
+  }
+}
+
+static ecs_Result _ensure_segments(uint32_t first, uint32_t count) {
+  uint32_t last_segment = (first + count - 1) >> ECS_ENTITY_SEGMENT_SHIFT;
+  for (uint32_t s = first >> ECS_ENTITY_SEGMENT_SHIFT; s <= last_segment; s++) {
+    if (atomic_load_explicit(&engine_ecs_entity.segments[s],
+                             memory_order_acquire) != NULL) {
+      continue;
+    }
+    ecs_EntitySegment *segment;
+    ALLOC(1, segment);
+    ecs_EntitySegment *expected = NULL;
+    if (!atomic_compare_exchange_strong_explicit(
+            &engine_ecs_entity.segments[s], &expected, segment,
+            memory_order_acq_rel, memory_order_acquire)) {
+      // another thread installed this segment first
+      FREE(1, segment);
+    }
+  }
+  return ECS_SUCCESS;
+}
+
+static bool _pop_block(void) {
+  uint64_t head = atomic_load_explicit(&engine_ecs_entity.free_blocks,
+                                       memory_order_acquire);
+  uint32_t first;
+  for (;;) {
+    first = (uint32_t)head;
+    if (first == 0) {
+      return false;
+    }
+    // the tag in the upper half changes on every update so a block that was
+    // popped and pushed again in between does not match
+    uint64_t next = (((head >> 32) + 1) << 32) |
+                    atomic_load_explicit(&ENTITY_SEGMENT_FIELD(first, free_block),
+                                         memory_order_relaxed);
+    if (atomic_compare_exchange_weak_explicit(&engine_ecs_entity.free_blocks,
+                                              &head, next, memory_order_acquire,
+                                              memory_order_acquire)) {
+      break;
+    }
+  }
+  for (uint32_t i = 0, e = first; i < ECS_ENTITY_BLOCK_SIZE; i++) {
+    _cache.index[_cache.count++] = e;
+    e = ENTITY_SEGMENT_FIELD(e, free_next);
+  }
+  return true;
+}
+
+static void _push_block(const uint32_t *index) {
+  for (uint32_t i = 0; i + 1 < ECS_ENTITY_BLOCK_SIZE; i++) {
+    ENTITY_SEGMENT_FIELD(index[i], free_next) = index[i + 1];
+  }
+  uint32_t first = index[0];
+  uint64_t head = atomic_load_explicit(&engine_ecs_entity.free_blocks,
+                                       memory_order_relaxed);
+  uint64_t next;
+  do {
+    atomic_store_explicit(&ENTITY_SEGMENT_FIELD(first, free_block),
+                          (uint32_t)head, memory_order_relaxed);
+    next = (((head >> 32) + 1) << 32) | first;
+  } while (!atomic_compare_exchange_weak_explicit(
+      &engine_ecs_entity.free_blocks, &head, next, memory_order_release,
+      memory_order_relaxed));
+}
+
+static ecs_Result _reserve_index(uint32_t *index_ptr) {
+  _validate_cache();
+
+  if (_cache.count == 0 && !_pop_block()) {
+    uint32_t first = atomic_fetch_add_explicit(
+        &engine_ecs_entity.length, ECS_ENTITY_BLOCK_SIZE, memory_order_relaxed);
+    if (first > ECS_ENTITY_MAX - ECS_ENTITY_BLOCK_SIZE) {
+      return ECS_ERROR_OUT_OF_MEMORY;
+    }
+    return_if_ERROR(_ensure_segments(first, ECS_ENTITY_BLOCK_SIZE));
+    // pushed in reverse so the block is handed out in ascending order
+    for (uint32_t i = ECS_ENTITY_BLOCK_SIZE; i > 0; i--) {
+      _cache.index[_cache.count++] = first + i - 1;
+    }
+  }
+
+  *index_ptr = _cache.index[--_cache.count];
+  return ECS_SUCCESS;
+}
+
 ecs_Result ecs_validate_entity_handle(ecs_EntityHandle entity,
                                       uint32_t *index_ptr) {
   uint32_t index = (uint32_t)(entity & 0xFFFFFFFF);
   uint32_t generation = (uint32_t)(entity >> 32);
-  if (index >= engine_ecs_entity.length) {
+  if (index >= atomic_load_explicit(&engine_ecs_entity.length,
+                                    memory_order_relaxed) ||
+      index >= ECS_ENTITY_MAX) {
     return ECS_ERROR_INVALID_ENTITY;
   }
-  if (generation != engine_ecs_entity.generation[index]) {
+  if (ecs_entity_segment(index) == NULL) {
+    return ECS_ERROR_INVALID_ENTITY;
+  }
+  if (generation != ENTITY_GENERATION(index)) {
     return ECS_ERROR_INVALID_ENTITY;
   }
   *index_ptr = index;
@@ -20,48 +133,53 @@ ecs_Result ecs_validate_entity_handle(ecs_EntityHandle entity,
 ecs_Result ecs_create_entity(ecs_EntityHandle *entity_ptr) {
   uint32_t index;
 
-  if (engine_ecs_entity.free_indexes.length > 0) {
-    index = *Vector_pop(&engine_ecs_entity.free_indexes);
-  } else {
-    index = engine_ecs_entity.length++;
-  }
+  return_if_ERROR(_reserve_index(&index));
 
-  if (engine_ecs_entity.length > engine_ecs_entity.capacity) {
-    size_t old_capacity = engine_ecs_entity.capacity;
-    size_t new_capacity = engine_ecs_entity.length + 1;
-    new_capacity += new_capacity >> 1;
-    RELOC(old_capacity, new_capacity, engine_ecs_entity.generation);
-    RELOC(old_capacity, new_capacity, engine_ecs_entity.layer_index);
-    RELOC(old_capacity, new_capacity,
-          engine_ecs_entity.archetype_index);
-    RELOC(old_capacity, new_capacity,
-          engine_ecs_entity.archetype_code);
-    engine_ecs_entity.capacity = new_capacity;
-  }
-
-  uint32_t generation = engine_ecs_entity.generation[index];
-
-  *entity_ptr = ((uint64_t)generation << 32) | (uint64_t)index;
+  *entity_ptr = ecs_construct_entity_handle_index_only(index);
 
   return ECS_SUCCESS;
 }
 
 ecs_Result ecs_free_entity(uint32_t entity_id) {
-  ++engine_ecs_entity.generation[entity_id];
-  if (!Vector_space_for(&engine_ecs_entity.free_indexes, 
-                        1)) {
-    return ECS_ERROR_OUT_OF_MEMORY;
+  ++ENTITY_GENERATION(entity_id);
+
+  _validate_cache();
+
+  _cache.index[_cache.count++] = entity_id;
+  if (_cache.count == ECS_ENTITY_BLOCK_SIZE * 2) {
+    _cache.count -= ECS_ENTITY_BLOCK_SIZE;
+    _push_block(_cache.index + _cache.count);
   }
-  *Vector_push(&engine_ecs_entity.free_indexes) = entity_id;
   return ECS_SUCCESS;
 }
 
-// -------------------------------------------------------------------------------------------------------------------------------------------------------------
+void ecs_release_entities(void) {
+  atomic_fetch_add_explicit(&_epoch, 1, memory_order_relaxed);
 
-static int _compar_component_index(const void *ap, const void *bp, void *ud) {
-  uint32_t a = *(uint32_t *)ap;
-  uint32_t b = *(uint32_t *)bp;
-  return a - b;
+  for (uint32_t s = 0; s < ECS_ENTITY_MAX_SEGMENTS; s++) {
+    ecs_EntitySegment *segment = atomic_load_explicit(
+        &engine_ecs_entity.segments[s], memory_order_relaxed);
+    if (segment == NULL) {
+      break;
+    }
+    FREE(1, segment);
+    atomic_store_explicit(&engine_ecs_entity.segments[s], NULL,
+                          memory_order_relaxed);
+  }
+  atomic_store_explicit(&engine_ecs_entity.length, 0, memory_order_relaxed);
+  atomic_store_explicit(&engine_ecs_entity.free_blocks, 0,
+                        memory_order_relaxed);
+}
+
+ecs_Result ecs_reserve_entities(uint32_t count,
+                                ecs_EntityHandle *entities_ptr) {
+  return_ERROR_INVALID_ARGUMENT_if(entities_ptr == NULL);
+
+  for (uint32_t i = 0; i < count; i++) {
+    return_if_ERROR(ecs_create_entity(&entities_ptr[i]));
+  }
+
+  return ECS_SUCCESS;
 }
 
 // -------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -71,6 +189,31 @@ ecs_Result ecs_spawn(const ecs_EntitySpawnInfo *spawn_info,
 
   return_ERROR_INVALID_ARGUMENT_if(spawn_info->count == 0);
 
+  int free_out_entities = entities_ptr == NULL;
+  if (free_out_entities) {
+    ALLOC(spawn_info->count, entities_ptr);
+  }
+
+  ecs_Result result = ecs_reserve_entities(spawn_info->count, entities_ptr);
+  if (result == ECS_SUCCESS) {
+    result = ecs_spawn_reserved(spawn_info, entities_ptr);
+  }
+
+  if (free_out_entities) {
+    FREE(spawn_info->count, entities_ptr);
+  }
+
+  return result;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------
+ecs_Result ecs_spawn_reserved(const ecs_EntitySpawnInfo *spawn_info,
+                              const ecs_EntityHandle *entities_ptr) {
+  return_ERROR_INVALID_ARGUMENT_if(spawn_info == NULL);
+  return_ERROR_INVALID_ARGUMENT_if(entities_ptr == NULL);
+
+  return_ERROR_INVALID_ARGUMENT_if(spawn_info->count == 0);
+
   uint32_t layer_index = UINT32_MAX;
   if (spawn_info->layer != ECS_INVALID_LAYER) {
     return_if_ERROR(
@@ -86,25 +229,19 @@ ecs_Result ecs_spawn(const ecs_EntitySpawnInfo *spawn_info,
       components.index[i] = spawn_info->components[i].component;
     }
     sort_qsort(components.index, components.count, sizeof(*components.index),
-          _compar_component_index, NULL);
+          ecs_compar_component_index, NULL);
     return_if_ERROR(
         ecs_resolve_archetype(components, &archetype_index));
   }
   ecs_Archetype *archetype = &engine_ecs_archetype.data[archetype_index];
 
-  int free_out_entities = entities_ptr == NULL;
-  if (free_out_entities) {
-    ALLOC(spawn_info->count, entities_ptr);
-  }
-
   for (uint32_t i = 0; i < spawn_info->count; i++) {
-    ecs_EntityHandle entity;
     uint32_t entity_index;
 
-    return_if_ERROR(ecs_create_entity(&entity));
-
     return_if_ERROR(
-        ecs_validate_entity_handle(entity, &entity_index));
+        ecs_validate_entity_handle(entities_ptr[i], &entity_index));
+
+    return_ERROR_INVALID_ARGUMENT_if(!ENTITY_IS_RESERVED(entity_index));
 
     if (layer_index != UINT32_MAX) {
       return_if_ERROR(
@@ -112,8 +249,6 @@ ecs_Result ecs_spawn(const ecs_EntitySpawnInfo *spawn_info,
     }
     return_if_ERROR(
         ecs_set_entity_archetype(entity_index, archetype_index));
-
-    entities_ptr[i] = entity;
   }
 
   for (uint32_t i = 0; i < spawn_info->num_components; i++) {
@@ -124,6 +259,11 @@ ecs_Result ecs_spawn(const ecs_EntitySpawnInfo *spawn_info,
 
     ecs_ASSERT(component_index != UINT32_MAX);
 
+    // cleared below with the components that were not given
+    if (spawn_component.data == NULL) {
+      continue;
+    }
+
     uint32_t component_size, component_offset;
     PagedSOA_decode_column(&archetype->paged_soa, component_index + 1,
                            &component_size, &component_offset);
@@ -151,7 +291,8 @@ ecs_Result ecs_spawn(const ecs_EntitySpawnInfo *spawn_info,
          spawn_info->components[j].component != archetype->components.index[i];
          j++)
       ;
-    if (j < spawn_info->num_components) {
+    if (j < spawn_info->num_components &&
+        spawn_info->components[j].data != NULL) {
       continue;
     }
     uint32_t component_size, component_offset;
@@ -173,10 +314,6 @@ ecs_Result ecs_spawn(const ecs_EntitySpawnInfo *spawn_info,
     ecs_init_components(entity_index, archetype_index);
   }
 
-  if (free_out_entities) {
-    FREE(spawn_info->count, entities_ptr);
-  }
-
   return ECS_SUCCESS;
 }
 
@@ -318,6 +455,13 @@ ecs_Result ecs_write_entity_component(ecs_EntityHandle entity,
     return ECS_ERROR_COMPONENT_DOES_NOT_EXIST;
   }
 
+  // stamp the write like a query would so modified filters and delta export
+  // see it
+  uint32_t version = ecs_next_version();
+  archetype->write[component_index] = version;
+  ((uint32_t *)PagedSOA_page(&archetype->paged_soa,
+                             ENTITY_ARCHETYPE_CODE(entity_index)))[1 + component_index] = version;
+
   *ptr = ecs_write(entity_index, component_index);
 
   return ECS_SUCCESS;
@@ -328,13 +472,18 @@ ecs_Result ecs_write_entity_component(ecs_EntityHandle entity,
 ecs_Result ecs_despawn(uint32_t count, const ecs_EntityHandle *entity) {
   uint32_t entity_index;
 
-  return_ERROR_INVALID_ARGUMENT_if(count > engine_ecs_entity.length);
   return_ERROR_INVALID_ARGUMENT_if(entity == NULL);
 
   for (uint32_t i = 0; i < count; i++) {
     return_if_ERROR(
         ecs_validate_entity_handle(entity[i], &entity_index));
 
+    if (ENTITY_IS_RESERVED(entity_index)) {
+      // reserved but never spawned
+      ecs_free_entity(entity_index);
+      continue;
+    }
+
     ecs_cleanup_components(entity_index,
                            ENTITY_ARCHETYPE_INDEX(entity_index));
     ecs_unset_entity_layer(entity_index);
@@ -348,7 +497,6 @@ ecs_Result ecs_despawn(uint32_t count, const ecs_EntityHandle *entity) {
 ecs_Result ecs_despawn_indexes(uint32_t count, const uint32_t *entity_indexes) {
   uint32_t entity_index;
 
-  return_ERROR_INVALID_ARGUMENT_if(count > engine_ecs_entity.length);
   return_ERROR_INVALID_ARGUMENT_if(entity_indexes == NULL);
 
   for (uint32_t i = 0; i < count; i++) {
@@ -38,11 +38,11 @@ static void _linear_remove_entity(ecs_Layer * data, uint32_t entity_index) {
 void ecs_unset_entity_layer(
    uint32_t             entity_index
 ) {
-  uint32_t old_layer_index = engine_ecs_entity.layer_index[entity_index];
+  uint32_t old_layer_index = ENTITY_LAYER_INDEX(entity_index);
   if(old_layer_index == 0) {
     return;
   }
-  engine_ecs_entity.layer_index[entity_index] = 0;
+  ENTITY_LAYER_INDEX(entity_index) = 0;
 
   ecs_Layer * data = &engine_ecs_layer.data[old_layer_index];
 
@@ -72,7 +72,7 @@ ecs_Result ecs_set_entity_layer(
    uint32_t             entity_index
   , uint32_t             layer_index
 ) {
-  engine_ecs_entity.layer_index[entity_index] = layer_index;
+  ENTITY_LAYER_INDEX(entity_index) = layer_index;
 
   if(layer_index == 0) {
     return ECS_SUCCESS;
@@ -6,6 +6,7 @@
 
 #include <stdlib.h>
 #include <stdalign.h>
+#include <stdatomic.h>
 #include <string.h>
 
 #define UNUSED(X) (void)X
@@ -34,6 +35,7 @@ typedef struct ecs_Component {
   ecs_ComponentInit init;
   ecs_ComponentCleanup cleanup;
   void * user_data;
+  const char * name;
 } ecs_Component;
 
 typedef struct ecs_ComponentSet {
@@ -62,15 +64,43 @@ struct ecs_global_Layer {
   ecs_Layer * data;
 };
 
+// entity metadata lives in fixed size segments that are never moved once
+// allocated, so other threads can hold on to them while new entities are
+// reserved
+#define ECS_ENTITY_SEGMENT_SHIFT 12
+#define ECS_ENTITY_SEGMENT_SIZE  (1u << ECS_ENTITY_SEGMENT_SHIFT)
+#define ECS_ENTITY_SEGMENT_MASK  (ECS_ENTITY_SEGMENT_SIZE - 1)
+#define ECS_ENTITY_MAX_SEGMENTS  (1u << 12)
+#define ECS_ENTITY_MAX           (ECS_ENTITY_SEGMENT_SIZE * ECS_ENTITY_MAX_SEGMENTS)
+
+// entity indexes move between the global pool and a thread's cache in blocks
+// of this many indexes
+#define ECS_ENTITY_BLOCK_SIZE    64
+
+typedef struct ecs_EntitySegment {
+  uint32_t generation[ECS_ENTITY_SEGMENT_SIZE];
+  uint32_t layer_index[ECS_ENTITY_SEGMENT_SIZE];
+  uint32_t archetype_index[ECS_ENTITY_SEGMENT_SIZE];
+  uint32_t archetype_code[ECS_ENTITY_SEGMENT_SIZE];
+
+  // links of free entities, only meaningful while the entity is free
+  //   free_next : next entity in the same block
+  //   free_block : first entity of the next block (on block heads)
+  uint32_t free_next[ECS_ENTITY_SEGMENT_SIZE];
+  _Atomic uint32_t free_block[ECS_ENTITY_SEGMENT_SIZE];
+} ecs_EntitySegment;
+
 struct ecs_global_Entity {
-  Vector(uint32_t) free_indexes;
-  uint32_t capacity;
-  uint32_t length;
-  uint32_t * generation;
-  uint32_t * layer_index;
-  uint32_t * archetype_index;
-  uint32_t * archetype_code;
-}; 
+  // number of entity indexes handed out to threads, indexes past this have
+  // never been used
+  _Atomic uint32_t length;
+
+  // stack of blocks of free entities, (tag << 32) | first entity index
+  // entity 0 is never freed so index 0 marks the empty stack
+  _Atomic uint64_t free_blocks;
+
+  _Atomic(ecs_EntitySegment *) segments[ECS_ENTITY_MAX_SEGMENTS];
+};
 
 // archetypes are 'sorted' by component sets
 // created as needed
@@ -87,10 +117,65 @@ struct ecs_global_Component {
   ecs_Component * data;
 };
 
+// singletons, each stored in its own allocation so pointers handed to queries
+// stay valid as more resources are registered
+typedef struct ecs_Resource {
+  uint32_t size;
+  uint32_t write;
+  const char * name;
+  void * data;
+} ecs_Resource;
+
+struct ecs_global_Resource {
+  uint32_t capacity;
+  uint32_t length;
+  ecs_Resource * data;
+};
+
+// structural changes recorded for delta export
+typedef enum ecs_DeltaEventKind {
+  ECS_DELTA_EVENT_PLACED,  // the entity entered an archetype, spawned or components changed
+  ECS_DELTA_EVENT_REMOVED,
+} ecs_DeltaEventKind;
+
+typedef struct ecs_DeltaEvent {
+  uint32_t version;
+  uint32_t kind;
+  ecs_EntityHandle entity;
+} ecs_DeltaEvent;
+
+struct ecs_global_Delta {
+  // bumped by every query execution, direct component write and recorded
+  // structural change. archetypes and page prefixes store the version of
+  // their last write per component
+  uint32_t version;
+  bool record;
+  Vector(ecs_DeltaEvent) events;
+
+  // an event could not be recorded, exports from before lost_version have to
+  // be full snapshots
+  bool lost;
+  uint32_t lost_version;
+};
+
 extern struct ecs_global_Layer engine_ecs_layer;
 extern struct ecs_global_Entity engine_ecs_entity;
 extern struct ecs_global_Archetype engine_ecs_archetype;
 extern struct ecs_global_Component  engine_ecs_component;
+extern struct ecs_global_Delta engine_ecs_delta;
+extern struct ecs_global_Resource engine_ecs_resource;
+
+static inline uint32_t ecs_next_version(void) {
+  return ++engine_ecs_delta.version;
+}
+
+// an entity handed to ecs_execute_query_for, slot is its archetype's position
+// in the query's archetype list
+typedef struct ecs_QueryTarget {
+  uint32_t slot;
+  uint32_t code;
+  uint32_t entity_index;
+} ecs_QueryTarget;
 
 struct ecs_Query {
   ecs_ComponentSet write_component_set;
@@ -101,6 +186,10 @@ struct ecs_Query {
   ecs_ComponentSet exclude_component_set;
   ecs_ComponentSet modified_component_set;
 
+  // resources use the same sorted sets, holding resource handles
+  ecs_ComponentSet read_resource_set;
+  ecs_ComponentSet write_resource_set;
+
   uint32_t component_count;
 
   uint32_t first_component_read;
@@ -116,19 +205,35 @@ struct ecs_Query {
   uint32_t * modified_index;
   uint32_t * modified_last_seen_write;
   uint32_t * size_offset;
+
+  Vector(ecs_QueryTarget) targets;
+};
+
+struct ecs_Prefab {
+  ecs_LayerHandle layer;
+  ecs_ArchetypeHandle archetype;
+  // one row of the archetype, the components back to back in archetype order
+  uint32_t row_size;
+  uint8_t * row;
 };
 
 // ============================================================================
-#define ENTITY_GENERATION(E)             engine_ecs_entity.generation[E]
-#define ENTITy_LAYER_INDEX(E)            engine_ecs_entity.layer_index[E]
-#define ENTITY_ARCHETYPE_INDEX(E)        engine_ecs_entity.archetype_index[E]
-#define ENTITY_ARCHETYPE_CODE(E)         engine_ecs_entity.archetype_code[E]
+static inline ecs_EntitySegment * ecs_entity_segment(uint32_t entity_index) {
+  return atomic_load_explicit(&engine_ecs_entity.segments[entity_index >> ECS_ENTITY_SEGMENT_SHIFT], memory_order_acquire);
+}
+
+#define ENTITY_SEGMENT_FIELD(E, F)       ecs_entity_segment(E)->F[(E) & ECS_ENTITY_SEGMENT_MASK]
+#define ENTITY_GENERATION(E)             ENTITY_SEGMENT_FIELD(E, generation)
+#define ENTITY_LAYER_INDEX(E)            ENTITY_SEGMENT_FIELD(E, layer_index)
+#define ENTITY_ARCHETYPE_INDEX(E)        ENTITY_SEGMENT_FIELD(E, archetype_index)
+#define ENTITY_ARCHETYPE_CODE(E)         ENTITY_SEGMENT_FIELD(E, archetype_code)
 #define ENTITY_ARCHETYPE_CODE_PAGE(E)    (ENTITY_ARCHETYPE_CODE(E) >> 16)
 #define ENTITY_ARCHETYPE_CODE_INDEX(E)   (ENTITY_ARCHETYPE_CODE(E) & 0xFFFF)
 #define ENTITY_ARCHETYPE_DATA(E)         (&engine_ecs_archetype.data[ENTITY_ARCHETYPE_INDEX(E)])
-#define ENTITY_DATA_BLOCK(E)             ENTITY_ARCHETYPE_DATA(E)->paged_soa.pages[ENTITY_ARCHETYPE_CODE_PAGE(E)]
-#define ENTITY_DATA_BLOCK_DATA(E)        ((void *)(ENTITY_DATA_BLOCK(E) + sizeof(uint32_t)))
-#define ENTITY_DATA_ENTITY_INDEX(E)      ((uint32_t *)ENTITY_DATA_BLOCK_DATA(E))[ENTITY_ARCHETYPE_CODE_INDEX(E)]
+#define ENTITY_DATA_ENTITY_INDEX(E)      (*(uint32_t *)PagedSOA_write(&ENTITY_ARCHETYPE_DATA(E)->paged_soa, ENTITY_ARCHETYPE_CODE(E), 0))
+// reserved entities have not been placed in any archetype yet, only entity 0
+// occupies code 0 of archetype 0
+#define ENTITY_IS_RESERVED(E)            (ENTITY_ARCHETYPE_INDEX(E) == 0 && ENTITY_ARCHETYPE_CODE(E) == 0)
 
 static inline ecs_EntityHandle ecs_construct_entity_handle(uint32_t generation, uint32_t index) {
   return ((uint64_t)generation << 32) | (uint64_t)index;
@@ -198,6 +303,13 @@ ecs_Result ecs_init_components(uint32_t entity_index, uint32_t archetype_index);
 ecs_Result ecs_cleanup_component(uint32_t entity_index, uint32_t archetype_index, uint32_t component_index);
 ecs_Result ecs_cleanup_components(uint32_t entity_index, uint32_t archetype_index);
 
+// sort_qsort comparator for arrays of component indexes
+static inline int ecs_compar_component_index(const void *ap, const void *bp, void *ud) {
+  uint32_t a = *(const uint32_t *)ap;
+  uint32_t b = *(const uint32_t *)bp;
+  return a < b ? -1 : a > b;
+}
+
 ecs_Result ecs_ComponentSet_init(
     ecs_ComponentSet          * set
   , uint32_t                          count
@@ -275,6 +387,8 @@ ecs_Result ecs_free_entity(
    uint32_t             entity_id
 );
 
+void ecs_release_entities(void);
+
 // ============================================================================
 // archetype.c
 ecs_Result ecs_resolve_archetype(
@@ -290,3 +404,10 @@ ecs_Result ecs_set_entity_archetype(
     uint32_t             entity_index
   , uint32_t             archetype_index
 );
+
+// ============================================================================
+// delta.c
+void ecs_record_delta_event(
+    ecs_DeltaEventKind   kind
+  , uint32_t             entity_index
+);
@@ -23,6 +23,14 @@ ecs_Result ecs_realloc(
   , size_t               alignment
   , void *             * out_ptr
 ) {
+  // realloc to zero frees and returns NULL, which is not a failure here
+  if(new_size == 0) {
+    if(ptr != NULL && old_size > 0) {
+      memory_free(ptr, old_size, alignment);
+    }
+    *out_ptr = NULL;
+    return ECS_SUCCESS;
+  }
   *out_ptr = memory_realloc(ptr, old_size, new_size, alignment);
   if(*out_ptr == NULL) {
     return ECS_ERROR_OUT_OF_MEMORY;
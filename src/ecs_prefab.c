@@ -0,0 +1,185 @@
+#include "ecs_local.h"
+
+#include "sort.h"
+
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------
+ecs_Result ecs_create_prefab(const ecs_PrefabCreateInfo *create_info,
+                             ecs_Prefab **prefab_ptr) {
+  return_ERROR_INVALID_ARGUMENT_if(create_info == NULL);
+  return_ERROR_INVALID_ARGUMENT_if(prefab_ptr == NULL);
+
+  if (create_info->layer != ECS_INVALID_LAYER) {
+    uint32_t layer_index;
+    return_if_ERROR(
+        ecs_validate_layer_handle(create_info->layer, &layer_index));
+  }
+
+  uint32_t archetype_index;
+  {
+    ecs_ComponentSet components;
+    components.count = create_info->num_components;
+    ALLOC(components.count, components.index);
+    for (uint32_t i = 0; i < components.count; ++i) {
+      components.index[i] = create_info->components[i].component;
+    }
+    sort_qsort(components.index, components.count, sizeof(*components.index),
+               ecs_compar_component_index, NULL);
+    return_if_ERROR(ecs_resolve_archetype(components, &archetype_index));
+  }
+  const ecs_Archetype *archetype = &engine_ecs_archetype.data[archetype_index];
+
+  ecs_Prefab *prefab;
+  ALLOC(1, prefab);
+
+  prefab->layer = create_info->layer;
+  prefab->archetype = archetype_index;
+  prefab->row_size = 0;
+  for (uint32_t i = 0; i < archetype->components.count; i++) {
+    prefab->row_size += archetype->paged_soa.size_offset[i + 1] >> 16;
+  }
+
+  // components that are not given, including ones pulled in as requirements,
+  // stay zero like they would with ecs_spawn
+  ALLOC(prefab->row_size, prefab->row);
+
+  for (uint32_t i = 0; i < create_info->num_components; i++) {
+    const ecs_EntitySpawnComponent *component = &create_info->components[i];
+    if (component->data == NULL) {
+      continue;
+    }
+    uint32_t offset = 0;
+    for (uint32_t j = 0; j < archetype->components.count; j++) {
+      uint32_t size = archetype->paged_soa.size_offset[j + 1] >> 16;
+      if (archetype->components.index[j] == component->component) {
+        memcpy(prefab->row + offset, component->data, size);
+        break;
+      }
+      offset += size;
+    }
+  }
+
+  *prefab_ptr = prefab;
+
+  return ECS_SUCCESS;
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------
+void ecs_destroy_prefab(ecs_Prefab *prefab) {
+  if (prefab == NULL) {
+    return;
+  }
+  FREE(prefab->row_size, prefab->row);
+  FREE(1, prefab);
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------
+// fill count consecutive elements with the element at the start of dst,
+// doubling the copied range each time so long runs become a few large copies
+static void _replicate(uint8_t *dst, uint32_t size, uint32_t count) {
+  uint32_t filled = 1;
+  while (filled < count) {
+    uint32_t n = filled < count - filled ? filled : count - filled;
+    memcpy(dst + (size_t)filled * size, dst, (size_t)n * size);
+    filled += n;
+  }
+}
+
+static void _copy_image(const ecs_Prefab *prefab, ecs_Archetype *archetype,
+                        uint32_t code, uint32_t count) {
+  uint32_t page, index;
+  PagedSOA_decode_code(&archetype->paged_soa, code, &page, &index);
+
+  const uint8_t *read = prefab->row;
+  for (uint32_t i = 0; i < archetype->components.count; i++) {
+    uint32_t size, offset;
+    PagedSOA_decode_column(&archetype->paged_soa, i + 1, &size, &offset);
+    uint8_t *write =
+        PagedSOA_raw_write(&archetype->paged_soa, page, index, size, offset);
+    memcpy(write, read, size);
+    _replicate(write, size, count);
+    read += size;
+  }
+}
+
+// -------------------------------------------------------------------------------------------------------------------------------------------------------------
+ecs_Result ecs_spawn_prefab(const ecs_Prefab *prefab, uint32_t count,
+                            uint32_t num_overrides,
+                            const ecs_EntitySpawnComponent *overrides,
+                            ecs_EntityHandle *entities_ptr) {
+  return_ERROR_INVALID_ARGUMENT_if(prefab == NULL);
+  return_ERROR_INVALID_ARGUMENT_if(count == 0);
+  return_ERROR_INVALID_ARGUMENT_if(num_overrides > 0 && overrides == NULL);
+
+  uint32_t layer_index = UINT32_MAX;
+  if (prefab->layer != ECS_INVALID_LAYER) {
+    return_if_ERROR(ecs_validate_layer_handle(prefab->layer, &layer_index));
+  }
+
+  int free_out_entities = entities_ptr == NULL;
+  if (free_out_entities) {
+    ALLOC(count, entities_ptr);
+  }
+
+  ecs_Result result = ecs_reserve_entities(count, entities_ptr);
+
+  for (uint32_t i = 0; result == ECS_SUCCESS && i < count; i++) {
+    uint32_t entity_index = (uint32_t)(entities_ptr[i] & 0xFFFFFFFF);
+    if (layer_index != UINT32_MAX) {
+      result = ecs_set_entity_layer(entity_index, layer_index);
+    }
+    if (result == ECS_SUCCESS) {
+      result = ecs_set_entity_archetype(entity_index, prefab->archetype);
+    }
+  }
+
+  ecs_Archetype *archetype = &engine_ecs_archetype.data[prefab->archetype];
+
+  // fresh rows are pushed in order, so most of the entities land in runs of
+  // consecutive codes inside a page. only reused codes break the runs up
+  for (uint32_t i = 0; result == ECS_SUCCESS && i < count;) {
+    uint32_t first_code = ENTITY_ARCHETYPE_CODE((uint32_t)entities_ptr[i]);
+    uint32_t run = 1;
+    while (i + run < count &&
+           ENTITY_ARCHETYPE_CODE((uint32_t)entities_ptr[i + run]) ==
+               first_code + run) {
+      run++;
+    }
+    _copy_image(prefab, archetype, first_code, run);
+    i += run;
+  }
+
+  for (uint32_t i = 0; result == ECS_SUCCESS && i < num_overrides; i++) {
+    const ecs_EntitySpawnComponent *override = &overrides[i];
+
+    uint32_t component_index = ecs_ComponentSet_order_of(
+        &archetype->components, override->component);
+    if (component_index == UINT32_MAX) {
+      result = ECS_ERROR_COMPONENT_DOES_NOT_EXIST;
+      break;
+    }
+
+    uint32_t size, offset;
+    PagedSOA_decode_column(&archetype->paged_soa, component_index + 1, &size,
+                           &offset);
+
+    const uint8_t *read = override->data;
+    uint32_t stride = override->stride ? override->stride : size;
+
+    for (uint32_t j = 0; j < count; j++) {
+      uint32_t entity_index = (uint32_t)(entities_ptr[j] & 0xFFFFFFFF);
+      memcpy(ecs_write(entity_index, component_index), read, size);
+      read += stride;
+    }
+  }
+
+  for (uint32_t j = 0; result == ECS_SUCCESS && j < count; j++) {
+    ecs_init_components((uint32_t)(entities_ptr[j] & 0xFFFFFFFF),
+                        prefab->archetype);
+  }
+
+  if (free_out_entities) {
+    FREE(count, entities_ptr);
+  }
+
+  return result;
+}
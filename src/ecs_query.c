@@ -1,5 +1,6 @@
 #include "ecs_local.h"
 #include "log.h"
+#include "sort.h"
 
 #include <stdbool.h>
 #include <stdio.h>
@@ -24,8 +25,9 @@ ecs_Result ecs_create_query(const ecs_QueryCreateInfo *create_info,
     query->component[ci] = create_info->write_components[i];
     ci++;
   }
-  return_if_ERROR(ecs_ComponentSet_init(
-      &query->write_component_set, query->component_count, query->component));
+  return_if_ERROR(ecs_ComponentSet_init(&query->write_component_set,
+                                        create_info->num_write_components,
+                                        query->component));
 
   for (uint32_t i = 0; i < create_info->num_read_components; i++) {
     query->component[ci] = create_info->read_components[i];
@@ -84,6 +86,13 @@ ecs_Result ecs_create_query(const ecs_QueryCreateInfo *create_info,
 
   Vector_free(&other);
 
+  return_if_ERROR(ecs_ComponentSet_init(&query->read_resource_set,
+                                        create_info->num_read_resources,
+                                        create_info->read_resources));
+  return_if_ERROR(ecs_ComponentSet_init(&query->write_resource_set,
+                                        create_info->num_write_resources,
+                                        create_info->write_resources));
+
   *query_ptr = query;
 
   return ECS_SUCCESS;
@@ -154,14 +163,16 @@ static ecs_Result ecs_update_query(ecs_Query *query) {
       }
     }
 
-    query->size_offset[index * query->component_count + 0] =
-        archetype->paged_soa.size_offset[0];
+    uint32_t *size_offset =
+        query->size_offset + index * (1 + query->component_count);
+
+    size_offset[0] = archetype->paged_soa.size_offset[0];
 
     for (uint32_t k = 0; k < query->component_count; k++) {
       uint32_t archetype_component_index = ecs_ComponentSet_order_of(
           &archetype->components, query->component[k]);
       if (archetype_component_index != UINT32_MAX) {
-        query->size_offset[index * query->component_count + (1 + k)] =
+        size_offset[1 + k] =
             archetype->paged_soa.size_offset[archetype_component_index + 1];
       }
     }
@@ -170,13 +181,18 @@ static ecs_Result ecs_update_query(ecs_Query *query) {
   return ECS_SUCCESS;
 }
 
-ecs_Result ecs_execute_query(ecs_Query *query, ecs_QueryFunction cb, void *ud) {
-  return_ERROR_INVALID_ARGUMENT_if(query == NULL);
-  return_ERROR_INVALID_ARGUMENT_if(cb == NULL);
+typedef void (*_PageFunction)(ecs_Query *query, uint8_t *page,
+                              uint32_t live_count, const uint32_t *size_offset,
+                              void *context);
 
+// visits every page the query has to look at, stamping write versions and
+// honoring modified filters on the way
+static ecs_Result _execute_pages(ecs_Query *query, _PageFunction fn,
+                                 void *context) {
   return_if_ERROR(ecs_update_query(query));
 
-  uint8_t **runtime = query->runtime;
+  uint32_t version = ecs_next_version();
+
   const uint32_t *size_offset = query->size_offset;
   const uint32_t *write_index = query->write_index;
   const uint32_t *modified_index = query->modified_index;
@@ -192,13 +208,12 @@ ecs_Result ecs_execute_query(ecs_Query *query, ecs_QueryFunction cb, void *ud) {
       if(modified_last_seen_write[k] != archetype->write[modified_index[k]]) {
         skip = false;
       }
-      modified_last_seen_write[k] = archetype->write[modified_index[k]];
     }
 
     if(!skip) {
       // mark the archetype's component version
       for (uint32_t j = 0; j < query->write_component_set.count; j++) {
-        archetype->write[write_index[j]] += 1;
+        archetype->write[write_index[j]] = version;
       }
 
       for (uint32_t j = 0; j < archetype->paged_soa.num_pages; j++) {
@@ -209,10 +224,12 @@ ecs_Result ecs_execute_query(ecs_Query *query, ecs_QueryFunction cb, void *ud) {
           break;
         }
 
-        // if the query watches modification, see if the page has changes
+        // if the query watches modification, see if the page was written
+        // after the last run, on the first run every page counts as written
         skip = query->modified_component_set.count > 0;
         for(uint32_t k = 0; k < query->modified_component_set.count; k++) {
-          if(page_last_seen_write[modified_index[k]] != modified_last_seen_write[k]) {
+          if(modified_last_seen_write[k] == 0 ||
+             (int32_t)(page_last_seen_write[modified_index[k]] - modified_last_seen_write[k]) > 0) {
             skip = false;
             break;
           }
@@ -224,25 +241,15 @@ ecs_Result ecs_execute_query(ecs_Query *query, ecs_QueryFunction cb, void *ud) {
             page_last_seen_write[write_index[k]] = archetype->write[write_index[k]];
           }
 
-          const uint32_t *entity = (const uint32_t *)(page + (size_offset[0] & 0xFFFF));
-          for (uint32_t c = 0, C = query->component_count; c < C; c++) {
-            runtime[c] =
-                size_offset[1 + c] ? page + (size_offset[1 + c] & 0xFFFF) : NULL;
-          }
-          for (uint32_t k = 0, K = *live_count; k < K;) {
-            if (*entity) {
-              cb(ud, *entity, (void **)runtime);
-              k++;
-            }
-            entity++;
-            for (uint32_t c = 0, C = query->component_count; c < C; c++) {
-              runtime[c] += size_offset[1 + c] >> 16;
-            }
-          }
+          fn(query, page, *live_count, size_offset, context);
         }
       }
     }
 
+    for(uint32_t k = 0; k < query->modified_component_set.count; k++) {
+      modified_last_seen_write[k] = archetype->write[modified_index[k]];
+    }
+
     archetype_handle++;
     size_offset += 1 + query->component_count;
     write_index += query->write_component_set.count;
@@ -253,6 +260,196 @@ ecs_Result ecs_execute_query(ecs_Query *query, ecs_QueryFunction cb, void *ud) {
   return ECS_SUCCESS;
 }
 
+typedef struct {
+  ecs_QueryFunction cb;
+  void *ud;
+} _RowContext;
+
+static void _execute_rows(ecs_Query *query, uint8_t *page, uint32_t live_count,
+                          const uint32_t *size_offset, void *context) {
+  const _RowContext *row = (const _RowContext *)context;
+  uint8_t **runtime = query->runtime;
+
+  const uint32_t *entity = (const uint32_t *)(page + (size_offset[0] & 0xFFFF));
+  for (uint32_t c = 0, C = query->component_count; c < C; c++) {
+    runtime[c] =
+        size_offset[1 + c] ? page + (size_offset[1 + c] & 0xFFFF) : NULL;
+  }
+  for (uint32_t k = 0; k < live_count;) {
+    if (*entity) {
+      row->cb(row->ud, ecs_construct_entity_handle_index_only(*entity),
+              (void **)runtime);
+      k++;
+    }
+    entity++;
+    for (uint32_t c = 0, C = query->component_count; c < C; c++) {
+      runtime[c] += size_offset[1 + c] >> 16;
+    }
+  }
+}
+
+ecs_Result ecs_execute_query(ecs_Query *query, ecs_QueryFunction cb, void *ud) {
+  return_ERROR_INVALID_ARGUMENT_if(query == NULL);
+  return_ERROR_INVALID_ARGUMENT_if(cb == NULL);
+
+  _RowContext row = {.cb = cb, .ud = ud};
+  return _execute_pages(query, _execute_rows, &row);
+}
+
+typedef struct {
+  ecs_QueryPageFunction cb;
+  void *ud;
+} _PageContext;
+
+static void _execute_page(ecs_Query *query, uint8_t *page, uint32_t live_count,
+                          const uint32_t *size_offset, void *context) {
+  const _PageContext *whole = (const _PageContext *)context;
+  uint8_t **runtime = query->runtime;
+
+  // rows past the last live one were never used or are free at the end
+  const uint32_t *entity = (const uint32_t *)(page + (size_offset[0] & 0xFFFF));
+  uint32_t count = 0;
+  for (uint32_t k = 0; k < live_count; count++) {
+    if (entity[count]) {
+      k++;
+    }
+  }
+
+  for (uint32_t c = 0, C = query->component_count; c < C; c++) {
+    runtime[c] =
+        size_offset[1 + c] ? page + (size_offset[1 + c] & 0xFFFF) : NULL;
+  }
+  whole->cb(whole->ud, count, entity, (void **)runtime);
+}
+
+ecs_Result ecs_execute_query_pages(ecs_Query *query, ecs_QueryPageFunction cb,
+                                   void *ud) {
+  return_ERROR_INVALID_ARGUMENT_if(query == NULL);
+  return_ERROR_INVALID_ARGUMENT_if(cb == NULL);
+
+  _PageContext whole = {.cb = cb, .ud = ud};
+  return _execute_pages(query, _execute_page, &whole);
+}
+
+bool ecs_queries_conflict(const ecs_Query *a, const ecs_Query *b) {
+  // component_set holds both the read and the written components
+  return ecs_ComponentSet_intersects(&a->write_component_set,
+                                     &b->component_set) ||
+         ecs_ComponentSet_intersects(&b->write_component_set,
+                                     &a->component_set) ||
+         ecs_ComponentSet_intersects(&a->write_resource_set,
+                                     &b->read_resource_set) ||
+         ecs_ComponentSet_intersects(&a->write_resource_set,
+                                     &b->write_resource_set) ||
+         ecs_ComponentSet_intersects(&b->write_resource_set,
+                                     &a->read_resource_set);
+}
+
+static int _compare_archetype_handle(const void *ap, const void *bp,
+                                     void *ud) {
+  uint32_t a = *(const uint32_t *)ap;
+  uint32_t b = *(const uint32_t *)bp;
+  return a < b ? -1 : a > b;
+}
+
+static int _compare_target(const void *ap, const void *bp, void *ud) {
+  const ecs_QueryTarget *a = (const ecs_QueryTarget *)ap;
+  const ecs_QueryTarget *b = (const ecs_QueryTarget *)bp;
+  if (a->slot != b->slot) {
+    return a->slot < b->slot ? -1 : 1;
+  }
+  return a->code < b->code ? -1 : a->code > b->code;
+}
+
+ecs_Result ecs_execute_query_for(ecs_Query *query,
+                                 const ecs_EntityHandle *entities,
+                                 uint32_t count, ecs_QueryFunction cb,
+                                 void *ud) {
+  return_ERROR_INVALID_ARGUMENT_if(query == NULL);
+  return_ERROR_INVALID_ARGUMENT_if(cb == NULL);
+  return_ERROR_INVALID_ARGUMENT_if(count > 0 && entities == NULL);
+
+  return_if_ERROR(ecs_update_query(query));
+
+  // resolve every handle to its slot in the query, entities that are stale or
+  // live in an archetype the query does not match are dropped here
+  query->targets.length = 0;
+  if (!Vector_set_capacity(&query->targets, count)) {
+    return ECS_ERROR_OUT_OF_MEMORY;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t entity_index;
+    if (ecs_validate_entity_handle(entities[i], &entity_index) != ECS_SUCCESS ||
+        ENTITY_IS_RESERVED(entity_index)) {
+      continue;
+    }
+    uint32_t archetype_index = ENTITY_ARCHETYPE_INDEX(entity_index);
+    const ecs_ArchetypeHandle *slot =
+        sort_bsearch(&archetype_index, query->archetype,
+                     query->archetype_length, sizeof(*query->archetype),
+                     _compare_archetype_handle, NULL);
+    if (slot == NULL) {
+      continue;
+    }
+    ecs_QueryTarget *target = Vector_push(&query->targets);
+    target->slot = slot - query->archetype;
+    target->code = ENTITY_ARCHETYPE_CODE(entity_index);
+    target->entity_index = entity_index;
+  }
+
+  // grouping by archetype then code walks each page once, in row order
+  if (query->targets.length > 1) {
+    Vector_qsort(&query->targets, _compare_target, NULL);
+  }
+
+  uint32_t version = ecs_next_version();
+
+  uint8_t **runtime = query->runtime;
+  const uint32_t num_write = query->write_component_set.count;
+  const ecs_QueryTarget *target = query->targets.data;
+  const ecs_QueryTarget *end = target + query->targets.length;
+  while (target < end) {
+    uint32_t slot = target->slot;
+    const uint32_t *size_offset =
+        query->size_offset + slot * (1 + query->component_count);
+    const uint32_t *write_index = query->write_index + slot * num_write;
+    const ecs_Archetype *archetype =
+        &engine_ecs_archetype.data[query->archetype[slot]];
+
+    // mark the archetype's component version
+    for (uint32_t j = 0; j < num_write; j++) {
+      archetype->write[write_index[j]] = version;
+    }
+
+    while (target < end && target->slot == slot) {
+      uint32_t page_index = target->code >> 16;
+      uint8_t *page = archetype->paged_soa.pages[page_index];
+      uint32_t *page_last_seen_write = (uint32_t *)page + 1;
+
+      // mark the page written with archetype's component version
+      for (uint32_t k = 0; k < num_write; k++) {
+        page_last_seen_write[write_index[k]] = archetype->write[write_index[k]];
+      }
+
+      for (; target < end && target->slot == slot &&
+             (target->code >> 16) == page_index;
+           target++) {
+        uint32_t row = target->code & 0xFFFF;
+        for (uint32_t c = 0, C = query->component_count; c < C; c++) {
+          runtime[c] = size_offset[1 + c]
+                           ? page + (size_offset[1 + c] & 0xFFFF) +
+                                 (size_offset[1 + c] >> 16) * row
+                           : NULL;
+        }
+        cb(ud, ecs_construct_entity_handle_index_only(target->entity_index),
+           (void **)runtime);
+      }
+    }
+  }
+
+  return ECS_SUCCESS;
+}
+
 void ecs_destroy_query(ecs_Query *query) {
   if (query == NULL) {
     return;
@@ -260,6 +457,8 @@ void ecs_destroy_query(ecs_Query *query) {
   ecs_ComponentSet_free(&query->component_set);
   ecs_ComponentSet_free(&query->require_component_set);
   ecs_ComponentSet_free(&query->exclude_component_set);
+  ecs_ComponentSet_free(&query->read_resource_set);
+  ecs_ComponentSet_free(&query->write_resource_set);
   FREE(query->component_count, query->component);
   FREE(query->component_count, query->runtime);
   FREE(query->archetype_length, query->archetype);
@@ -271,5 +470,6 @@ void ecs_destroy_query(ecs_Query *query) {
        query->modified_index);
   FREE(query->archetype_length * query->modified_component_set.count,
        query->modified_last_seen_write);
+  Vector_free(&query->targets);
   FREE(1, query);
 }
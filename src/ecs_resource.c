@@ -0,0 +1,57 @@
+#include "ecs_local.h"
+
+#define RESOURCE_ALIGNMENT 16
+
+ecs_Result ecs_register_resource(const ecs_ResourceCreateInfo *create_info,
+                                 ecs_ResourceHandle *resource_ptr) {
+  return_ERROR_INVALID_ARGUMENT_if(create_info == NULL);
+  return_ERROR_INVALID_ARGUMENT_if(resource_ptr == NULL);
+  return_ERROR_INVALID_ARGUMENT_if(create_info->size == 0);
+
+  void *data;
+  return_if_ERROR(ecs_malloc(create_info->size, RESOURCE_ALIGNMENT, &data));
+  if (create_info->data != NULL) {
+    memcpy(data, create_info->data, create_info->size);
+  }
+
+  if (!Vector_space_for(&engine_ecs_resource, 1)) {
+    ecs_free(data, create_info->size, RESOURCE_ALIGNMENT);
+    return ECS_ERROR_OUT_OF_MEMORY;
+  }
+
+  *resource_ptr = engine_ecs_resource.length;
+
+  *Vector_push(&engine_ecs_resource) = (ecs_Resource){
+      .size = create_info->size,
+      .write = 0,
+      .name = create_info->name,
+      .data = data};
+
+  return ECS_SUCCESS;
+}
+
+ecs_Result ecs_read_resource(ecs_ResourceHandle resource, const void **ptr) {
+  return_ERROR_INVALID_ARGUMENT_if(resource >= engine_ecs_resource.length);
+  return_ERROR_INVALID_ARGUMENT_if(ptr == NULL);
+
+  *ptr = engine_ecs_resource.data[resource].data;
+
+  return ECS_SUCCESS;
+}
+
+ecs_Result ecs_write_resource(ecs_ResourceHandle resource, void **ptr) {
+  return_ERROR_INVALID_ARGUMENT_if(resource >= engine_ecs_resource.length);
+  return_ERROR_INVALID_ARGUMENT_if(ptr == NULL);
+
+  engine_ecs_resource.data[resource].write = ecs_next_version();
+  *ptr = engine_ecs_resource.data[resource].data;
+
+  return ECS_SUCCESS;
+}
+
+uint32_t ecs_resource_version(ecs_ResourceHandle resource) {
+  if (resource >= engine_ecs_resource.length) {
+    return 0;
+  }
+  return engine_ecs_resource.data[resource].write;
+}
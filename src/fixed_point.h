@@ -23,4 +23,69 @@ typedef uint32_t FixedPointUnorm32;
 #define CPP_TYPE_CONVERT_FixedPoint16_float(A) ((float)(A) / 65536.0f)
 #define CPP_TYPE_CONVERT_FixedPointUnorm16_float(A) ((float)(A) / 65536.0f)
 
+// Q16.16 arithmetic that saturates instead of wrapping. integer only, so the
+// same inputs give the same bits on every platform and compiler, and branch
+// free so loops over it vectorize
+#define FixedPoint16_ONE ((FixedPoint16)0x10000)
+#define FixedPoint16_MAX ((FixedPoint16)INT32_MAX)
+#define FixedPoint16_MIN ((FixedPoint16)INT32_MIN)
+
+// a product kept at 24 fraction bits. up to 64 of them sum in an int64_t
+// without overflow before one FixedPoint16_narrow
+#define FixedPoint16_WIDE_MUL(A, B) (((int64_t)(A) * (B)) >> 8)
+
+static inline FixedPoint16 FixedPoint16_saturate(int64_t a) {
+  a = a > INT32_MAX ? INT32_MAX : a;
+  a = a < INT32_MIN ? INT32_MIN : a;
+  return (FixedPoint16)a;
+}
+
+// a sum of FixedPoint16_WIDE_MUL back to Q16.16, rounding to nearest
+static inline FixedPoint16 FixedPoint16_narrow(int64_t wide) { return FixedPoint16_saturate((wide + (1 << 7)) >> 8); }
+
+static inline FixedPoint16 FixedPoint16_add(FixedPoint16 a, FixedPoint16 b) { return FixedPoint16_saturate((int64_t)a + b); }
+
+static inline FixedPoint16 FixedPoint16_sub(FixedPoint16 a, FixedPoint16 b) { return FixedPoint16_saturate((int64_t)a - b); }
+
+static inline FixedPoint16 FixedPoint16_neg(FixedPoint16 a) { return FixedPoint16_saturate(-(int64_t)a); }
+
+static inline FixedPoint16 FixedPoint16_mul(FixedPoint16 a, FixedPoint16 b) { return FixedPoint16_narrow(FixedPoint16_WIDE_MUL(a, b)); }
+
+// division by zero saturates toward the sign of a
+static inline FixedPoint16 FixedPoint16_div(FixedPoint16 a, FixedPoint16 b) {
+  if(b == 0) {
+    return a < 0 ? FixedPoint16_MIN : FixedPoint16_MAX;
+  }
+  return FixedPoint16_saturate((int64_t)a * 65536 / b);
+}
+
+// bit by bit integer square root of a << 16, 0 for negative a
+static inline FixedPoint16 FixedPoint16_sqrt(FixedPoint16 a) {
+  uint64_t x = a > 0 ? (uint64_t)a << 16 : 0, r = 0, bit = (uint64_t)1 << 62;
+  while(bit > x) {
+    bit >>= 2;
+  }
+  while(bit) {
+    if(x >= r + bit) {
+      x -= r + bit;
+      r = (r >> 1) + bit;
+    } else {
+      r >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (FixedPoint16)r;
+}
+
+// the CPP_TYPE_CONVERT ones wrap out of range values, these saturate and round.
+// NaN is 0
+static inline FixedPoint16 FixedPoint16_from_float(float a) {
+  double x = a == a ? (double)a * 65536.0 : 0;
+  x = x > INT32_MAX ? INT32_MAX : x;
+  x = x < INT32_MIN ? INT32_MIN : x;
+  return (FixedPoint16)(x < 0 ? x - 0.5 : x + 0.5);
+}
+
+static inline float FixedPoint16_to_float(FixedPoint16 a) { return (float)a / 65536.0f; }
+
 #endif // fixed_point_h_INCLUDED
@@ -2,98 +2,317 @@
 #include "color.h"
 #include "draw.h"
 #include "resource.h"
+#include "string.h"
+#include "vector.h"
 
-#include <uchar.h>
+// ====================================================================================================================
+// utf-8
+uint32_t Font_decode(const char **text) {
+  const uint8_t *s = (const uint8_t *)*text;
+  uint32_t c = s[0];
+  uint32_t length, least;
 
-const struct Font_Glyph *Font_findGlyph(const struct Font *font, const char *text) {
-  // TODO handle utf8
-  char32_t c = *text;
+  if(c < 0x80) {
+    *text += 1;
+    return c;
+  } else if((c & 0xE0) == 0xC0) {
+    length = 2;
+    least = 0x80;
+    c &= 0x1F;
+  } else if((c & 0xF0) == 0xE0) {
+    length = 3;
+    least = 0x800;
+    c &= 0x0F;
+  } else if((c & 0xF8) == 0xF0) {
+    length = 4;
+    least = 0x10000;
+    c &= 0x07;
+  } else {
+    *text += 1;
+    return FONT_REPLACEMENT_CHARACTER;
+  }
 
-  // TODO bsearch
-  for(uint32_t i = 0; i < font->num_glyphs; i++) {
-    if(font->glyphs[i].codepoint == c) {
-      return &font->glyphs[i];
+  // a sequence cut short stops at the byte that is not a continuation, the
+  // terminator included
+  for(uint32_t i = 1; i < length; i++) {
+    if((s[i] & 0xC0) != 0x80) {
+      *text += i;
+      return FONT_REPLACEMENT_CHARACTER;
     }
+    c = c << 6 | (s[i] & 0x3F);
   }
+  *text += length;
 
-  // return space
-  return &font->glyphs[0];
+  // overlong encodings, surrogates and past the last codepoint
+  if(c < least || (c >= 0xD800 && c <= 0xDFFF) || c > 0x10FFFF) {
+    return FONT_REPLACEMENT_CHARACTER;
+  }
+  return c;
 }
 
-void Font_measure(struct Font *font, const char *text, float size, float spacing, float *width, float *height) {
-  *height = size;
-  *width = 0;
+// ====================================================================================================================
+// glyph lookup
+//
+// ascii indexes a table directly, everything above goes through an open
+// addressed table at most half full. a zero index is glyphs[0], which is also
+// what a missing codepoint gets
+#define FONT_DIRECT_GLYPHS 128
 
-  while(*text) {
-    const struct Font_Glyph *glyph = Font_findGlyph(font, text);
+struct Font_Lookup {
+  uint16_t direct[FONT_DIRECT_GLYPHS];
+  uint32_t mask;
+  struct {
+    uint32_t codepoint;
+    uint32_t index;
+  } *hashed;
+};
 
-    // TODO utf8 advance
-    text++;
+static inline uint32_t _hash_codepoint(uint32_t codepoint) {
+  return codepoint * 2654435769u;
+}
 
-    (*width) += glyph->advance * size + spacing;
+static struct Font_Lookup *_build_lookup(struct Font *font) {
+  struct Font_Lookup *lookup = memory_new(struct Font_Lookup);
+  memory_clear(lookup, sizeof(*lookup));
+
+  uint32_t num_hashed = 0;
+  for(uint32_t i = 0; i < font->num_glyphs; i++) {
+    num_hashed += font->glyphs[i].codepoint >= FONT_DIRECT_GLYPHS;
+  }
+  uint32_t size = 2;
+  while(size < num_hashed * 2) {
+    size <<= 1;
   }
+  lookup->mask = size - 1;
+  lookup->hashed = memory_alloc(sizeof(*lookup->hashed) * size, alignof(*lookup->hashed));
+  memory_clear(lookup->hashed, sizeof(*lookup->hashed) * size);
+
+  // the first glyph of a codepoint wins, as the scan this replaces did
+  for(uint32_t i = font->num_glyphs; i-- > 0;) {
+    uint32_t codepoint = font->glyphs[i].codepoint;
+    if(codepoint < FONT_DIRECT_GLYPHS) {
+      lookup->direct[codepoint] = i;
+      continue;
+    }
+    uint32_t slot = _hash_codepoint(codepoint) & lookup->mask;
+    while(lookup->hashed[slot].codepoint != 0 && lookup->hashed[slot].codepoint != codepoint) {
+      slot = (slot + 1) & lookup->mask;
+    }
+    lookup->hashed[slot].codepoint = codepoint;
+    lookup->hashed[slot].index = i;
+  }
+
+  return lookup;
 }
 
+const struct Font_Glyph *Font_findCodepoint(struct Font *font, uint32_t codepoint) {
+  if(font->lookup == NULL) {
+    font->lookup = _build_lookup(font);
+  }
+  const struct Font_Lookup *lookup = font->lookup;
+
+  if(codepoint < FONT_DIRECT_GLYPHS) {
+    return &font->glyphs[lookup->direct[codepoint]];
+  }
+
+  uint32_t slot = _hash_codepoint(codepoint) & lookup->mask;
+  while(lookup->hashed[slot].codepoint != 0) {
+    if(lookup->hashed[slot].codepoint == codepoint) {
+      return &font->glyphs[lookup->hashed[slot].index];
+    }
+    slot = (slot + 1) & lookup->mask;
+  }
+
+  return &font->glyphs[0];
+}
+
+const struct Font_Glyph *Font_findGlyph(struct Font *font, const char *text) {
+  return Font_findCodepoint(font, Font_decode(&text));
+}
+
+// ====================================================================================================================
+// text runs
+//
+// a run is a string laid out at the origin, in white, at one size and spacing.
+// the cache is set associative, a string hashes to one set and replaces the
+// way of it used longest ago. strings too long for the cache are laid out
+// again on every call
+#define FONT_RUN_SET_BITS 6
+#define FONT_RUN_WAYS 4
+#define FONT_RUN_MAX_LENGTH 256
+
 #define FONT_DRAW_CHARACTERS_PER_BATCH 1024
 
-void Font_draw(struct Font *font, const char *text, float x, float y, float size, float spacing, Color color) {
-  struct draw_ScreenVertex *vertexes = NULL;
-  uint32_t *indexes = NULL;
-  uint32_t i = 0;
+struct _Run {
+  const struct Font *font;
+  uint64_t hash;
+  MStr text;
+  float size;
+  float spacing;
+  float width;
+  uint32_t used;
+  Vector(struct draw_ScreenVertex) vertexes;
+};
 
-  size_t length = string_size(text);
+static struct {
+  struct _Run runs[FONT_RUN_WAYS << FONT_RUN_SET_BITS];
+  struct _Run uncached;
+  uint32_t stamp;
 
-  struct GraphicsImage *image = &LoadedResource_from_image(&font->atlas)->image;
-  float s_scale = R_ONE / image->width;
-  float t_scale = R_ONE / image->height;
+  // the same six indexes for every quad of a batch
+  uint32_t indexes[6 * FONT_DRAW_CHARACTERS_PER_BATCH];
+  bool have_indexes;
+} _runs;
 
-  while(*text) {
-    if(i == 0) {
-      draw_ScreenVertex_begin_draw(6 * min(FONT_DRAW_CHARACTERS_PER_BATCH, length), &indexes,
-                               4 * min(FONT_DRAW_CHARACTERS_PER_BATCH, length), &vertexes);
+static uint64_t _run_hash(const struct Font *font, const char *text, float size, float spacing) {
+  union {
+    float f;
+    uint32_t u;
+  } s = {.f = size}, p = {.f = spacing};
+  uint64_t hash = string_hash(text);
+  hash ^= (uint64_t)s.u << 32 | p.u;
+  hash ^= (uintptr_t)font;
+  return hash * 0x9E3779B97F4A7C15ull;
+}
+
+static struct _Run *_find_run(const struct Font *font, const char *text, float size, float spacing, uint64_t hash) {
+  struct _Run *set = _runs.runs + FONT_RUN_WAYS * (hash >> (64 - FONT_RUN_SET_BITS));
+  for(uint32_t i = 0; i < FONT_RUN_WAYS; i++) {
+    struct _Run *run = &set[i];
+    if(run->text != NULL && run->hash == hash && run->font == font && run->size == size && run->spacing == spacing &&
+       string_equals((CStr)run->text, text)) {
+      run->used = ++_runs.stamp;
+      return run;
     }
+  }
+  return NULL;
+}
 
-    const struct Font_Glyph *glyph = Font_findGlyph(font, text);
+static struct _Run *_replace_run(const struct Font *font, const char *text, float size, float spacing, uint64_t hash) {
+  struct _Run *run;
+  if(string_size(text) > FONT_RUN_MAX_LENGTH) {
+    run = &_runs.uncached;
+  } else {
+    struct _Run *set = _runs.runs + FONT_RUN_WAYS * (hash >> (64 - FONT_RUN_SET_BITS));
+    run = &set[0];
+    for(uint32_t i = 1; i < FONT_RUN_WAYS && run->text != NULL; i++) {
+      if(set[i].text == NULL || set[i].used < run->used) {
+        run = &set[i];
+      }
+    }
+    string_free(run->text);
+    run->text = string_clone(text);
+  }
+
+  run->font = font;
+  run->hash = hash;
+  run->size = size;
+  run->spacing = spacing;
+  run->used = ++_runs.stamp;
+  run->vertexes.length = 0;
+  return run;
+}
+
+static void _layout_run(struct Font *font, const char *text, struct _Run *run) {
+  struct GraphicsImage *image = &LoadedResource_from_image(&font->atlas)->image;
+  float s_scale = (image->s1 - image->s0) / image->width;
+  float t_scale = (image->t1 - image->t0) / image->height;
+  float size = run->size;
+  float x = 0;
+
+  while(*text) {
+    const struct Font_Glyph *glyph = Font_findCodepoint(font, Font_decode(&text));
 
-    // TODO utf8 advance
-    text++;
+    Vector_space_for(&run->vertexes, 4);
+    struct draw_ScreenVertex *vertexes = run->vertexes.data + run->vertexes.length;
+    run->vertexes.length += 4;
 
 #define EMIT(I, V, H)                                                                                                  \
-  vertexes[i * 4 + I].xy[0] = x + glyph->plane_##H * size;                                                             \
-  vertexes[i * 4 + I].xy[1] = y + (1.0f - glyph->plane_##V) * size;                                                    \
-  vertexes[i * 4 + I].rgba[0] = color.r;                                                                               \
-  vertexes[i * 4 + I].rgba[1] = color.g;                                                                               \
-  vertexes[i * 4 + I].rgba[2] = color.b;                                                                               \
-  vertexes[i * 4 + I].rgba[3] = color.a;                                                                               \
-  vertexes[i * 4 + I].st[0] = glyph->atlas_##H * s_scale;                                                              \
-  vertexes[i * 4 + I].st[1] = 1.0f - (glyph->atlas_##V * t_scale);
+  vertexes[I].xy[0] = x + glyph->plane_##H * size;                                                                     \
+  vertexes[I].xy[1] = (1.0f - glyph->plane_##V) * size;                                                                \
+  vertexes[I].rgba[0] = 1.0f;                                                                                          \
+  vertexes[I].rgba[1] = 1.0f;                                                                                          \
+  vertexes[I].rgba[2] = 1.0f;                                                                                          \
+  vertexes[I].rgba[3] = 1.0f;                                                                                          \
+  vertexes[I].st[0] = image->s0 + glyph->atlas_##H * s_scale;                                                          \
+  vertexes[I].st[1] = image->t1 - glyph->atlas_##V * t_scale;
     EMIT(0, bottom, left)
     EMIT(1, bottom, right)
     EMIT(2, top, right)
     EMIT(3, top, left)
 #undef EMIT
 
-    indexes[i * 6 + 0] = i * 4 + 0;
-    indexes[i * 6 + 1] = i * 4 + 2;
-    indexes[i * 6 + 2] = i * 4 + 1;
-    indexes[i * 6 + 3] = i * 4 + 2;
-    indexes[i * 6 + 4] = i * 4 + 0;
-    indexes[i * 6 + 5] = i * 4 + 3;
-
-    x += glyph->advance * size + spacing;
-    i++;
-    length--;
-
-    if(i >= FONT_DRAW_CHARACTERS_PER_BATCH) {
-      draw_ScreenVertex_draw(image, 0, 6 * FONT_DRAW_CHARACTERS_PER_BATCH);
-      draw_ScreenVertex_end_draw();
-      i = 0;
+    x += glyph->advance * size + run->spacing;
+  }
+
+  run->width = x;
+}
+
+static struct _Run *_run(struct Font *font, const char *text, float size, float spacing) {
+  uint64_t hash = _run_hash(font, text, size, spacing);
+  struct _Run *run = _find_run(font, text, size, spacing, hash);
+  if(run == NULL) {
+    run = _replace_run(font, text, size, spacing, hash);
+    _layout_run(font, text, run);
+  }
+  return run;
+}
+
+// ====================================================================================================================
+void Font_measure(struct Font *font, const char *text, float size, float spacing, float *width, float *height) {
+  *height = size;
+  *width = 0;
+
+  // a laid out run already knows, anything else is not worth laying out only to measure
+  struct _Run *run = _find_run(font, text, size, spacing, _run_hash(font, text, size, spacing));
+  if(run != NULL) {
+    *width = run->width;
+    return;
+  }
+
+  while(*text) {
+    const struct Font_Glyph *glyph = Font_findCodepoint(font, Font_decode(&text));
+    (*width) += glyph->advance * size + spacing;
+  }
+}
+
+void Font_draw(struct Font *font, const char *text, float x, float y, float size, float spacing, Color color) {
+  if(!_runs.have_indexes) {
+    for(uint32_t i = 0; i < FONT_DRAW_CHARACTERS_PER_BATCH; i++) {
+      _runs.indexes[i * 6 + 0] = i * 4 + 0;
+      _runs.indexes[i * 6 + 1] = i * 4 + 2;
+      _runs.indexes[i * 6 + 2] = i * 4 + 1;
+      _runs.indexes[i * 6 + 3] = i * 4 + 2;
+      _runs.indexes[i * 6 + 4] = i * 4 + 0;
+      _runs.indexes[i * 6 + 5] = i * 4 + 3;
     }
+    _runs.have_indexes = true;
   }
 
-  if(i >= 0) {
-    draw_ScreenVertex_draw(image, 0, 6 * i);
+  const struct _Run *run = _run(font, text, size, spacing);
+  struct GraphicsImage *image = &LoadedResource_from_image(&font->atlas)->image;
+
+  uint32_t num_characters = run->vertexes.length / 4;
+  for(uint32_t first = 0; first < num_characters; first += FONT_DRAW_CHARACTERS_PER_BATCH) {
+    uint32_t count = min(FONT_DRAW_CHARACTERS_PER_BATCH, num_characters - first);
+
+    struct draw_ScreenVertex *vertexes;
+    uint32_t *indexes;
+    draw_ScreenVertex_begin_draw(6 * count, &indexes, 4 * count, &vertexes);
+
+    memory_copy(indexes, sizeof(*indexes) * 6 * count, _runs.indexes, sizeof(*indexes) * 6 * count);
+
+    // written once and never read back, the mapping may be write combined
+    const struct draw_ScreenVertex *source = run->vertexes.data + 4 * first;
+    for(uint32_t i = 0; i < 4 * count; i++) {
+      vertexes[i] = (struct draw_ScreenVertex) {
+          .xy = { source[i].xy[0] + x, source[i].xy[1] + y }
+        , .rgba = { color.r, color.g, color.b, color.a }
+        , .st = { source[i].st[0], source[i].st[1] }
+        };
+    }
+
+    draw_ScreenVertex_draw(image, 0, 6 * count);
     draw_ScreenVertex_end_draw();
   }
 }
-
@@ -24,14 +24,27 @@ struct Font_Glyph {
   float atlas_bottom;
 };
 
+struct Font_Lookup;
+
 struct Font {
   struct Image atlas;
   enum Font_AtlasType atlas_type;
   uint32_t num_glyphs;
   const struct Font_Glyph *glyphs;
+
+  // built on first use from glyphs
+  struct Font_Lookup *lookup;
 };
 
-const struct Font_Glyph *Font_findGlyph(const struct Font *font, const char *text);
+#define FONT_REPLACEMENT_CHARACTER 0xFFFD
+
+// the codepoint at *text, moves *text past it. a malformed sequence decodes as
+// FONT_REPLACEMENT_CHARACTER and moves past the bytes that were read
+uint32_t Font_decode(const char **text);
+
+// glyphs[0] for a codepoint the font does not have
+const struct Font_Glyph *Font_findCodepoint(struct Font *font, uint32_t codepoint);
+const struct Font_Glyph *Font_findGlyph(struct Font *font, const char *text);
 void Font_measure(struct Font *font, const char *text, float size, float spacing, float *width, float *height);
 void Font_draw(struct Font *font, const char *text, float x, float y, float size, float spacing, Color color);
 
@@ -2,11 +2,35 @@
 #include "log.h"
 #include "math.h"
 #include "format.h"
+#include "configuration.h"
+#include "platform.h"
+#include "profile.h"
+#include "vector.h"
 
 #include <stdlib.h> // for ssize_t
+#include <string.h> // for memcmp
 
 #define SOURCE_NAMESPACE core.gl
 
+// linked programs are kept here as glGetProgramBinary returns them, keyed by
+// their source and the driver. empty does not cache
+static CONFIGURATION_STRING(SOURCE_NAMESPACE, program_cache_path, "cache/programs");
+
+// bytes of the ring temporary buffers come from, it grows when one frame needs more
+static CONFIGURATION_INTEGER(SOURCE_NAMESPACE, temporary_buffer_size, 16 << 20);
+
+// frames the CPU may write ahead of the GPU before waiting on it
+static CONFIGURATION_INTEGER(SOURCE_NAMESPACE, temporary_buffer_frames, 3);
+
+// alignment of every temporary allocation, enough for uniform and storage buffer offsets
+#define TEMPORARY_ALIGNMENT 256
+
+#define TEMPORARY_MAX_FRAMES 8
+
+// uniform locations and storage buffer bindings past these are set every draw
+#define SHADOW_MAX_LOCATIONS (2 * GL_MAX_UNIFORMS)
+#define SHADOW_MAX_STORAGE_BUFFERS 32
+
 GL_IMPL_STRUCT(DrawArraysIndirectCommand, uint32(count), uint32(instance_count), uint32(first),
                     uint32(base_instance))
 
@@ -23,30 +47,31 @@ const char shader_prelude[] = "#version 460 core\n"
 struct gl_TypeInfo {
   const char *name;
   GLenum target;
+  uint32_t size;
 };
 
 static struct gl_TypeInfo type_info[] = {
-    [gl_Type_float] = {"float"},
-    [gl_Type_float2] = {"vec2"},
-    [gl_Type_float3] = {"vec3"},
-    [gl_Type_float4] = {"vec4"},
-    [gl_Type_int] = {"int"},
-    [gl_Type_int2] = {"ivec2"},
-    [gl_Type_int3] = {"ivec3"},
-    [gl_Type_int4] = {"ivec4"},
-    [gl_Type_uint] = {"uint"},
-    [gl_Type_uint2] = {"uvec2"},
-    [gl_Type_uint3] = {"uvec3"},
-    [gl_Type_uint4] = {"uvec4"},
-    [gl_Type_float2x2] = {"mat2"},
-    [gl_Type_float3x3] = {"mat3"},
-    [gl_Type_float4x4] = {"mat4"},
-    [gl_Type_float2x3] = {"mat2x3"},
-    [gl_Type_float3x2] = {"mat3x2"},
-    [gl_Type_float2x4] = {"mat2x4"},
-    [gl_Type_float4x2] = {"mat4x2"},
-    [gl_Type_float3x4] = {"mat3x4"},
-    [gl_Type_float4x3] = {"mat4x3"},
+    [gl_Type_float] = {"float", 0, 4},
+    [gl_Type_float2] = {"vec2", 0, 8},
+    [gl_Type_float3] = {"vec3", 0, 12},
+    [gl_Type_float4] = {"vec4", 0, 16},
+    [gl_Type_int] = {"int", 0, 4},
+    [gl_Type_int2] = {"ivec2", 0, 8},
+    [gl_Type_int3] = {"ivec3", 0, 12},
+    [gl_Type_int4] = {"ivec4", 0, 16},
+    [gl_Type_uint] = {"uint", 0, 4},
+    [gl_Type_uint2] = {"uvec2", 0, 8},
+    [gl_Type_uint3] = {"uvec3", 0, 12},
+    [gl_Type_uint4] = {"uvec4", 0, 16},
+    [gl_Type_float2x2] = {"mat2", 0, 16},
+    [gl_Type_float3x3] = {"mat3", 0, 36},
+    [gl_Type_float4x4] = {"mat4", 0, 64},
+    [gl_Type_float2x3] = {"mat2x3", 0, 24},
+    [gl_Type_float3x2] = {"mat3x2", 0, 24},
+    [gl_Type_float2x4] = {"mat2x4", 0, 32},
+    [gl_Type_float4x2] = {"mat4x2", 0, 32},
+    [gl_Type_float3x4] = {"mat3x4", 0, 48},
+    [gl_Type_float4x3] = {"mat4x3", 0, 48},
     [gl_Type_sampler1D] =
         {
             .name = "sampler1D",
@@ -79,25 +104,122 @@ static struct gl_TypeInfo type_info[] = {
         },
 };
 
-struct TemporaryBuffer {
+typedef Vector(GLuint) TemporaryBuffers;
+
+// a frame still read by the GPU, it holds the ring up to end until its fence
+// signals. the ring may grow more than once in a frame, every buffer it left
+// behind is deleted with the frame
+struct TemporaryFrame {
+  uint64_t end;
+  GLsync fence;
+  TemporaryBuffers retired_buffers;
+};
+
+// one persistently mapped buffer for every type. head and tail count bytes
+// since the start and never wrap, the offset into the buffer is modulo size.
+// the bytes between tail and head belong to frames in flight and the current one
+struct TemporaryRing {
   GLuint buffer;
-  GLenum type;
-  GLsizei size;
-  GLsizei offset;
-  void *mapped_memory;
+  void *mapping;
+  uint64_t size;
+  uint64_t head;
+  uint64_t tail;
+
+  uint64_t frame_start;
+  uint64_t frame_used;
+  TemporaryBuffers retired_buffers;
+  struct TemporaryFrame frames[TEMPORARY_MAX_FRAMES];
+  uint32_t first_frame;
+  uint32_t num_frames;
+
+  uint32_t high_water;
+  uint32_t last_frame_used;
+  uint32_t waits;
+};
+
+// what the context holds, a call that would set the same again is skipped. the
+// flags are int8_t so gl_invalidateState can mark them unknown with -1, the
+// vertex buffer bindings belong to the vertex array and are forgotten with it
+struct StateShadow {
+  GLuint program;
+  GLuint vertex_array;
+  int8_t depth_test_enable;
+  int8_t depth_mask;
+  float depth_range_min;
+  float depth_range_max;
+  int8_t blend_enable;
+  GLenum blend_src_factor;
+  GLenum blend_dst_factor;
+
+  GLuint texture[GL_MAX_IMAGES];
+  GLuint sampler[GL_MAX_IMAGES];
+
+  GLuint element_buffer;
+  struct {
+    GLuint buffer;
+    GLintptr offset;
+    GLsizei stride;
+  } vertex_buffer[GL_MAX_BINDINGS];
+
+  GLuint storage_buffer[SHADOW_MAX_STORAGE_BUFFERS];
+  GLuint draw_indirect_buffer;
+  GLuint dispatch_indirect_buffer;
+};
+
+// uniforms are state of the program, one of these per program name
+struct ProgramShadow {
+  uint32_t known;
+  struct {
+    bool transpose;
+    float value[16];
+  } uniform[SHADOW_MAX_LOCATIONS];
+};
+
+// a draw waiting in the queue, the buffers are copied because callers reuse
+// theirs for the next draw
+struct QueuedDraw {
+  uint64_t key;
+  uint32_t sequence;
+  const struct gl_DrawState *state;
+  struct gl_DrawAssets assets;
+  struct gl_Buffer element_buffer;
+  struct gl_Buffer vertex_buffers[GL_MAX_BINDINGS];
+  ssize_t count;
+  ssize_t instancecount;
+  int32_t basevertex;
+  uint32_t baseinstance;
 };
 
 static struct {
-  uint32_t num_temporary_buffers;
-  struct TemporaryBuffer *temporary_buffers;
+  struct TemporaryRing temporary;
+
+  bool shadow_valid;
+  struct StateShadow shadow;
+  Vector(struct ProgramShadow) programs;
+
+  Vector(struct QueuedDraw) queue;
+
+  struct gl_CallStats frame_calls;
+  struct gl_CallStats calls;
 
   char *script_builder_ptr;
   uint32_t script_builder_cap;
   uint32_t script_builder_len;
 
+  struct {
+    bool initialized;
+    bool enabled;
+    uint64_t driver;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t reported;
+    uint64_t compile_nanoseconds;
+    uint64_t saved_nanoseconds;
+  } program_cache;
+
   uint32_t draw_index;
   uint32_t emit_index;
-} _ = {0, 0, 0, 0};
+} _;
 
 static void script_builder_init(void) {
   _.script_builder_len = 0;
@@ -107,7 +229,7 @@ static void script_builder_init(void) {
 static void script_builder_add(const char *format, ...) {
   va_list ap;
   va_start(ap, format);
-  uint32_t len = format_count(format, ap);
+  uint32_t len = format_count_v(format, ap);
   va_end(ap);
   if(_.script_builder_len + len + 1 > _.script_builder_cap) {
     uint32_t old_cap = _.script_builder_cap;
@@ -116,7 +238,7 @@ static void script_builder_add(const char *format, ...) {
     _.script_builder_ptr = memory_realloc(_.script_builder_ptr, sizeof(*_.script_builder_ptr) * old_cap, sizeof(*_.script_builder_ptr) * _.script_builder_cap, 1);
   }
   va_start(ap, format);
-  format_string(_.script_builder_ptr + _.script_builder_len, _.script_builder_cap - _.script_builder_len, format, ap);
+  format_string_v(_.script_builder_ptr + _.script_builder_len, _.script_builder_cap - _.script_builder_len, format, ap);
   _.script_builder_len += len;
   _.script_builder_ptr[_.script_builder_len] = 0;
   va_end(ap);
@@ -286,8 +408,205 @@ static void _gl_linkProgram(GLuint program) {
   }
 }
 
+// ====================================================================================================================
+// program cache
+//
+// one file per program named by its key, the key hashes the driver and every
+// stage source. the header keeps what compiling took so a load can tell what
+// it saved
+#define PROGRAM_CACHE_MAGIC 0x42504C47 // GLPB
+#define PROGRAM_CACHE_MAX_STAGES 2
+
+struct ProgramCacheHeader {
+  uint32_t magic;
+  uint32_t format;
+  uint64_t key;
+  uint64_t compile_nanoseconds;
+  uint32_t length;
+  uint32_t reserved;
+};
+
+static uint64_t _hash(uint64_t hash, const void *data, size_t size) {
+  const uint8_t *bytes = data;
+  for(size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001B3ull;
+  }
+  return hash;
+}
+
+static void _program_cache_initialize(void) {
+  _.program_cache.initialized = true;
+
+  GLint num_formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+  if(program_cache_path == NULL || program_cache_path[0] == 0 || num_formats <= 0) {
+    return;
+  }
+  if(!platform_make_directory_synchronous((const char *)program_cache_path)) {
+    WARNING(SOURCE_NAMESPACE, "no program cache, could not create %s", (const char *)program_cache_path);
+    return;
+  }
+
+  uint64_t hash = 0xCBF29CE484222325ull;
+  GLenum names[] = {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION};
+  for(uint32_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    const char *string = (const char *)glGetString(names[i]);
+    if(string != NULL) {
+      hash = _hash(hash, string, string_size(string) + 1);
+    }
+  }
+  _.program_cache.driver = hash;
+  _.program_cache.enabled = true;
+}
+
+static uint64_t _program_cache_key(uint32_t num_stages, const char *const *sources, const GLint *lengths) {
+  uint64_t key = _.program_cache.driver;
+  for(uint32_t i = 0; i < num_stages; i++) {
+    key = _hash(key, &lengths[i], sizeof(lengths[i]));
+    key = _hash(key, sources[i], lengths[i]);
+  }
+  return key;
+}
+
+static void _program_cache_path(char *path, size_t size, uint64_t key) {
+  format_string(path, size, "%s/%llx.bin", (const char *)program_cache_path, (unsigned long long)key);
+}
+
+static GLuint _program_cache_load(uint64_t key, uint64_t *compile_nanoseconds) {
+  char path[1024];
+  _program_cache_path(path, sizeof(path), key);
+
+  struct platform_File *file = memory_alloc(platform_File_size(), 8);
+  if(!platform_File_open_synchronous(file, path, platform_File_READ)) {
+    memory_free(file, platform_File_size(), 8);
+    return 0;
+  }
+
+  GLuint program = 0;
+  struct ProgramCacheHeader header;
+  uint64_t read;
+  if(platform_File_read_synchronous(file, 0, &header, sizeof(header), &read) && read == sizeof(header) &&
+     header.magic == PROGRAM_CACHE_MAGIC && header.key == key && header.length > 0) {
+    void *binary = memory_alloc(header.length, 8);
+    if(platform_File_read_synchronous(file, sizeof(header), binary, header.length, &read) && read == header.length) {
+      program = glCreateProgram();
+      glProgramBinary(program, header.format, binary, header.length);
+      GLint status = GL_FALSE;
+      glGetProgramiv(program, GL_LINK_STATUS, &status);
+      if(status != GL_TRUE) {
+        // a driver update may refuse binaries it wrote before
+        glDeleteProgram(program);
+        program = 0;
+      }
+    }
+    memory_free(binary, header.length, 8);
+  }
+
+  platform_File_close_synchronous(file);
+  memory_free(file, platform_File_size(), 8);
+
+  *compile_nanoseconds = header.compile_nanoseconds;
+  return program;
+}
+
+static void _program_cache_store(GLuint program, uint64_t key, uint64_t compile_nanoseconds) {
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if(length <= 0) {
+    return;
+  }
+
+  struct ProgramCacheHeader header = {
+    .magic = PROGRAM_CACHE_MAGIC, .key = key, .compile_nanoseconds = compile_nanoseconds, .length = length};
+  void *binary = memory_alloc(length, 8);
+  glGetProgramBinary(program, length, NULL, &header.format, binary);
+
+  char path[1024];
+  _program_cache_path(path, sizeof(path), key);
+
+  struct platform_File *file = memory_alloc(platform_File_size(), 8);
+  if(platform_File_open_synchronous(file, path, platform_File_CREATE | platform_File_WRITE | platform_File_TRUNCATE)) {
+    uint64_t written = 0;
+    bool ok = platform_File_write_synchronous(file, 0, &header, sizeof(header), &written) && written == sizeof(header) &&
+              platform_File_write_synchronous(file, sizeof(header), binary, length, &written) && written == (uint64_t)length;
+    platform_File_close_synchronous(file);
+    if(!ok) {
+      WARNING(SOURCE_NAMESPACE, "could not write program cache %s", path);
+    }
+  }
+  memory_free(file, platform_File_size(), 8);
+  memory_free(binary, length, 8);
+}
+
+// links the stages into a program, from the cache when it has one. the shader
+// objects are only made when the program had to be compiled
+static GLuint _gl_createProgram(uint32_t num_stages, const GLenum *types, const char *const *sources, const GLint *lengths,
+                                uint32_t *shader_objects) {
+  if(!_.program_cache.initialized) {
+    _program_cache_initialize();
+  }
+
+  uint64_t start = platform_time_nanoseconds();
+  uint64_t key = 0;
+  if(_.program_cache.enabled) {
+    key = _program_cache_key(num_stages, sources, lengths);
+    uint64_t compile_nanoseconds;
+    GLuint program = _program_cache_load(key, &compile_nanoseconds);
+    if(program != 0) {
+      uint64_t load_nanoseconds = platform_time_nanoseconds() - start;
+      _.program_cache.hits++;
+      if(compile_nanoseconds > load_nanoseconds) {
+        _.program_cache.saved_nanoseconds += compile_nanoseconds - load_nanoseconds;
+      }
+      return program;
+    }
+  }
+
+  GLuint program = glCreateProgram();
+  for(uint32_t i = 0; i < num_stages; i++) {
+    GLuint shader = glCreateShader(types[i]);
+    glShaderSource(shader, 1, &sources[i], &lengths[i]);
+    _gl_compileShader(shader);
+    glAttachShader(program, shader);
+    shader_objects[i] = shader;
+  }
+  if(_.program_cache.enabled) {
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+  _gl_linkProgram(program);
+
+  uint64_t compile_nanoseconds = platform_time_nanoseconds() - start;
+  _.program_cache.misses++;
+  _.program_cache.compile_nanoseconds += compile_nanoseconds;
+
+  GLint status = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if(_.program_cache.enabled && status == GL_TRUE) {
+    _program_cache_store(program, key, compile_nanoseconds);
+  }
+  return program;
+}
+
+// programs are made when first drawn, which is mostly the first frame
+static void _program_cache_report(void) {
+  uint32_t total = _.program_cache.hits + _.program_cache.misses;
+  if(total == _.program_cache.reported) {
+    return;
+  }
+  _.program_cache.reported = total;
+
+  // whole milliseconds and a fraction of microseconds, %f does not print
+  // thousands of milliseconds right
+  uint64_t compile = _.program_cache.compile_nanoseconds / 1000, saved = _.program_cache.saved_nanoseconds / 1000;
+  INFO(SOURCE_NAMESPACE, "programs: %u from cache, %u compiled in %llu.%03u ms, cache saved %llu.%03u ms",
+       _.program_cache.hits, _.program_cache.misses, (unsigned long long)(compile / 1000), (uint32_t)(compile % 1000),
+       (unsigned long long)(saved / 1000), (uint32_t)(saved % 1000));
+}
+
+// ====================================================================================================================
 void gl_initializeDrawState(const struct gl_DrawState *state) {
-  if(state->vertex_shader != NULL && state->vertex_shader_object == 0) {
+  if(state->vertex_shader != NULL && state->fragment_shader != NULL && state->program_object == 0) {
     script_builder_init();
     script_builder_add("%s", shader_prelude);
     script_builder_add_vertex_format(state);
@@ -297,13 +616,11 @@ void gl_initializeDrawState(const struct gl_DrawState *state) {
     script_builder_add_shader_requisites((const struct gl_ShaderSnippet *)state->vertex_shader);
     script_builder_add("%s", state->vertex_shader->code);
 
-    GLuint shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(shader, 1, (const char *const *)&_.script_builder_ptr, (const GLint *)&_.script_builder_len);
-    _gl_compileShader(shader);
-    *(GLuint *)(&state->vertex_shader_object) = shader;
-  }
+    // the builder is reused for the fragment source
+    GLint vertex_length = _.script_builder_len;
+    char *vertex_source = memory_alloc(vertex_length + 1, 1);
+    memory_copy(vertex_source, vertex_length + 1, _.script_builder_ptr, vertex_length + 1);
 
-  if(state->fragment_shader != NULL && state->fragment_shader_object == 0) {
     script_builder_init();
     script_builder_add("%s", shader_prelude);
     script_builder_add_uniform_format((const struct gl_PipelineState *)state, GL_FRAGMENT_BIT);
@@ -312,18 +629,17 @@ void gl_initializeDrawState(const struct gl_DrawState *state) {
     script_builder_add_shader_requisites((const struct gl_ShaderSnippet *)state->fragment_shader);
     script_builder_add("%s", state->fragment_shader->code);
 
-    GLuint shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(shader, 1, (const char *const *)&_.script_builder_ptr, (const GLint *)&_.script_builder_len);
-    _gl_compileShader(shader);
-    *(GLuint *)(&state->fragment_shader_object) = shader;
-  }
+    GLenum types[] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+    const char *sources[] = {vertex_source, _.script_builder_ptr};
+    GLint lengths[] = {vertex_length, _.script_builder_len};
+    uint32_t shader_objects[2] = {0, 0};
+    GLuint program = _gl_createProgram(2, types, sources, lengths, shader_objects);
 
-  if(state->vertex_shader_object != 0 && state->fragment_shader_object != 0 && state->program_object == 0) {
-    GLuint program = glCreateProgram();
-    glAttachShader(program, state->vertex_shader_object);
-    glAttachShader(program, state->fragment_shader_object);
-    _gl_linkProgram(program);
+    *(GLuint *)(&state->vertex_shader_object) = shader_objects[0];
+    *(GLuint *)(&state->fragment_shader_object) = shader_objects[1];
     *(GLuint *)(&state->program_object) = program;
+
+    memory_free(vertex_source, vertex_length + 1, 1);
   }
 
   if(state->attribute[0].format != 0 && state->vertex_array_object == 0) {
@@ -406,70 +722,133 @@ void gl_initializeDrawState(const struct gl_DrawState *state) {
       }
       glVertexArrayAttribBinding(vao, i, state->attribute[i].binding);
     }
+    for(int i = 0; i < GL_MAX_BINDINGS; i++) {
+      if(state->binding[i].divisor != 0) {
+        glVertexArrayBindingDivisor(vao, i, state->binding[i].divisor);
+      }
+    }
     *(GLuint *)(&state->vertex_array_object) = vao;
   }
 }
 
+// ====================================================================================================================
+// state shadow
+void gl_invalidateState(void) {
+  memory_set(&_.shadow, sizeof(_.shadow), 0xFF, sizeof(_.shadow));
+  for(uint32_t i = 0; i < _.programs.length; i++) {
+    _.programs.data[i].known = 0;
+  }
+  _.shadow_valid = true;
+}
+
+static inline void _forget_vertex_array_bindings(void) {
+  _.shadow.element_buffer = ~0u;
+  for(uint32_t i = 0; i < GL_MAX_BINDINGS; i++) {
+    _.shadow.vertex_buffer[i].buffer = ~0u;
+  }
+}
+
+// a deleted buffer is unbound wherever the context had it, its name may come back
+static void _forget_buffer(GLuint buffer) {
+  struct StateShadow *shadow = &_.shadow;
+  if(shadow->element_buffer == buffer) {
+    shadow->element_buffer = ~0u;
+  }
+  for(uint32_t i = 0; i < GL_MAX_BINDINGS; i++) {
+    if(shadow->vertex_buffer[i].buffer == buffer) {
+      shadow->vertex_buffer[i].buffer = ~0u;
+    }
+  }
+  for(uint32_t i = 0; i < SHADOW_MAX_STORAGE_BUFFERS; i++) {
+    if(shadow->storage_buffer[i] == buffer) {
+      shadow->storage_buffer[i] = ~0u;
+    }
+  }
+  if(shadow->draw_indirect_buffer == buffer) {
+    shadow->draw_indirect_buffer = ~0u;
+  }
+  if(shadow->dispatch_indirect_buffer == buffer) {
+    shadow->dispatch_indirect_buffer = ~0u;
+  }
+}
+
+// every GL call the shadow lets through is counted, as is every one it saves
+#define SHADOW_CALL(CALL) (_.frame_calls.calls++, CALL)
+#define SHADOW_SKIP() (_.frame_calls.skipped++)
+
 static GLbitfield apply_pipeline_state(const struct gl_PipelineState *state) {
-  static struct gl_PipelineState current_pipeline_state;
+  if(!_.shadow_valid) {
+    gl_invalidateState();
+  }
 
-  if(current_pipeline_state.program_object != state->program_object) {
-    glUseProgram(state->program_object);
-    current_pipeline_state.program_object = state->program_object;
+  if(_.shadow.program != state->program_object) {
+    SHADOW_CALL(glUseProgram(state->program_object));
+    _.shadow.program = state->program_object;
+  } else {
+    SHADOW_SKIP();
   }
 
   return 0;
 }
 
 GLbitfield gl_applyDrawState(const struct gl_DrawState *state) {
-  static struct gl_DrawState current_draw_state;
+  struct StateShadow *shadow = &_.shadow;
 
   GLbitfield barriers = apply_pipeline_state((const struct gl_PipelineState *)state);
 
-  if(current_draw_state.vertex_array_object != state->vertex_array_object) {
-    glBindVertexArray(state->vertex_array_object);
-    current_draw_state.vertex_array_object = state->vertex_array_object;
+  if(shadow->vertex_array != state->vertex_array_object) {
+    SHADOW_CALL(glBindVertexArray(state->vertex_array_object));
+    shadow->vertex_array = state->vertex_array_object;
+    _forget_vertex_array_bindings();
+  } else {
+    SHADOW_SKIP();
   }
 
-  if(current_draw_state.depth_test_enable != state->depth_test_enable) {
+  if(shadow->depth_test_enable != state->depth_test_enable) {
     if(state->depth_test_enable) {
-      glEnable(GL_DEPTH_TEST);
-      current_draw_state.depth_test_enable = true;
+      SHADOW_CALL(glEnable(GL_DEPTH_TEST));
     } else {
-      glDisable(GL_DEPTH_TEST);
-      current_draw_state.depth_test_enable = false;
+      SHADOW_CALL(glDisable(GL_DEPTH_TEST));
     }
+    shadow->depth_test_enable = state->depth_test_enable;
+  } else {
+    SHADOW_SKIP();
   }
 
-  if(current_draw_state.depth_mask != state->depth_mask) {
-    if(state->depth_mask) {
-      glDepthMask(GL_TRUE);
-      current_draw_state.depth_mask = true;
-    } else {
-      glDepthMask(GL_FALSE);
-      current_draw_state.depth_mask = false;
-    }
+  if(shadow->depth_mask != state->depth_mask) {
+    SHADOW_CALL(glDepthMask(state->depth_mask ? GL_TRUE : GL_FALSE));
+    shadow->depth_mask = state->depth_mask;
+  } else {
+    SHADOW_SKIP();
   }
 
-  if(current_draw_state.depth_range_min != state->depth_range_min ||
-     current_draw_state.depth_range_max != state->depth_range_max) {
-    glDepthRange(state->depth_range_min, state->depth_range_max);
-    current_draw_state.depth_range_min = state->depth_range_min;
-    current_draw_state.depth_range_max = state->depth_range_max;
+  if(shadow->depth_range_min != state->depth_range_min || shadow->depth_range_max != state->depth_range_max) {
+    SHADOW_CALL(glDepthRange(state->depth_range_min, state->depth_range_max));
+    shadow->depth_range_min = state->depth_range_min;
+    shadow->depth_range_max = state->depth_range_max;
+  } else {
+    SHADOW_SKIP();
+  }
+
+  if(shadow->blend_enable != state->blend_enable) {
+    if(state->blend_enable) {
+      SHADOW_CALL(glEnable(GL_BLEND));
+    } else {
+      SHADOW_CALL(glDisable(GL_BLEND));
+    }
+    shadow->blend_enable = state->blend_enable;
+  } else {
+    SHADOW_SKIP();
   }
 
   if(state->blend_enable) {
-    if(!current_draw_state.blend_enable || current_draw_state.blend_src_factor != state->blend_src_factor ||
-       current_draw_state.blend_dst_factor != state->blend_dst_factor) {
-      glEnable(GL_BLEND);
-      glBlendFunc(state->blend_src_factor, state->blend_dst_factor);
-      current_draw_state.blend_enable = true;
-      current_draw_state.blend_src_factor = state->blend_src_factor;
-      current_draw_state.blend_dst_factor = state->blend_dst_factor;
+    if(shadow->blend_src_factor != state->blend_src_factor || shadow->blend_dst_factor != state->blend_dst_factor) {
+      SHADOW_CALL(glBlendFunc(state->blend_src_factor, state->blend_dst_factor));
+      shadow->blend_src_factor = state->blend_src_factor;
+      shadow->blend_dst_factor = state->blend_dst_factor;
+    } else {
+      SHADOW_SKIP();
     }
-  } else if(current_draw_state.blend_enable) {
-    glDisable(GL_BLEND);
-    current_draw_state.blend_enable = false;
   }
 
   return barriers;
@@ -621,30 +1000,73 @@ static inline void gl_applyUniform(GLuint location, enum gl_Type type, GLsizei c
   }
 }
 
+static struct ProgramShadow *_program_shadow(GLuint program) {
+  if(program >= _.programs.length) {
+    uint32_t length = _.programs.length;
+    Vector_set_capacity(&_.programs, program + 1);
+    memory_clear(_.programs.data + length, sizeof(*_.programs.data) * (program + 1 - length));
+    _.programs.length = program + 1;
+  }
+  return &_.programs.data[program];
+}
+
+// values given by pointer may change behind it and are always set
+static void _apply_uniform(GLuint location, enum gl_Type type, GLsizei count, const struct gl_UniformData *data) {
+  uint32_t size = type_info[type].size;
+  if(location < SHADOW_MAX_LOCATIONS && size > 0) {
+    struct ProgramShadow *program = _program_shadow(_.shadow.program);
+    uint32_t bit = 1u << location;
+    if(data->pointer != NULL) {
+      program->known &= ~bit;
+    } else if((program->known & bit) && program->uniform[location].transpose == data->transpose &&
+              memcmp(program->uniform[location].value, data->mat, size) == 0) {
+      SHADOW_SKIP();
+      return;
+    } else {
+      program->known |= bit;
+      program->uniform[location].transpose = data->transpose;
+      memory_copy(program->uniform[location].value, sizeof(program->uniform[location].value), data->mat, size);
+    }
+  }
+  SHADOW_CALL(gl_applyUniform(location, type, count, data));
+}
+
+static inline void _bind_storage_buffer(GLuint binding, GLuint buffer) {
+  if(binding < SHADOW_MAX_STORAGE_BUFFERS) {
+    if(_.shadow.storage_buffer[binding] == buffer) {
+      SHADOW_SKIP();
+      return;
+    }
+    _.shadow.storage_buffer[binding] = buffer;
+  }
+  SHADOW_CALL(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer));
+}
+
 static inline GLbitfield apply_pipeline_assets(const struct gl_PipelineState *state,
                                                const struct gl_PipelineAssets *assets, bool compute) {
-  static struct gl_PipelineAssets current_assets;
-
   GLuint uniform_location = 0;
   GLuint shader_storage_buffer_binding = 0;
   GLuint location, binding;
 
   GLbitfield barriers = 0;
 
+  // bound by unit, the target comes from the texture itself
   for(uint32_t i = 0; i < GL_MAX_IMAGES; i++) {
-    if(assets != NULL && assets->image[i]) {
-      if(current_assets.image[i] != assets->image[i]) {
-        if(type_info[state->image[i].type].target == GL_SAMPLER) {
-          glBindSampler(i, assets->image[i]);
-        } else {
-          glActiveTexture(GL_TEXTURE0 + i);
-          glBindTexture(type_info[state->image[i].type].target, assets->image[i]);
-        }
+    if(assets == NULL || !assets->image[i]) {
+      continue;
+    }
+    if(type_info[state->image[i].type].target == GL_SAMPLER) {
+      if(_.shadow.sampler[i] != assets->image[i]) {
+        SHADOW_CALL(glBindSampler(i, assets->image[i]));
+        _.shadow.sampler[i] = assets->image[i];
       } else {
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, assets->image[i]);
+        SHADOW_SKIP();
       }
-      current_assets.image[i] = assets->image[i];
+    } else if(_.shadow.texture[i] != assets->image[i]) {
+      SHADOW_CALL(glBindTextureUnit(i, assets->image[i]));
+      _.shadow.texture[i] = assets->image[i];
+    } else {
+      SHADOW_SKIP();
     }
   }
 
@@ -653,7 +1075,7 @@ static inline GLbitfield apply_pipeline_assets(const struct gl_PipelineState *st
       continue;
     GLuint location = uniform_location++;
     if(assets != NULL)
-      gl_applyUniform(location, state->uniform[i].type, state->uniform[i].count, &assets->uniforms[i]);
+      _apply_uniform(location, state->uniform[i].type, state->uniform[i].count, &assets->uniforms[i]);
   }
 
   for(uint32_t i = 0; i < GL_MAX_UNIFORMS; i++) {
@@ -670,16 +1092,16 @@ static inline GLbitfield apply_pipeline_assets(const struct gl_PipelineState *st
       if(count > 1) {
         for(uint32_t j = 0; j < count; j++) {
           barriers |= gl_flushBuffer(state->global[i].resource->block.buffers[j], GL_SHADER_STORAGE_BARRIER_BIT);
-          glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding + j, state->global[i].resource->block.buffers[j]->buffer);
+          _bind_storage_buffer(binding + j, state->global[i].resource->block.buffers[j]->buffer);
         }
       } else {
         barriers |= gl_flushBuffer(state->global[i].resource->block.buffer, GL_SHADER_STORAGE_BARRIER_BIT);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, state->global[i].resource->block.buffer->buffer);
+        _bind_storage_buffer(binding, state->global[i].resource->block.buffer->buffer);
       }
     } else {
       gl_ShaderResource_prepare(state->global[i].resource);
-      gl_applyUniform(location, state->global[i].resource->type, state->global[i].resource->count,
-                       &state->global[i].resource->uniform.data);
+      _apply_uniform(location, state->global[i].resource->type, state->global[i].resource->count,
+                     &state->global[i].resource->uniform.data);
     }
   }
 
@@ -687,7 +1109,7 @@ static inline GLbitfield apply_pipeline_assets(const struct gl_PipelineState *st
 }
 
 GLbitfield gl_applyDrawAssets(const struct gl_DrawState *state, const struct gl_DrawAssets *assets) {
-  //static struct gl_DrawAssets current_draw_assets;
+  struct StateShadow *shadow = &_.shadow;
 
   GLbitfield barriers =
       apply_pipeline_assets((const struct gl_PipelineState *)state, (const struct gl_PipelineAssets *)assets, false);
@@ -695,18 +1117,29 @@ GLbitfield gl_applyDrawAssets(const struct gl_DrawState *state, const struct gl_
   if(assets != NULL) {
     if(assets->element_buffer != NULL) {
       barriers |= gl_flushBuffer(assets->element_buffer, GL_ELEMENT_ARRAY_BARRIER_BIT);
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, assets->element_buffer->buffer);
+      if(shadow->element_buffer != assets->element_buffer->buffer) {
+        SHADOW_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, assets->element_buffer->buffer));
+        shadow->element_buffer = assets->element_buffer->buffer;
+      } else {
+        SHADOW_SKIP();
+      }
     }
 
     for(int i = 0; i < GL_MAX_BINDINGS; i++) {
       if(assets->vertex_buffers[i] == NULL)
         break;
       barriers |= gl_flushBuffer(assets->vertex_buffers[i], GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
-      if(assets->vertex_buffers[i]->kind == gl_Buffer_temporary) {
-        glBindVertexBuffer(i, assets->vertex_buffers[i]->buffer, assets->vertex_buffers[i]->offset,
-                           state->binding[i].stride);
+      GLuint buffer = assets->vertex_buffers[i]->buffer;
+      GLintptr offset = assets->vertex_buffers[i]->kind == gl_Buffer_temporary ? assets->vertex_buffers[i]->offset : 0;
+      GLsizei stride = state->binding[i].stride;
+      if(shadow->vertex_buffer[i].buffer != buffer || shadow->vertex_buffer[i].offset != offset ||
+         shadow->vertex_buffer[i].stride != stride) {
+        SHADOW_CALL(glBindVertexBuffer(i, buffer, offset, stride));
+        shadow->vertex_buffer[i].buffer = buffer;
+        shadow->vertex_buffer[i].offset = offset;
+        shadow->vertex_buffer[i].stride = stride;
       } else {
-        glBindVertexBuffer(i, assets->vertex_buffers[i]->buffer, 0, state->binding[i].stride);
+        SHADOW_SKIP();
       }
     }
   }
@@ -716,7 +1149,7 @@ GLbitfield gl_applyDrawAssets(const struct gl_DrawState *state, const struct gl_
 
 static void apply_barriers(GLbitfield barriers) {
   if(barriers)
-    glMemoryBarrier(barriers);
+    SHADOW_CALL(glMemoryBarrier(barriers));
 }
 
 void gl_drawArrays(const struct gl_DrawState *state, const struct gl_DrawAssets *assets, int32_t first, ssize_t count,
@@ -727,8 +1160,9 @@ void gl_drawArrays(const struct gl_DrawState *state, const struct gl_DrawAssets
 
   apply_barriers(barriers);
 
-  glDrawArraysInstancedBaseInstance(state->primitive, first, count, instancecount, baseinstance);
+  SHADOW_CALL(glDrawArraysInstancedBaseInstance(state->primitive, first, count, instancecount, baseinstance));
 
+  _.frame_calls.draws++;
   _.draw_index++;
 }
 
@@ -740,12 +1174,13 @@ void gl_drawElements(const struct gl_DrawState *state, const struct gl_DrawAsset
 
   apply_barriers(barriers);
 
-  glDrawElementsInstancedBaseVertexBaseInstance(
+  SHADOW_CALL(glDrawElementsInstancedBaseVertexBaseInstance(
       state->primitive, count, GL_UNSIGNED_INT,
       (void *)((assets->element_buffer->kind == gl_Buffer_temporary ? assets->element_buffer->offset : 0) +
           sizeof(uint32_t) * assets->element_buffer_offset),
-      instancecount, basevertex, baseinstance);
+      instancecount, basevertex, baseinstance));
 
+  _.frame_calls.draws++;
   _.draw_index++;
 }
 
@@ -759,12 +1194,94 @@ void gl_drawElementsIndirect(const struct gl_DrawState *state, const struct gl_D
 
   apply_barriers(barriers);
 
-  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect->buffer);
-  glDrawElementsIndirect(state->primitive, GL_UNSIGNED_INT, (const void *)(uintptr_t)indirect_offset);
+  if(_.shadow.draw_indirect_buffer != indirect->buffer) {
+    SHADOW_CALL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect->buffer));
+    _.shadow.draw_indirect_buffer = indirect->buffer;
+  } else {
+    SHADOW_SKIP();
+  }
+  SHADOW_CALL(glDrawElementsIndirect(state->primitive, GL_UNSIGNED_INT, (const void *)(uintptr_t)indirect_offset));
 
+  _.frame_calls.draws++;
   _.draw_index++;
 }
 
+// ====================================================================================================================
+// draw queue
+uint64_t gl_drawKey(uint32_t layer, const struct gl_DrawState *state, const struct gl_DrawAssets *assets, uint32_t depth) {
+  uint32_t program = 0;
+  if(state != NULL) {
+    gl_initializeDrawState(state);
+    program = state->program_object;
+  }
+  uint32_t texture = assets != NULL ? assets->image[0] : 0;
+  return (uint64_t)(layer & 0xFF) << 56 | (uint64_t)(program & 0xFFF) << 44 | (uint64_t)(texture & 0xFFFFF) << 24 |
+         (depth & 0xFFFFFF);
+}
+
+void gl_queueDrawElements(uint64_t key, const struct gl_DrawState *state, const struct gl_DrawAssets *assets,
+                          ssize_t count, ssize_t instancecount, int32_t basevertex, uint32_t baseinstance) {
+  Vector_space_for(&_.queue, 1);
+  struct QueuedDraw *draw = Vector_push(&_.queue);
+  draw->key = key;
+  draw->sequence = _.queue.length - 1;
+  draw->state = state;
+  draw->assets = *assets;
+  draw->element_buffer = *assets->element_buffer;
+  for(uint32_t i = 0; i < GL_MAX_BINDINGS; i++) {
+    if(assets->vertex_buffers[i] != NULL) {
+      draw->vertex_buffers[i] = *assets->vertex_buffers[i];
+    }
+  }
+  draw->count = count;
+  draw->instancecount = instancecount;
+  draw->basevertex = basevertex;
+  draw->baseinstance = baseinstance;
+}
+
+static int _compare_queued_draw(const void *ap, const void *bp, void *ud) {
+  const struct QueuedDraw *a = (const struct QueuedDraw *)ap;
+  const struct QueuedDraw *b = (const struct QueuedDraw *)bp;
+  if(a->key != b->key) {
+    return a->key < b->key ? -1 : 1;
+  }
+  return a->sequence < b->sequence ? -1 : a->sequence > b->sequence;
+}
+
+void gl_submitDraws(void) {
+  if(_.queue.length == 0) {
+    return;
+  }
+  profile_begin_gl("gl_submitDraws");
+  Vector_qsort(&_.queue, _compare_queued_draw, NULL);
+
+  // the copies are pointed at only now, the queue may have moved while it grew
+  for(uint32_t i = 0; i < _.queue.length; i++) {
+    struct QueuedDraw *draw = &_.queue.data[i];
+    draw->assets.element_buffer = &draw->element_buffer;
+    for(uint32_t j = 0; j < GL_MAX_BINDINGS; j++) {
+      if(draw->assets.vertex_buffers[j] != NULL) {
+        draw->assets.vertex_buffers[j] = &draw->vertex_buffers[j];
+      }
+    }
+    gl_drawElements(draw->state, &draw->assets, draw->count, draw->instancecount, draw->basevertex, draw->baseinstance);
+  }
+  _.queue.length = 0;
+  profile_end();
+}
+
+void gl_beginFrame(void) {
+  _program_cache_report();
+
+  _.calls = _.frame_calls;
+  memory_clear(&_.frame_calls, sizeof(_.frame_calls));
+  gl_resetTemporaryBuffers();
+}
+
+void gl_callStats(struct gl_CallStats *stats) {
+  *stats = _.calls;
+}
+
 struct gl_Buffer gl_allocateStaticBuffer(uint32_t type, ssize_t size, const void *data) {
   struct gl_Buffer result;
   result.kind = gl_Buffer_static;
@@ -774,39 +1291,95 @@ struct gl_Buffer gl_allocateStaticBuffer(uint32_t type, ssize_t size, const void
   return result;
 }
 
+// ====================================================================================================================
+// temporary buffers
+static void _temporary_wait(GLsync fence) {
+  for(;;) {
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    if(result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) {
+      return;
+    }
+  }
+}
+
+// the oldest frame in flight, with wait false only when the GPU is done with it
+static bool _temporary_retire(bool wait) {
+  struct TemporaryRing *ring = &_.temporary;
+  if(ring->num_frames == 0) {
+    return false;
+  }
+  struct TemporaryFrame *frame = &ring->frames[ring->first_frame];
+  if(wait) {
+    _temporary_wait(frame->fence);
+    ring->waits++;
+  } else {
+    GLenum result = glClientWaitSync(frame->fence, 0, 0);
+    if(result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+      return false;
+    }
+  }
+  glDeleteSync(frame->fence);
+  for(uint32_t i = 0; i < frame->retired_buffers.length; i++) {
+    _forget_buffer(frame->retired_buffers.data[i]);
+  }
+  glDeleteBuffers(frame->retired_buffers.length, frame->retired_buffers.data);
+  frame->retired_buffers.length = 0;
+  ring->tail = frame->end;
+  ring->first_frame = (ring->first_frame + 1) % TEMPORARY_MAX_FRAMES;
+  ring->num_frames--;
+  return true;
+}
+
+// the buffers of the current frame are deleted once the frame retires, the
+// allocations handed out before a resize keep their mapping until then
+static void _temporary_resize(uint64_t size) {
+  struct TemporaryRing *ring = &_.temporary;
+  if(ring->buffer != 0) {
+    WARNING(SOURCE_NAMESPACE, "temporary buffer ring grows from %u to %u bytes", (uint32_t)ring->size, (uint32_t)size);
+    // every frame in flight is done before the offsets start over
+    while(_temporary_retire(true)) {
+    }
+    Vector_space_for(&ring->retired_buffers, 1);
+    *Vector_push(&ring->retired_buffers) = ring->buffer;
+  }
+  glCreateBuffers(1, &ring->buffer);
+  glNamedBufferStorage(ring->buffer, size, NULL, GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT);
+  ring->mapping =
+      glMapNamedBufferRange(ring->buffer, 0, size, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+  ring->size = size;
+  ring->head = ring->tail = ring->frame_start = 0;
+}
+
 struct gl_Buffer gl_allocateTemporaryBuffer(uint32_t type, ssize_t size) {
-again:
-  for(uint32_t i = 0; i < _.num_temporary_buffers; i++) {
-    if(_.temporary_buffers[i].type == type && _.temporary_buffers[i].size - _.temporary_buffers[i].offset > size) {
+  (void)type;
+  struct TemporaryRing *ring = &_.temporary;
+  uint64_t aligned = ((uint64_t)size + TEMPORARY_ALIGNMENT - 1) & ~(uint64_t)(TEMPORARY_ALIGNMENT - 1);
+
+  if(ring->buffer == 0) {
+    _temporary_resize(max(temporary_buffer_size, TEMPORARY_ALIGNMENT));
+  }
+
+  for(;;) {
+    // an allocation does not straddle the end, the rest of the lap is skipped
+    uint64_t offset = ring->head % ring->size;
+    uint64_t head = offset + aligned > ring->size ? ring->head + (ring->size - offset) : ring->head;
+    if(head + aligned - ring->tail <= ring->size) {
+      ring->frame_used += head + aligned - ring->head;
+      ring->head = head + aligned;
       struct gl_Buffer result;
       result.kind = gl_Buffer_temporary;
-      result.buffer = _.temporary_buffers[i].buffer;
+      result.buffer = ring->buffer;
       result.size = size;
-      result.mapping = (void *)((GLbyte *)_.temporary_buffers[i].mapped_memory + _.temporary_buffers[i].offset);
-      result.offset = _.temporary_buffers[i].offset;
+      result.offset = head % ring->size;
+      result.mapping = (void *)((GLbyte *)ring->mapping + result.offset);
       result.dirty = true;
-      _.temporary_buffers[i].offset += size;
       return result;
     }
+    if(!_temporary_retire(true)) {
+      // the current frame alone does not fit
+      _temporary_resize(max(ring->size * 2, (ring->head - ring->frame_start + aligned) * 2));
+    }
   }
-
-  // 16 << 20); // 16mb TODO make a cvar
-  GLsizei block_size = 4 << 20;
-  GLsizei allocation_size = ((size + block_size) / block_size) * block_size;
-
-  _.temporary_buffers = memory_realloc(_.temporary_buffers, sizeof(*_.temporary_buffers) * _.num_temporary_buffers, sizeof(*_.temporary_buffers) * (_.num_temporary_buffers + 1), 4);
-  glCreateBuffers(1, &_.temporary_buffers[_.num_temporary_buffers].buffer);
-  glNamedBufferStorage(_.temporary_buffers[_.num_temporary_buffers].buffer, allocation_size, NULL,
-                       GL_MAP_PERSISTENT_BIT | GL_MAP_WRITE_BIT);
-  _.temporary_buffers[_.num_temporary_buffers].type = type;
-  _.temporary_buffers[_.num_temporary_buffers].size = allocation_size;
-  _.temporary_buffers[_.num_temporary_buffers].offset = 0;
-  _.temporary_buffers[_.num_temporary_buffers].mapped_memory =
-      glMapNamedBufferRange(_.temporary_buffers[_.num_temporary_buffers].buffer, 0, allocation_size,
-                            GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
-  _.num_temporary_buffers++;
-
-  goto again;
 }
 
 struct gl_Buffer gl_allocateTemporaryBufferFrom(uint32_t type, ssize_t size, const void *ptr) {
@@ -886,6 +1459,7 @@ GLbitfield gl_flushBuffer(const struct gl_Buffer *buffer, GLbitfield read_barrie
 void gl_freeBuffer(const struct gl_Buffer *buffer) {
   switch(buffer->kind) {
   case gl_Buffer_static:
+    _forget_buffer(buffer->buffer);
     glDeleteBuffers(1, &buffer->buffer);
     break;
   default:
@@ -893,22 +1467,47 @@ void gl_freeBuffer(const struct gl_Buffer *buffer) {
   }
 }
 
+// ends the frame so far, its allocations stay untouched until the GPU passed its fence
 void gl_resetTemporaryBuffers(void) {
-  for(uint32_t i = 0; i < _.num_temporary_buffers; i++) {
-    _.temporary_buffers[i].offset = 0;
+  struct TemporaryRing *ring = &_.temporary;
+  if(ring->buffer == 0) {
+    return;
   }
-}
 
-void gl_temporaryBufferStats(GLenum type, uint32_t *total_allocated, uint32_t *used) {
-  *total_allocated = 0;
-  *used = 0;
+  // retiring waits on fences when the GPU is behind
+  profile_begin("gl_resetTemporaryBuffers");
 
-  for(uint32_t i = 0; i < _.num_temporary_buffers; i++) {
-    if(_.temporary_buffers[i].type == type) {
-      *total_allocated += _.temporary_buffers[i].size;
-      *used += _.temporary_buffers[i].offset;
-    }
+  uint32_t used = ring->frame_used;
+  ring->last_frame_used = used;
+  ring->high_water = max(ring->high_water, used);
+
+  uint32_t max_frames = min(max(temporary_buffer_frames, 1), TEMPORARY_MAX_FRAMES);
+  while(_temporary_retire(ring->num_frames >= max_frames)) {
   }
+
+  struct TemporaryFrame *frame = &ring->frames[(ring->first_frame + ring->num_frames) % TEMPORARY_MAX_FRAMES];
+  frame->end = ring->head;
+  frame->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  // the frame's list is empty since it retired, the two trade places
+  TemporaryBuffers retired_buffers = frame->retired_buffers;
+  frame->retired_buffers = ring->retired_buffers;
+  ring->retired_buffers = retired_buffers;
+  ring->num_frames++;
+
+  ring->frame_start = ring->head;
+  ring->frame_used = 0;
+
+  profile_end();
+}
+
+void gl_temporaryBufferStats(struct gl_TemporaryBufferStats *stats) {
+  struct TemporaryRing *ring = &_.temporary;
+  stats->size = ring->size;
+  stats->used = ring->frame_used;
+  stats->last_frame_used = ring->last_frame_used;
+  stats->high_water = ring->high_water;
+  stats->frames_in_flight = ring->num_frames;
+  stats->waits = ring->waits;
 }
 
 void gl_ShaderResource_prepare(const struct gl_ShaderResource *resource) {
@@ -925,7 +1524,7 @@ void gl_ShaderResource_prepare(const struct gl_ShaderResource *resource) {
 #endif
 
 void gl_initializeComputeState(const struct gl_ComputeState *state) {
-  if(state->shader != NULL && state->shader_object == 0) {
+  if(state->shader != NULL && state->program_object == 0) {
     script_builder_init();
     script_builder_add("%s", shader_prelude);
 
@@ -947,16 +1546,13 @@ void gl_initializeComputeState(const struct gl_ComputeState *state) {
     script_builder_add_shader_requisites((const struct gl_ShaderSnippet *)state->shader);
     script_builder_add("%s", state->shader->code);
 
-    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
-    glShaderSource(shader, 1, (const char *const *)&_.script_builder_ptr, (const GLint *)&_.script_builder_len);
-    _gl_compileShader(shader);
-    *(GLuint *)(&state->shader_object) = shader;
-  }
+    GLenum type = GL_COMPUTE_SHADER;
+    const char *source = _.script_builder_ptr;
+    GLint length = _.script_builder_len;
+    uint32_t shader_object = 0;
+    GLuint program = _gl_createProgram(1, &type, &source, &length, &shader_object);
 
-  if(state->shader_object != 0 && state->program_object == 0) {
-    GLuint program = glCreateProgram();
-    glAttachShader(program, state->shader_object);
-    _gl_linkProgram(program);
+    *(GLuint *)(&state->shader_object) = shader_object;
     *(GLuint *)(&state->program_object) = program;
   }
 }
@@ -966,8 +1562,6 @@ GLbitfield gl_applyComputeState(const struct gl_ComputeState *state) {
 }
 
 GLbitfield gl_applyComputeAssets(const struct gl_ComputeState *state, const struct gl_ComputeAssets *assets) {
-  //static struct gl_ComputeAssets current_compute_assets;
-
   GLbitfield barriers =
       apply_pipeline_assets((const struct gl_PipelineState *)state, (const struct gl_PipelineAssets *)assets, true);
 
@@ -985,7 +1579,7 @@ void gl_compute(const struct gl_ComputeState *state, const struct gl_ComputeAsse
 
   apply_barriers(barriers);
 
-  glDispatchCompute(num_groups_x, num_groups_y, num_groups_z);
+  SHADOW_CALL(glDispatchCompute(num_groups_x, num_groups_y, num_groups_z));
 }
 
 void gl_computeIndirect(const struct gl_ComputeState *state, const struct gl_ComputeAssets *assets,
@@ -998,7 +1592,12 @@ void gl_computeIndirect(const struct gl_ComputeState *state, const struct gl_Com
 
   apply_barriers(barriers);
 
-  glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, indirect->buffer);
-  glDispatchComputeIndirect(indirect_offset);
+  if(_.shadow.dispatch_indirect_buffer != indirect->buffer) {
+    SHADOW_CALL(glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, indirect->buffer));
+    _.shadow.dispatch_indirect_buffer = indirect->buffer;
+  } else {
+    SHADOW_SKIP();
+  }
+  SHADOW_CALL(glDispatchComputeIndirect(indirect_offset));
 }
 
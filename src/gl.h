@@ -359,6 +359,41 @@ void gl_drawElements(const struct gl_DrawState *state, const struct gl_DrawAsset
 void gl_drawElementsIndirect(const struct gl_DrawState *state, const struct gl_DrawAssets *assets,
                                    const struct gl_Buffer *indirect, ssize_t indirect_offset);
 
+// queued draws go out in key order on gl_submitDraws, draws of one key in the
+// order they were queued. layer orders first, within a layer draws group by
+// program then by the texture of image 0, depth orders the rest. a layer whose
+// draws overlap in order passes NULL state and assets, its draws only order
+// by depth and then as queued. the buffers are copied, shader resources are
+// read when the draw goes out
+uint64_t gl_drawKey(uint32_t layer, const struct gl_DrawState *state, const struct gl_DrawAssets *assets,
+                    uint32_t depth);
+
+void gl_queueDrawElements(uint64_t key, const struct gl_DrawState *state, const struct gl_DrawAssets *assets,
+                          ssize_t count, ssize_t instancecount, int32_t basevertex, uint32_t baseinstance);
+
+void gl_submitDraws(void);
+
+// --------------------------------------------------------------------------------------------------------------------
+// state
+//
+// state set through this file is remembered and not set again. code that
+// changes bindings, the program or blend and depth state with GL directly
+// calls gl_invalidateState after
+void gl_invalidateState(void);
+
+// calls counted in a frame, skipped are the ones the remembered state made
+// unnecessary
+struct gl_CallStats {
+  uint32_t calls;
+  uint32_t skipped;
+  uint32_t draws;
+};
+
+// starts a frame, the temporary buffers are reset and the call counts of the
+// last one kept for gl_callStats
+void gl_beginFrame(void);
+void gl_callStats(struct gl_CallStats *stats);
+
 // --------------------------------------------------------------------------------------------------------------------
 // compute
 void gl_initializeComputeState(const struct gl_ComputeState *state);
@@ -389,7 +424,16 @@ void gl_freeBuffer(const struct gl_Buffer *buffer);
 
 void gl_resetTemporaryBuffers(void);
 
-void gl_temporaryBufferStats(uint32_t type, uint32_t *total_allocated, uint32_t *used);
+// the frame in progress, the last whole one and the most any frame used, in bytes
+struct gl_TemporaryBufferStats {
+  uint32_t size;
+  uint32_t used;
+  uint32_t last_frame_used;
+  uint32_t high_water;
+  uint32_t frames_in_flight;
+  uint32_t waits;
+};
+void gl_temporaryBufferStats(struct gl_TemporaryBufferStats *stats);
 
 void gl_destroyBuffer(const struct gl_Buffer *buffer);
 
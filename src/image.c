@@ -14,6 +14,10 @@
 #include "gl.h"
 
 void GraphicsImage_load(struct GraphicsImage *image, const char *path) {
+  if(image_atlas_find(image, path)) {
+    return;
+  }
+
   int width, height, channels;
   uint8_t *data = stbi_load(path, &width, &height, &channels, 0);
 
@@ -26,6 +30,11 @@ void GraphicsImage_load(struct GraphicsImage *image, const char *path) {
     return;
   }
 
+  if(image_atlas_insert(image, path, data, width, height, channels)) {
+    stbi_image_free(data);
+    return;
+  }
+
   GLenum internal_format = channels == 3 ? GL_RGB8 : GL_RGBA8;
   GLenum external_format = channels == 3 ? GL_RGB : GL_RGBA;
 
@@ -41,7 +50,7 @@ void GraphicsImage_load(struct GraphicsImage *image, const char *path) {
   glTextureSubImage2D(image->gl.image, 0, 0, 0, width, height, external_format, GL_UNSIGNED_BYTE, data);
   glGenerateTextureMipmap(image->gl.image);
   glTextureParameteri(image->gl.image, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTextureParameteri(image->gl.image, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTextureParameteri(image->gl.image, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 
   stbi_image_free(data);
 
@@ -51,6 +60,10 @@ void GraphicsImage_load(struct GraphicsImage *image, const char *path) {
   image->levels = levels;
   image->layers = 1;
   image->internal_format = internal_format;
+  image->s0 = 0;
+  image->t0 = 0;
+  image->s1 = 1;
+  image->t1 = 1;
 }
 
 void GraphicsImage_unload(struct GraphicsImage *image) {
@@ -1,6 +1,7 @@
 #ifndef image_h_INCLUDED
 #define image_h_INCLUDED
 
+#include <stdbool.h>
 #include <stdint.h>
 
 struct GraphicsImage {
@@ -13,6 +14,10 @@ struct GraphicsImage {
 
   uint32_t internal_format;
 
+  // the part of the texture that is this image. all of it unless the image was
+  // packed into an atlas page, see image_atlas_insert
+  float s0, t0, s1, t1;
+
   union {
     struct {
       uint32_t image;
@@ -28,6 +33,12 @@ struct GraphicsImage {
 void GraphicsImage_load(struct GraphicsImage *image, const char *path);
 void GraphicsImage_unload(struct GraphicsImage *image);
 
+// small images share a few large textures, packed as they load. a packed image
+// keeps its place for the rest of the run, loading the same path again finds it
+bool image_atlas_find(struct GraphicsImage *image, const char *path);
+bool image_atlas_insert(struct GraphicsImage *image, const char *path, const uint8_t *pixels, uint32_t width,
+                        uint32_t height, uint32_t channels);
+
 struct Image {
   const char *path;
   uint32_t resource_id;
@@ -0,0 +1,268 @@
+#include "image.h"
+
+#include "gl.h"
+#include "configuration.h"
+#include "log.h"
+#include "math.h"
+#include "string.h"
+#include "vector.h"
+
+#include <string.h>
+
+#define SOURCE_NAMESPACE core.image
+
+static CONFIGURATION_BOOLEAN(SOURCE_NAMESPACE, atlas, true);
+
+// edge of an atlas page in pixels
+static CONFIGURATION_INTEGER(SOURCE_NAMESPACE, atlas_page_size, 2048);
+
+// images wider or taller than this get their own texture
+static CONFIGURATION_INTEGER(SOURCE_NAMESPACE, atlas_max_image_size, 256);
+
+// every image sits in a border of its own edge pixels and starts on a multiple
+// of ATLAS_ALIGN. each of the ATLAS_LEVELS mip levels then still has a whole
+// texel of border and halves to whole texels, so filtering never reaches a
+// neighbour
+#define ATLAS_LEVELS 4
+#define ATLAS_ALIGN (1 << (ATLAS_LEVELS - 1))
+#define ATLAS_PADDING ATLAS_ALIGN
+
+// ====================================================================================================================
+// skyline
+//
+// the top edge of everything packed into a page, as spans left to right that
+// cover the whole width. a rectangle goes where it ends lowest, leftmost first
+typedef struct {
+  uint32_t x, y, width;
+} _Span;
+
+typedef struct {
+  uint32_t texture;
+  Vector(_Span) skyline;
+} _Page;
+
+typedef struct {
+  uint64_t hash;
+  MStr path;
+  uint32_t page;
+  uint32_t x, y, width, height;
+} _Entry;
+
+static struct {
+  uint32_t page_size;
+  Vector(_Page) pages;
+  Vector(_Entry) entries;
+
+  // the padded image and its mip levels on the way to the page
+  Vector(uint8_t) pixels;
+} _atlas;
+
+static bool _skyline_fit(const _Page * page, uint32_t width, uint32_t height, uint32_t * index, uint32_t * x, uint32_t * y) {
+  uint32_t size = _atlas.page_size;
+  uint32_t best_y = UINT32_MAX;
+
+  for(uint32_t i = 0; i < page->skyline.length; i++) {
+    const _Span * spans = page->skyline.data;
+    if(spans[i].x + width > size) {
+      break;
+    }
+
+    // the highest span under the rectangle decides where it rests
+    uint32_t top = 0, remaining = width;
+    for(uint32_t j = i; remaining > 0; j++) {
+      top = max(top, spans[j].y);
+      remaining -= min(remaining, spans[j].width);
+    }
+
+    if(top + height <= size && top < best_y) {
+      best_y = top;
+      *index = i;
+      *x = spans[i].x;
+    }
+  }
+
+  *y = best_y;
+  return best_y != UINT32_MAX;
+}
+
+static void _skyline_add(_Page * page, uint32_t index, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+  Vector_space_for(&page->skyline, 1);
+  _Span * spans = page->skyline.data;
+  memmove(spans + index + 1, spans + index, sizeof(*spans) * (page->skyline.length - index));
+  page->skyline.length++;
+  spans[index] = (_Span) { .x = x, .y = y + height, .width = width };
+
+  // the spans the new one covers shrink or go
+  while(index + 1 < page->skyline.length) {
+    _Span * span = &spans[index + 1];
+    uint32_t end = x + width;
+    if(span->x >= end) {
+      break;
+    }
+    if(span->x + span->width <= end) {
+      Vector_remove_at(&page->skyline, index + 1);
+      continue;
+    }
+    span->width -= end - span->x;
+    span->x = end;
+    break;
+  }
+
+  // neighbours at the same height are one span
+  for(uint32_t i = 0; i + 1 < page->skyline.length;) {
+    if(spans[i].y == spans[i + 1].y) {
+      spans[i].width += spans[i + 1].width;
+      Vector_remove_at(&page->skyline, i + 1);
+    } else {
+      i++;
+    }
+  }
+}
+
+static uint32_t _add_page(void) {
+  uint32_t size = _atlas.page_size;
+
+  Vector_space_for(&_atlas.pages, 1);
+  _Page * page = Vector_push(&_atlas.pages);
+  memory_clear(page, sizeof(*page));
+
+  Vector_space_for(&page->skyline, 1);
+  *Vector_push(&page->skyline) = (_Span) { .x = 0, .y = 0, .width = size };
+
+  glCreateTextures(GL_TEXTURE_2D, 1, &page->texture);
+  glTextureStorage2D(page->texture, ATLAS_LEVELS, GL_RGBA8, size, size);
+  glTextureParameteri(page->texture, GL_TEXTURE_MAX_LEVEL, ATLAS_LEVELS - 1);
+  glTextureParameteri(page->texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTextureParameteri(page->texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTextureParameteri(page->texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTextureParameteri(page->texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  INFO(SOURCE_NAMESPACE, "atlas page %u, %ux%u", _atlas.pages.length - 1, size, size);
+  return _atlas.pages.length - 1;
+}
+
+// ====================================================================================================================
+// upload
+static void _upload(const _Page * page, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const uint8_t * pixels,
+                    uint32_t image_width, uint32_t image_height, uint32_t channels) {
+  size_t total = 0;
+  for(uint32_t level = 0; level < ATLAS_LEVELS; level++) {
+    total += (size_t)(width >> level) * (height >> level) * 4;
+  }
+  _atlas.pixels.length = 0;
+  Vector_set_capacity(&_atlas.pixels, total);
+  uint8_t * level_pixels = _atlas.pixels.data;
+
+  // edge pixels repeat out into the border
+  for(uint32_t py = 0; py < height; py++) {
+    uint32_t sy = min(image_height - 1, (uint32_t)max(0, (int32_t)py - ATLAS_PADDING));
+    for(uint32_t px = 0; px < width; px++) {
+      uint32_t sx = min(image_width - 1, (uint32_t)max(0, (int32_t)px - ATLAS_PADDING));
+      const uint8_t * source = pixels + ((size_t)sy * image_width + sx) * channels;
+      uint8_t * target = level_pixels + ((size_t)py * width + px) * 4;
+      target[0] = source[0];
+      target[1] = source[1];
+      target[2] = source[2];
+      target[3] = channels == 4 ? source[3] : 255;
+    }
+  }
+
+  for(uint32_t level = 0; level < ATLAS_LEVELS; level++) {
+    uint32_t w = width >> level, h = height >> level;
+    glTextureSubImage2D(page->texture, level, x >> level, y >> level, w, h, GL_RGBA, GL_UNSIGNED_BYTE, level_pixels);
+
+    if(level + 1 == ATLAS_LEVELS) {
+      break;
+    }
+
+    // a box of four for the next level, right behind this one
+    uint8_t * next = level_pixels + (size_t)w * h * 4;
+    for(uint32_t ny = 0; ny < h / 2; ny++) {
+      for(uint32_t nx = 0; nx < w / 2; nx++) {
+        const uint8_t * a = level_pixels + ((size_t)(ny * 2) * w + nx * 2) * 4;
+        const uint8_t * b = a + (size_t)w * 4;
+        for(uint32_t c = 0; c < 4; c++) {
+          next[((size_t)ny * (w / 2) + nx) * 4 + c] = (a[c] + a[c + 4] + b[c] + b[c + 4] + 2) / 4;
+        }
+      }
+    }
+    level_pixels = next;
+  }
+}
+
+// ====================================================================================================================
+static void _fill(struct GraphicsImage * image, const _Entry * entry) {
+  float scale = 1.0f / _atlas.page_size;
+
+  image->width = entry->width;
+  image->height = entry->height;
+  image->depth = 1;
+  image->levels = ATLAS_LEVELS;
+  image->layers = 1;
+  image->internal_format = GL_RGBA8;
+  image->s0 = (entry->x + ATLAS_PADDING) * scale;
+  image->t0 = (entry->y + ATLAS_PADDING) * scale;
+  image->s1 = (entry->x + ATLAS_PADDING + entry->width) * scale;
+  image->t1 = (entry->y + ATLAS_PADDING + entry->height) * scale;
+  image->gl.image = _atlas.pages.data[entry->page].texture;
+}
+
+bool image_atlas_find(struct GraphicsImage *image, const char *path) {
+  uint64_t hash = string_hash(path);
+  for(uint32_t i = 0; i < _atlas.entries.length; i++) {
+    const _Entry * entry = &_atlas.entries.data[i];
+    if(entry->hash == hash && string_equals((CStr)entry->path, path)) {
+      _fill(image, entry);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool image_atlas_insert(struct GraphicsImage *image, const char *path, const uint8_t *pixels, uint32_t width,
+                        uint32_t height, uint32_t channels) {
+  if(!atlas || (channels != 3 && channels != 4) || width > atlas_max_image_size || height > atlas_max_image_size) {
+    return false;
+  }
+
+  // the page size is read once, placed images depend on it
+  if(_atlas.page_size == 0) {
+    GLint max_size;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    _atlas.page_size = min((uint32_t)max(atlas_page_size, ATLAS_ALIGN), (uint32_t)max_size) & ~(ATLAS_ALIGN - 1);
+  }
+
+  uint32_t padded_width = (width + 2 * ATLAS_PADDING + ATLAS_ALIGN - 1) & ~(ATLAS_ALIGN - 1);
+  uint32_t padded_height = (height + 2 * ATLAS_PADDING + ATLAS_ALIGN - 1) & ~(ATLAS_ALIGN - 1);
+  if(padded_width > _atlas.page_size || padded_height > _atlas.page_size) {
+    return false;
+  }
+
+  uint32_t page = 0, index, x, y;
+  for(; page < _atlas.pages.length; page++) {
+    if(_skyline_fit(&_atlas.pages.data[page], padded_width, padded_height, &index, &x, &y)) {
+      break;
+    }
+  }
+  if(page == _atlas.pages.length) {
+    page = _add_page();
+    _skyline_fit(&_atlas.pages.data[page], padded_width, padded_height, &index, &x, &y);
+  }
+
+  _skyline_add(&_atlas.pages.data[page], index, x, y, padded_width, padded_height);
+  _upload(&_atlas.pages.data[page], x, y, padded_width, padded_height, pixels, width, height, channels);
+
+  Vector_space_for(&_atlas.entries, 1);
+  _Entry * entry = Vector_push(&_atlas.entries);
+  *entry = (_Entry) {
+      .hash = string_hash(path)
+    , .path = string_clone(path)
+    , .page = page
+    , .x = x
+    , .y = y
+    , .width = width
+    , .height = height
+    };
+  _fill(image, entry);
+  return true;
+}
@@ -21,6 +21,11 @@ CONFIGURATION_BOOLEAN(
 static CONFIGURATION_BOOLEAN(application.run, headless, false);
 static CONFIGURATION_STRING(application.run, main_scene, NULL);
 
+// number of bodies, runs the physics benchmarks instead of the game
+static CONFIGURATION_INTEGER(application.run, collision_benchmark, 0);
+static CONFIGURATION_INTEGER(application.run, integration_benchmark, 0);
+static CONFIGURATION_INTEGER(application.run, mass_benchmark, 0);
+
 static inline void _initialization_log_callback(int level, const char * file, unsigned int line, const char * namespace, const char * message) {
   static const char * log_level_code[] = {
     [LogLevel_DEBUG] = "D",
@@ -35,6 +40,10 @@ static inline void _initialization_log_callback(int level, const char * file, un
 int ecs_initialize(void);
 void ecs_shutdown(void);
 
+void physics_collision2d_benchmark(uint32_t bodies, uint32_t steps);
+void physics_integration2d_benchmark(uint32_t bodies, uint32_t steps);
+void physics_mass2d_benchmark(uint32_t bodies, uint32_t steps);
+
 int main(int argc, char * argv []) {
   
   uint32_t initialization_log_callback_index = log_add_callback(_initialization_log_callback);
@@ -74,6 +83,14 @@ int main(int argc, char * argv []) {
 
   ecs_initialize();
 
+  if(collision_benchmark > 0 || integration_benchmark > 0 || mass_benchmark > 0) {
+    physics_collision2d_benchmark(collision_benchmark, 60);
+    physics_integration2d_benchmark(integration_benchmark, 60);
+    physics_mass2d_benchmark(mass_benchmark, 60);
+    ecs_shutdown();
+    return EXIT_SUCCESS;
+  }
+
   display_initialize();
 
   script_load("test.c");
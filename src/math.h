@@ -19,6 +19,9 @@ typedef float R;
 #define R_sqrt sqrtf
 #define R_nan nanf
 #define R_abs fabsf
+#define R_fmod fmodf
+#define R_min fminf
+#define R_max fmaxf
 #define R_isnan isnan
 
 #define R_EPSILON FLT_EPSILON
@@ -38,6 +41,9 @@ typedef double R;
 #define R_cos cos
 #define R_fma fma
 #define R_pow pow
+#define R_fmod fmod
+#define R_min fmin
+#define R_max fmax
 
 #else
 #error "invalid Alias real precision"
@@ -125,12 +131,10 @@ typedef pga3d_10101 pga3d_Motor;
 #define pga3d_normalize(x) pga3d_mul(pga3d_s(1.0f / pga3d_norm(x)), x)
 #define pga3d_inormalize(x) pga3d_mul(pga3d_s(1.0f / pga3d_inorm(x)), x)
 
-#define pga2d_sandwich_vm(x, y) pga2d_grade_1(pga2d_sandwich(pga2d_v(x), pga2d_m(y)))
-#define pga2d_sandwich_vb(x, y) pga2d_grade_1(pga2d_sandwich(pga2d_v(x), pga2d_b(y)))
-#define pga2d_sandwich_bm(x, y) pga2d_grade_2(pga2d_sandwich(pga2d_b(x), pga2d_m(y)))
-#define pga2d_sandwich_bb(x, y) pga2d_grade_2(pga2d_sandwich(pga2d_b(x), pga2d_b(y)))
-
-#define pga3d_sandwich_tm(x, y) pga3d_grade_3(pga3d_sandwich(pga3d_t(x), pga3d_m(y)))
+// the typed sandwiches, pga2d_sandwich_bm and the like, and norm_squared come
+// fused from the generator
+#define pga2d_norm_m(x) R_sqrt(R_abs(pga2d_norm_squared_m(x)))
+#define pga3d_norm_m(x) R_sqrt(R_abs(pga3d_norm_squared_m(x)))
 
 #define pga2d_lerp_b(x, y, t) pga2d_lerp(pga2d_b(x), pga2d_b(y), t)
 #define pga2d_lerp_m(x, y, t) pga2d_lerp(pga2d_m(x), pga2d_m(y), t)
@@ -0,0 +1,36 @@
+#ifndef __LIBRARY_CORE_MATH_FIXED_H__
+#define __LIBRARY_CORE_MATH_FIXED_H__
+
+#include "math.h"
+#include "fixed_point.h"
+
+// every operation in saturating Q16.16, see geometric_algebra --fixed. the
+// results do not depend on platform, compiler or flags, state kept in these
+// types replays bit for bit. pga2d_to_fixed_m and pga2d_from_fixed_m convert
+#include "generated/pga2d_fixed.h"
+#include "generated/pga3d_fixed.h"
+
+typedef pga2d_0100_fixed pga2d_Line_fixed;
+typedef pga2d_0010_fixed pga2d_Point_fixed;
+typedef pga2d_0010_fixed pga2d_Direction_fixed;
+typedef pga2d_1010_fixed pga2d_Motor_fixed;
+
+typedef pga3d_01000_fixed pga3d_Plane_fixed;
+typedef pga3d_00100_fixed pga3d_Line_fixed;
+typedef pga3d_00010_fixed pga3d_Point_fixed;
+typedef pga3d_00010_fixed pga3d_Direction_fixed;
+typedef pga3d_10101_fixed pga3d_Motor_fixed;
+
+#define pga2d_Motor_fixed_IDENTITY ((pga2d_Motor_fixed){.one = FixedPoint16_ONE})
+#define pga3d_Motor_fixed_IDENTITY ((pga3d_Motor_fixed){.one = FixedPoint16_ONE})
+
+#define pga2d_point_fixed(x, y) ((pga2d_Point_fixed){.e02 = FixedPoint16_neg(x), .e01 = y, .e12 = FixedPoint16_ONE})
+#define pga2d_point_fixed_x(p) FixedPoint16_neg(p.e02)
+#define pga2d_point_fixed_y(p) p.e01
+
+static inline FixedPoint16 pga2d_norm_m_fixed(pga2d_Motor_fixed x) {
+  FixedPoint16 n = pga2d_mul_mm_fixed(x, pga2d_conjugate_m_fixed(x)).one;
+  return FixedPoint16_sqrt(n < 0 ? FixedPoint16_neg(n) : n);
+}
+
+#endif
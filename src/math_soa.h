@@ -0,0 +1,23 @@
+#ifndef __LIBRARY_CORE_MATH_SOA_H__
+#define __LIBRARY_CORE_MATH_SOA_H__
+
+#include "math.h"
+
+// batch kernels of every operation over one float array per blade, see
+// geometric_algebra --simd. pga2d_mul_mm_soa(z, x, y, count) is pga2d_mul_mm
+// on count rows
+#include "generated/pga2d_soa.h"
+#include "generated/pga3d_soa.h"
+
+typedef pga2d_0100_soa pga2d_Line_soa;
+typedef pga2d_0010_soa pga2d_Point_soa;
+typedef pga2d_0010_soa pga2d_Direction_soa;
+typedef pga2d_1010_soa pga2d_Motor_soa;
+
+typedef pga3d_01000_soa pga3d_Plane_soa;
+typedef pga3d_00100_soa pga3d_Line_soa;
+typedef pga3d_00010_soa pga3d_Point_soa;
+typedef pga3d_00010_soa pga3d_Direction_soa;
+typedef pga3d_10101_soa pga3d_Motor_soa;
+
+#endif
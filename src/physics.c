@@ -1,10 +1,28 @@
 #include "physics.h"
+#include "physics_local.h"
 
 #include "transform.h"
+#include "configuration.h"
+#include "platform.h"
+#include "profile.h"
+#include "log.h"
+
+#define SOURCE_NAMESPACE core.physics
+
+// integrate whole pages with the batch kernels instead of one body at a time
+static CONFIGURATION_BOOLEAN(SOURCE_NAMESPACE, batch_integration, true);
+
+// physics_step2d, fixed step length in seconds, substeps per step and the most
+// steps one frame may run before the remaining time is dropped
+static CONFIGURATION_REAL(SOURCE_NAMESPACE, fixed_step, 1.0f / 60);
+static CONFIGURATION_INTEGER(SOURCE_NAMESPACE, substeps, 1);
+static CONFIGURATION_INTEGER(SOURCE_NAMESPACE, max_steps, 5);
 
 ECS_COMPONENT(Physics2DMotion, requires(Transform2D))
 
-ECS_COMPONENT(Physics2DMass, requires(Physics2DBodyMotion))
+ECS_COMPONENT(Physics2DMass, requires(Physics2DBodyMotion), requires(Physics2DMassProperties))
+
+ECS_COMPONENT(Physics2DMassProperties)
 
 ECS_COMPONENT(Physics2DCollision)
 
@@ -16,9 +34,17 @@ ECS_COMPONENT(Physics2DGravity, requires(Physics2DBodyMotion))
 
 ECS_COMPONENT(Physics2DDampen, requires(Physics2DBodyMotion))
 
-ECS_COMPONENT(Physics2DBodyMotion, requires(Physics2DMotion))
+ECS_COMPONENT(Physics2DBodyMotion, requires(Physics2DMotion), requires(Physics2DRest))
+
+ECS_COMPONENT(Physics2DRest)
+
+ECS_COMPONENT(Physics2DSleeping)
 
-ECS_QUERY(transform_motion, write(Transform2D, transform), read(Physics2DMotion, motion), exclude(Parent2D), argument(R, duration), action(
+ECS_COMPONENT(Physics2DInterpolation, requires(Transform2D))
+
+ECS_RESOURCE(Physics2DWorld)
+
+ECS_QUERY(transform_motion, write(Transform2D, transform), read(Physics2DMotion, motion), exclude(Parent2D), exclude(Physics2DSleeping), argument(R, duration), action(
   pga2d_Motor M = transform->M;
   pga2d_Bivector B = motion->B;
 
@@ -30,31 +56,37 @@ ECS_QUERY(transform_motion, write(Transform2D, transform), read(Physics2DMotion,
       )
     );
 
-  R d = pga2d_norm(pga2d_m(M));
+  R d = pga2d_norm_m(M);
   transform->M = pga2d_mul(pga2d_s(1.0 / d), pga2d_m(M));
 ))
 
-ECS_QUERY(circle_mass, write(Physics2DBodyMotion, body), read(Physics2DCircle, circle), read(Physics2DMass, mass), action(
+// mass properties only change with the shape or the mass, pages nobody wrote to
+// since the last run are skipped
+static uint64_t _mass_updates;
+
+ECS_QUERY(circle_mass, write(Physics2DMassProperties, properties), read(Physics2DCircle, circle), read(Physics2DMass, mass), modified(Physics2DCircle), modified(Physics2DMass), action(
   R r = circle->radius, x = R_PI * r*r*r*r / 4;
-  body->I = pga2d_mul_sv(mass->value, ((pga2d_Vector) { .e0 = 1, .e1 = x, .e2 = x }));
+  properties->I = pga2d_mul_sv(mass->value, ((pga2d_Vector) { .e0 = 1, .e1 = x, .e2 = x }));
+  _mass_updates++;
 ))
 
-ECS_QUERY(rectangle_mass, write(Physics2DBodyMotion, body), read(Physics2DRectangle, rectangle), read(Physics2DMass, mass), action(
+ECS_QUERY(rectangle_mass, write(Physics2DMassProperties, properties), read(Physics2DRectangle, rectangle), read(Physics2DMass, mass), modified(Physics2DRectangle), modified(Physics2DMass), action(
   R w = rectangle->width
         , h = rectangle->height;
-  body->I = pga2d_mul_sv(mass->value, ((pga2d_Vector) { .e0 = 1, .e1 = (h * w*w*w) / 12, .e2 = (w * h*h*h) / 12 }));
+  properties->I = pga2d_mul_sv(mass->value, ((pga2d_Vector) { .e0 = 1, .e1 = (h * w*w*w) / 12, .e2 = (w * h*h*h) / 12 }));
+  _mass_updates++;
 ))
 
-ECS_QUERY(force_gravity, write(Physics2DBodyMotion, body), read(Transform2D, position), read(Physics2DGravity, gravity), argument(pga2d_Bivector, gravity), action(
+ECS_QUERY(force_gravity, write(Physics2DBodyMotion, body), read(Transform2D, position), read(Physics2DGravity, gravity), exclude(Physics2DSleeping), resource(Physics2DWorld, world), action(
   body->forque = pga2d_add(
       pga2d_v(body->forque),
       pga2d_mul(pga2d_s(gravity->value),
-                      pga2d_dual(pga2d_grade_2(pga2d_sandwich(
-                          pga2d_b(state->gravity),
-                          pga2d_reverse_m(position->value))))));
+                      pga2d_dual_b(pga2d_sandwich_bm(
+                          world->gravity,
+                          pga2d_reverse_m(position->value)))));
 ))
 
-ECS_QUERY(force_dampen, write(Physics2DBodyMotion, body), read(Physics2DMotion, velocity), read(Physics2DDampen, dampen), action(
+ECS_QUERY(force_dampen, write(Physics2DBodyMotion, body), read(Physics2DMotion, velocity), read(Physics2DDampen, dampen), exclude(Physics2DSleeping), action(
   body->forque = pga2d_sub(
       pga2d_v(body->forque),
       pga2d_mul(
@@ -62,32 +94,398 @@ ECS_QUERY(force_dampen, write(Physics2DBodyMotion, body), read(Physics2DMotion,
           pga2d_dual_b(velocity->value)));
 ))
 
-ECS_QUERY(body_motion, write(Physics2DMotion, motion), write(Physics2DBodyMotion, body), argument(R, duration), action(
+ECS_QUERY(body_motion, write(Physics2DMotion, motion), write(Physics2DBodyMotion, body), exclude(Physics2DSleeping), argument(R, duration), action(
   pga2d_Bivector B = motion->B;
   pga2d_AntiBivector F = body->F;
 
-  pga2d_Bivector dB = pga2d_undual(pga2d_sub(
-      pga2d_v(F)
-    , pga2d_commutator_product(pga2d_dual_b(B), pga2d_b(B))
-  ));
+  // carry B into the body frame transform_motion just turned, with the rotor it
+  // turned the body by. the first order commutator term gains a little speed
+  // every step, which adds up on fast spinning bodies
+  R k = state->duration * B.e12 / 2;
+  R n = R_sqrt(1 + k * k);
+  B = pga2d_sandwich_bm(B, ((pga2d_Motor) { .one = 1 / n, .e12 = k / n }));
 
   motion->value = pga2d_add(
       pga2d_b(B),
-      pga2d_mul_sb(state->duration, dB));
+      pga2d_mul_sb(state->duration, pga2d_undual(pga2d_v(F))));
   
   memory_clear(&body->forque, sizeof(body->forque));
 ))
 
-void physics_update2d_serial_pre_transform(R duration) {
+// ====================================================================================================================
+// batch integration
+//
+// the same math as transform_motion and body_motion written out per blade, run
+// over whole pages. rows are gathered into lanes of a vector register, free rows
+// included, and the tail of a page goes through the scalar version
+
+// M -= h M B, then normalize
+static inline void _transform_motion_one(struct Transform2D * transform, const struct Physics2DMotion * motion, R h) {
+  pga2d_Motor M = transform->M;
+  pga2d_Bivector B = motion->B;
+
+  R one = M.one - h * (-M.e12 * B.e12);
+  R e01 = M.e01 - h * (M.one * B.e01 - M.e02 * B.e12 + M.e12 * B.e02);
+  R e02 = M.e02 - h * (M.one * B.e02 + M.e01 * B.e12 - M.e12 * B.e01);
+  R e12 = M.e12 - h * (M.one * B.e12);
+
+  R d = R_sqrt(R_abs(one * one + e12 * e12));
+  transform->M = (pga2d_Motor) { .one = one / d, .e01 = e01 / d, .e02 = e02 / d, .e12 = e12 / d };
+}
+
+// turn B by the angle of transform_motion, tan(a / 2) = dt e12 / 2, then
+// B += dt undual(F) and clear the forque
+static inline void _body_motion_one(struct Physics2DMotion * motion, struct Physics2DBodyMotion * body, R dt) {
+  pga2d_Bivector B = motion->B;
+  pga2d_AntiBivector F = body->F;
+
+  R k = dt * B.e12 / 2, n = 1 + k * k;
+  R c = (1 - k * k) / n, s = 2 * k / n;
+
+  motion->B = (pga2d_Bivector) {
+    .e01 = c * B.e01 + s * B.e02 + dt * F.e2,
+    .e02 = c * B.e02 - s * B.e01 - dt * F.e1,
+    .e12 = B.e12 + dt * F.e0,
+  };
+  memory_clear(&body->forque, sizeof(body->forque));
+}
+
+static void _transform_motion_page(void * ud, uint32_t count, const uint32_t * entities, void ** columns) {
+  (void)entities;
+  struct Transform2D * transform = columns[0];
+  const struct Physics2DMotion * motion = columns[1];
+  R h = *(const R *)ud / 2;
+
+  uint32_t i = 0;
+#if LANES > 1
+  _Lanes vh = _lanes_set(h);
+  for(; i + LANES <= count; i += LANES) {
+    float m[4][LANES], b[3][LANES];
+    for(uint32_t l = 0; l < LANES; l++) {
+      m[0][l] = transform[i + l].M.one;
+      m[1][l] = transform[i + l].M.e01;
+      m[2][l] = transform[i + l].M.e02;
+      m[3][l] = transform[i + l].M.e12;
+      b[0][l] = motion[i + l].B.e01;
+      b[1][l] = motion[i + l].B.e02;
+      b[2][l] = motion[i + l].B.e12;
+    }
+    _Lanes one = _lanes_load(m[0]), e01 = _lanes_load(m[1]), e02 = _lanes_load(m[2]), e12 = _lanes_load(m[3]);
+    _Lanes b01 = _lanes_load(b[0]), b02 = _lanes_load(b[1]), b12 = _lanes_load(b[2]);
+
+    _Lanes p_one = _lanes_sub(_lanes_set(0), _lanes_mul(e12, b12));
+    _Lanes p_e01 = _lanes_add(_lanes_sub(_lanes_mul(one, b01), _lanes_mul(e02, b12)), _lanes_mul(e12, b02));
+    _Lanes p_e02 = _lanes_sub(_lanes_add(_lanes_mul(one, b02), _lanes_mul(e01, b12)), _lanes_mul(e12, b01));
+    _Lanes p_e12 = _lanes_mul(one, b12);
+
+    one = _lanes_sub(one, _lanes_mul(vh, p_one));
+    e01 = _lanes_sub(e01, _lanes_mul(vh, p_e01));
+    e02 = _lanes_sub(e02, _lanes_mul(vh, p_e02));
+    e12 = _lanes_sub(e12, _lanes_mul(vh, p_e12));
+
+    _Lanes d = _lanes_sqrt(_lanes_abs(_lanes_add(_lanes_mul(one, one), _lanes_mul(e12, e12))));
+
+    _lanes_store(m[0], _lanes_div(one, d));
+    _lanes_store(m[1], _lanes_div(e01, d));
+    _lanes_store(m[2], _lanes_div(e02, d));
+    _lanes_store(m[3], _lanes_div(e12, d));
+    for(uint32_t l = 0; l < LANES; l++) {
+      transform[i + l].M = (pga2d_Motor) { .one = m[0][l], .e01 = m[1][l], .e02 = m[2][l], .e12 = m[3][l] };
+    }
+  }
+#endif
+  for(; i < count; i++) {
+    _transform_motion_one(&transform[i], &motion[i], h);
+  }
+}
+
+static void _body_motion_page(void * ud, uint32_t count, const uint32_t * entities, void ** columns) {
+  (void)entities;
+  struct Physics2DMotion * motion = columns[0];
+  struct Physics2DBodyMotion * body = columns[1];
+  R dt = *(const R *)ud;
+
+  uint32_t i = 0;
+#if LANES > 1
+  _Lanes vdt = _lanes_set(dt);
+  for(; i + LANES <= count; i += LANES) {
+    float b[3][LANES], f[3][LANES];
+    for(uint32_t l = 0; l < LANES; l++) {
+      b[0][l] = motion[i + l].B.e01;
+      b[1][l] = motion[i + l].B.e02;
+      b[2][l] = motion[i + l].B.e12;
+      f[0][l] = body[i + l].F.e0;
+      f[1][l] = body[i + l].F.e1;
+      f[2][l] = body[i + l].F.e2;
+    }
+    _Lanes b01 = _lanes_load(b[0]), b02 = _lanes_load(b[1]), b12 = _lanes_load(b[2]);
+
+    _Lanes k = _lanes_mul(_lanes_mul(vdt, _lanes_set(0.5f)), b12);
+    _Lanes kk = _lanes_mul(k, k);
+    _Lanes n = _lanes_add(_lanes_set(1), kk);
+    _Lanes c = _lanes_div(_lanes_sub(_lanes_set(1), kk), n);
+    _Lanes s = _lanes_div(_lanes_add(k, k), n);
+
+    _lanes_store(b[0], _lanes_add(_lanes_add(_lanes_mul(c, b01), _lanes_mul(s, b02)), _lanes_mul(vdt, _lanes_load(f[2]))));
+    _lanes_store(b[1], _lanes_sub(_lanes_sub(_lanes_mul(c, b02), _lanes_mul(s, b01)), _lanes_mul(vdt, _lanes_load(f[1]))));
+    _lanes_store(b[2], _lanes_add(b12, _lanes_mul(vdt, _lanes_load(f[0]))));
+    for(uint32_t l = 0; l < LANES; l++) {
+      motion[i + l].B = (pga2d_Bivector) { .e01 = b[0][l], .e02 = b[1][l], .e12 = b[2][l] };
+      memory_clear(&body[i + l].forque, sizeof(body[i + l].forque));
+    }
+  }
+#endif
+  for(; i < count; i++) {
+    _body_motion_one(&motion[i], &body[i], dt);
+  }
+}
+
+// the batch versions share the queries of the per body versions
+static void transform_motion_batch(R duration) {
+  ecs_execute_query_pages(transform_motion_prepare()->query, _transform_motion_page, &duration);
+}
+
+static void body_motion_batch(R duration) {
+  ecs_execute_query_pages(body_motion_prepare()->query, _body_motion_page, &duration);
+}
+
+// the queries are variadic, the benchmark calls through a plain pointer
+static void transform_motion_per_body(R duration) {
   transform_motion(duration);
+}
+
+static void body_motion_per_body(R duration) {
+  body_motion(duration);
+}
+
+// ====================================================================================================================
+void physics_update2d_serial_pre_transform(R duration) {
+  if(batch_integration) {
+    transform_motion_batch(duration);
+  } else {
+    transform_motion(duration);
+  }
   circle_mass();
   rectangle_mass();
+  if(_mass_updates > 0) {
+    Physics2DWorld_write_resource()->mass_updates += _mass_updates;
+    _mass_updates = 0;
+  }
 }
 
 void physics_update2d_serial_post_transform(R duration) {
-  pga2d_Bivector gravity; // uninitialized
-  
-  force_gravity(gravity);
+  force_gravity();
   force_dampen();
-  body_motion(duration);
+  if(batch_integration) {
+    body_motion_batch(duration);
+  } else {
+    body_motion(duration);
+  }
+}
+
+// ====================================================================================================================
+// fixed step
+ECS_QUERY(interpolation_store, write(Physics2DInterpolation, interpolation), read(Transform2D, transform), exclude(Parent2D), action(
+  (void)state;
+  interpolation->previous = transform->M;
+))
+
+ECS_QUERY(interpolation_blend, write(Physics2DInterpolation, interpolation), read(Transform2D, transform), exclude(Parent2D), argument(R, alpha), action(
+  pga2d_Motor a = interpolation->previous;
+  pga2d_Motor b = transform->M;
+  R t = state->alpha;
+
+  // M and -M are the same motion, blend along the short way
+  R s = a.one * b.one + a.e12 * b.e12 < 0 ? -1 : 1;
+
+  pga2d_Motor M = {
+    .one = (1 - t) * s * a.one + t * b.one,
+    .e01 = (1 - t) * s * a.e01 + t * b.e01,
+    .e02 = (1 - t) * s * a.e02 + t * b.e02,
+    .e12 = (1 - t) * s * a.e12 + t * b.e12,
+  };
+  R d = pga2d_norm_m(M);
+  interpolation->motor = pga2d_mul(pga2d_s(1.0 / d), pga2d_m(M));
+  interpolation->position = pga2d_sandwich_bm(pga2d_point(0, 0), interpolation->motor);
+  interpolation->orientation = atan2f(interpolation->motor.e12, interpolation->motor.one) * 2;
+))
+
+static void _fixed_step(R duration) {
+  uint32_t count = substeps > 0 ? substeps : 1;
+  R substep = duration / count;
+  profile_begin("physics_step2d");
+  for(uint32_t i = 0; i < count; i++) {
+    physics_update2d_serial_pre_transform(substep);
+    transform_update2d_serial();
+    physics_update2d_serial_post_transform(substep);
+  }
+  physics_collide2d();
+  physics_solve2d(duration);
+  physics_sleep2d(duration);
+  profile_end();
+}
+
+uint32_t physics_step2d(R frame_duration) {
+  struct Physics2DWorld * world = Physics2DWorld_write_resource();
+
+  R step = fixed_step > 0 ? fixed_step : 1.0f / 60;
+  world->accumulator += frame_duration > 0 ? frame_duration : 0;
+
+  // after a spike, run at most max_steps and drop the rest instead of falling
+  // further behind with every frame
+  uint32_t count = 0;
+  uint64_t start = platform_time_nanoseconds();
+  while(world->accumulator >= step && (max_steps <= 0 || count < max_steps)) {
+    interpolation_store();
+    _fixed_step(step);
+    world->accumulator -= step;
+    world->steps++;
+    count++;
+  }
+  uint64_t duration = platform_time_nanoseconds() - start;
+
+  world->frame_dropped = 0;
+  if(world->accumulator >= step) {
+    R keep = R_fmod(world->accumulator, step);
+    world->frame_dropped = world->accumulator - keep;
+    world->accumulator = keep;
+  }
+
+  world->frame_steps = count;
+  world->frame_step_nanoseconds = count > 0 ? duration / count : 0;
+  world->alpha = world->accumulator / step;
+
+  interpolation_blend(world->alpha);
+
+  return count;
+}
+
+// ====================================================================================================================
+static void _integration_benchmark_run(const char * name, void (*transform_step)(R), void (*body_step)(R), uint32_t bodies, uint32_t steps) {
+  uint64_t transform_total = 0, body_total = 0;
+  for(uint32_t i = 0; i < steps; i++) {
+    uint64_t start = platform_time_nanoseconds();
+    transform_step(1.0f / 60);
+    uint64_t middle = platform_time_nanoseconds();
+    body_step(1.0f / 60);
+    uint64_t end = platform_time_nanoseconds();
+    transform_total += middle - start;
+    body_total += end - middle;
+  }
+  INFO(SOURCE_NAMESPACE, "integration benchmark %s: %u bodies, transform_motion %llu us, body_motion %llu us per step",
+       name, bodies, (unsigned long long)(transform_total / steps / 1000), (unsigned long long)(body_total / steps / 1000));
+}
+
+void physics_integration2d_benchmark(uint32_t bodies, uint32_t steps) {
+  if(bodies == 0 || steps == 0) {
+    return;
+  }
+
+  struct Transform2D * transforms = memory_alloc(sizeof(*transforms) * bodies, alignof(struct Transform2D));
+  struct Physics2DMotion * motions = memory_alloc(sizeof(*motions) * bodies, alignof(struct Physics2DMotion));
+  for(uint32_t i = 0; i < bodies; i++) {
+    transforms[i].M = pga2d_motor(i * 0.001f, 1, pga2d_direction(i % 100, i / 100));
+    motions[i].B = (pga2d_Bivector) { .e01 = (i % 7) * 0.1f, .e02 = (i % 5) * 0.1f, .e12 = (i % 3) * 0.1f };
+  }
+
+  ecs_EntityHandle * entities = memory_alloc(sizeof(*entities) * bodies, alignof(ecs_EntityHandle));
+  ecs_spawn(&(ecs_EntitySpawnInfo) {
+    .layer = ECS_INVALID_LAYER,
+    .count = bodies,
+    .num_components = 3,
+    .components = (ecs_EntitySpawnComponent[]) {
+      { .component = Transform2D_component(), .data = transforms },
+      { .component = Physics2DMotion_component(), .data = motions },
+      { .component = Physics2DBodyMotion_component() },
+    },
+  }, entities);
+
+  INFO(SOURCE_NAMESPACE, "integration benchmark using %u lanes", LANES);
+  _integration_benchmark_run("per body", transform_motion_per_body, body_motion_per_body, bodies, steps);
+  _integration_benchmark_run("batch", transform_motion_batch, body_motion_batch, bodies, steps);
+
+  ecs_despawn(bodies, entities);
+
+  memory_free(entities, sizeof(*entities) * bodies, alignof(ecs_EntityHandle));
+  memory_free(motions, sizeof(*motions) * bodies, alignof(struct Physics2DMotion));
+  memory_free(transforms, sizeof(*transforms) * bodies, alignof(struct Transform2D));
+}
+
+// ====================================================================================================================
+void physics_mass2d_benchmark(uint32_t bodies, uint32_t steps) {
+  if(bodies == 0 || steps == 0) {
+    return;
+  }
+
+  struct Transform2D * transforms = memory_alloc(sizeof(*transforms) * bodies, alignof(struct Transform2D));
+  struct Physics2DMotion * motions = memory_alloc(sizeof(*motions) * bodies, alignof(struct Physics2DMotion));
+  struct Physics2DMass * masses = memory_alloc(sizeof(*masses) * bodies, alignof(struct Physics2DMass));
+  struct Physics2DCircle * circles = memory_alloc(sizeof(*circles) * bodies, alignof(struct Physics2DCircle));
+  struct Physics2DRectangle * rectangles = memory_alloc(sizeof(*rectangles) * bodies, alignof(struct Physics2DRectangle));
+  for(uint32_t i = 0; i < bodies; i++) {
+    transforms[i].M = pga2d_motor(i * 0.001f, 1, pga2d_direction(i % 100, i / 100));
+    motions[i].B = (pga2d_Bivector) { .e01 = (i % 7) * 0.1f, .e02 = (i % 5) * 0.1f, .e12 = (i % 3) * 0.1f };
+    masses[i].value = 1 + (i % 11);
+    circles[i].radius = 1 + (i % 13) * 0.1f;
+    rectangles[i] = (struct Physics2DRectangle) { .width = circles[i].radius * 2, .height = circles[i].radius };
+  }
+
+  uint32_t num_circles = bodies / 2;
+  ecs_EntityHandle * entities = memory_alloc(sizeof(*entities) * bodies, alignof(ecs_EntityHandle));
+
+  ecs_spawn(&(ecs_EntitySpawnInfo) {
+    .layer = ECS_INVALID_LAYER,
+    .count = num_circles,
+    .num_components = 4,
+    .components = (ecs_EntitySpawnComponent[]) {
+      { .component = Transform2D_component(), .data = transforms },
+      { .component = Physics2DMotion_component(), .data = motions },
+      { .component = Physics2DMass_component(), .data = masses },
+      { .component = Physics2DCircle_component(), .data = circles },
+    },
+  }, entities);
+  ecs_spawn(&(ecs_EntitySpawnInfo) {
+    .layer = ECS_INVALID_LAYER,
+    .count = bodies - num_circles,
+    .num_components = 4,
+    .components = (ecs_EntitySpawnComponent[]) {
+      { .component = Transform2D_component(), .data = transforms + num_circles },
+      { .component = Physics2DMotion_component(), .data = motions + num_circles },
+      { .component = Physics2DMass_component(), .data = masses + num_circles },
+      { .component = Physics2DRectangle_component(), .data = rectangles + num_circles },
+    },
+  }, entities + num_circles);
+
+  // the first step computes every spawned body. the ones after write transforms
+  // and motion into the same pages, but no shape or mass. collision, solver and
+  // sleep are left out, a body falling asleep moves and counts as spawned again
+  R step = 1.0f / 60;
+  uint64_t before = Physics2DWorld_read_resource()->mass_updates;
+  physics_update2d_serial_pre_transform(step);
+  uint64_t first = Physics2DWorld_read_resource()->mass_updates;
+
+  uint64_t start = platform_time_nanoseconds();
+  for(uint32_t i = 0; i < steps; i++) {
+    physics_update2d_serial_pre_transform(step);
+    transform_update2d_serial();
+    physics_update2d_serial_post_transform(step);
+  }
+  uint64_t duration = platform_time_nanoseconds() - start;
+  uint64_t updates = Physics2DWorld_read_resource()->mass_updates - first;
+
+  INFO(SOURCE_NAMESPACE, "mass benchmark: %u bodies, %llu mass updates in the first step, %llu in %u static steps after, %llu us per step",
+       bodies, (unsigned long long)(first - before), (unsigned long long)updates, steps,
+       (unsigned long long)(duration / steps / 1000));
+  if(updates > 0) {
+    ERROR(SOURCE_NAMESPACE, "mass benchmark: mass properties were recomputed without a write to a shape or a mass");
+  }
+
+  ecs_despawn(bodies, entities);
+
+  memory_free(entities, sizeof(*entities) * bodies, alignof(ecs_EntityHandle));
+  memory_free(rectangles, sizeof(*rectangles) * bodies, alignof(struct Physics2DRectangle));
+  memory_free(circles, sizeof(*circles) * bodies, alignof(struct Physics2DCircle));
+  memory_free(masses, sizeof(*masses) * bodies, alignof(struct Physics2DMass));
+  memory_free(motions, sizeof(*motions) * bodies, alignof(struct Physics2DMotion));
+  memory_free(transforms, sizeof(*transforms) * bodies, alignof(struct Transform2D));
 }
@@ -17,8 +17,13 @@ ECS_DECLARE_COMPONENT(Physics2DMass, {
   R value;
 })
 
+// bodies collide when their masks share a bit. shape comes from
+// Physics2DCircle or Physics2DRectangle, placement from LocalToWorld2D
 ECS_DECLARE_COMPONENT(Physics2DCollision, {
   uint32_t mask;
+
+  // broadphase bookkeeping, leave zero
+  uint32_t proxy;
 })
 
 ECS_DECLARE_COMPONENT(Physics2DCircle, {
@@ -43,7 +48,100 @@ ECS_DECLARE_COMPONENT(Physics2DBodyMotion, {
     pga2d_AntiBivector forque;
     pga2d_AntiBivector F;
   };
+})
+
+// derived from Physics2DMass and the shape, only refreshed when one of those is
+// added or written. e0 is the mass, e1 and e2 the moments around the two axes
+ECS_DECLARE_COMPONENT(Physics2DMassProperties, {
   pga2d_AntiBivector I;
 })
 
+// how long a body has been moving slower than the sleep threshold
+ECS_DECLARE_COMPONENT(Physics2DRest, {
+  R time;
+})
+
+// resting bodies are moved here and skipped by the integration queries until a
+// contact with an awake body, a write to their motion or physics_wake2d
+ECS_DECLARE_COMPONENT(Physics2DSleeping, {
+  uint64_t since_step;
+})
+
+// keeps the transform from before the last fixed step so rendering can blend
+// between the last two steps, see physics_step2d
+ECS_DECLARE_COMPONENT(Physics2DInterpolation, {
+  pga2d_Motor previous;
+
+  // blend of previous and Transform2D by Physics2DWorld alpha
+  pga2d_Motor motor;
+  pga2d_Point position;
+  R orientation;
+})
+
+// world wide settings shared by the physics queries
+ECS_DECLARE_RESOURCE(Physics2DWorld, {
+  pga2d_Bivector gravity;
+
+  // fixed step state, written by physics_step2d
+  R accumulator;
+  R alpha;
+  uint64_t steps;
+
+  // of the last physics_step2d call
+  uint32_t frame_steps;
+  uint64_t frame_step_nanoseconds;
+  R frame_dropped;
+
+
+  // of the last step's contact solver
+  uint32_t solver_rows;
+  uint32_t solver_colors;
+
+  // bodies whose Physics2DMassProperties were recomputed, over all steps
+  uint64_t mass_updates;
+})
+
+// runs as many fixed steps as fit in the time accumulated so far, each split in
+// substeps, and refreshes Physics2DInterpolation. returns the number of steps
+uint32_t physics_step2d(R frame_duration);
+
+typedef struct Physics2DContact {
+  ecs_EntityHandle a;
+  ecs_EntityHandle b;
+
+  // unit length, points from a to b
+  pga2d_Direction normal;
+  pga2d_Point point;
+  R depth;
+} Physics2DContact;
+
+// finds every touching pair of Physics2DCollision bodies. the returned contacts
+// stay valid until the next call
+void physics_collide2d(void);
+
+const Physics2DContact * physics_contacts2d(uint32_t * count);
+
+// spawns bodies on a crowded field, steps the collision pipeline and logs the
+// timings
+void physics_collision2d_benchmark(uint32_t bodies, uint32_t steps);
+
+// pushes touching bodies apart with impulses, run by physics_step2d after
+// physics_collide2d. contacts are colored into batches that share no movable
+// body, each batch runs on the worker threads
+void physics_solve2d(R duration);
+
+// puts resting islands of touching bodies to sleep and wakes the ones an awake
+// body touches, run by physics_step2d after physics_collide2d
+void physics_sleep2d(R duration);
+
+// call after pushing a body from outside physics
+void physics_wake2d(ecs_EntityHandle entity);
+
+// times the per body and the batch integrators over the same bodies
+void physics_integration2d_benchmark(uint32_t bodies, uint32_t steps);
+
+// steps bodies that never write a shape or a mass and logs an error when
+// Physics2DWorld mass_updates still grows after the first step
+void physics_mass2d_benchmark(uint32_t bodies, uint32_t steps);
+
 #endif // physics_h_INCLUDED
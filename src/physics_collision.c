@@ -0,0 +1,479 @@
+#include "physics.h"
+
+#include "transform.h"
+#include "platform.h"
+#include "configuration.h"
+#include "vector.h"
+#include "log.h"
+#include "sort.h"
+
+#define SOURCE_NAMESPACE core.physics
+
+// sweep the broadphase on the worker threads
+static CONFIGURATION_BOOLEAN(SOURCE_NAMESPACE, parallel_collision, true);
+
+// sorted entries handed to one worker at a time
+#define COLLISION_GRAIN 1024
+
+// more new bodies than this in one step and the list is sorted from scratch
+#define COLLISION_RESORT 256
+
+// entity of a proxy slot on the free list, no live handle has every bit set
+#define COLLISION_FREE_PROXY (~(ecs_EntityHandle)0)
+
+// ====================================================================================================================
+// broadphase
+//
+// incremental sort and sweep on the x axis. every body keeps a proxy slot across
+// steps and the sorted list from the previous step is repaired with an insertion
+// sort, which is close to linear while bodies move a little per step
+typedef struct {
+  ecs_EntityHandle entity;
+  uint32_t mask;
+  uint32_t seen;
+
+  R x, y;
+  R cos, sin;
+
+  // circle when radius is non zero, else rectangle
+  R radius;
+  R half_width, half_height;
+} _Proxy;
+
+typedef struct {
+  R min_x, max_x, min_y, max_y;
+  uint32_t proxy;
+} _Bounds;
+
+typedef Vector(Physics2DContact) _Contacts;
+
+static struct {
+  uint32_t step;
+  uint32_t added;
+  Vector(_Proxy) proxies;
+  Vector(uint32_t) free_proxies;
+  Vector(_Bounds) sorted;
+
+  // one output per chunk of the sweep so the result does not depend on which
+  // worker ran the chunk
+  uint32_t num_chunks;
+  _Contacts * chunks;
+
+  _Contacts contacts;
+} _collision;
+
+static uint32_t _allocate_proxy(void) {
+  if(_collision.free_proxies.length > 0) {
+    return *Vector_pop(&_collision.free_proxies);
+  }
+  Vector_space_for(&_collision.proxies, 1);
+  _Proxy * proxy = Vector_push(&_collision.proxies);
+  memory_clear(proxy, sizeof(*proxy));
+  return _collision.proxies.length - 1;
+}
+
+static void _proxy_bounds(const _Proxy * proxy, _Bounds * bounds) {
+  R ex, ey;
+  if(proxy->radius > 0) {
+    ex = ey = proxy->radius;
+  } else {
+    R c = R_abs(proxy->cos), s = R_abs(proxy->sin);
+    ex = c * proxy->half_width + s * proxy->half_height;
+    ey = s * proxy->half_width + c * proxy->half_height;
+  }
+  bounds->min_x = proxy->x - ex;
+  bounds->max_x = proxy->x + ex;
+  bounds->min_y = proxy->y - ey;
+  bounds->max_y = proxy->y + ey;
+}
+
+ECS_QUERY(_collision_update
+  , write(Physics2DCollision, collision)
+  , read(LocalToWorld2D, transform)
+  , read(Physics2DCircle, circle)
+  , read(Physics2DRectangle, rectangle)
+  , optional(Physics2DCircle)
+  , optional(Physics2DRectangle)
+  , argument(uint32_t, step)
+  , action(
+    if(circle == NULL && rectangle == NULL) {
+      return;
+    }
+
+    // the slot can be stale or copied from a prefab, only trust it when it points back here
+    uint32_t index = collision->proxy - 1;
+    if(collision->proxy == 0 || index >= _collision.proxies.length || _collision.proxies.data[index].entity != entity) {
+      index = _allocate_proxy();
+      collision->proxy = index + 1;
+      _collision.proxies.data[index].entity = entity;
+
+      Vector_space_for(&_collision.sorted, 1);
+      Vector_push(&_collision.sorted)->proxy = index;
+      _collision.added++;
+    }
+
+    _Proxy * proxy = &_collision.proxies.data[index];
+    proxy->mask = collision->mask;
+    proxy->seen = state->step;
+    proxy->x = pga2d_point_x(transform->position);
+    proxy->y = pga2d_point_y(transform->position);
+    proxy->cos = R_cos(transform->orientation);
+    proxy->sin = R_sin(transform->orientation);
+    if(circle != NULL) {
+      proxy->radius = circle->radius;
+    } else {
+      proxy->radius = 0;
+      proxy->half_width = rectangle->width / 2;
+      proxy->half_height = rectangle->height / 2;
+    }
+  )
+)
+
+static int _compare_bounds(const void * ap, const void * bp, void * ud) {
+  const _Bounds * a = (const _Bounds *)ap;
+  const _Bounds * b = (const _Bounds *)bp;
+  return a->min_x < b->min_x ? -1 : a->min_x > b->min_x;
+}
+
+static void _broadphase_update(void) {
+  uint32_t step = ++_collision.step;
+
+  _collision.added = 0;
+  _collision_update(step);
+
+  // drop proxies of bodies that were despawned or lost their shape, refresh the rest
+  uint32_t length = 0;
+  for(uint32_t i = 0; i < _collision.sorted.length; i++) {
+    _Bounds bounds = _collision.sorted.data[i];
+    _Proxy * proxy = &_collision.proxies.data[bounds.proxy];
+    if(proxy->seen != step) {
+      proxy->entity = COLLISION_FREE_PROXY;
+      Vector_space_for(&_collision.free_proxies, 1);
+      *Vector_push(&_collision.free_proxies) = bounds.proxy;
+      continue;
+    }
+    _proxy_bounds(proxy, &bounds);
+    _collision.sorted.data[length++] = bounds;
+  }
+  _collision.sorted.length = length;
+
+  // new bodies are appended in no particular order, too many of them would make
+  // the insertion sort quadratic
+  if(_collision.added > COLLISION_RESORT) {
+    Vector_qsort(&_collision.sorted, _compare_bounds, NULL);
+    return;
+  }
+
+  _Bounds * sorted = _collision.sorted.data;
+  for(uint32_t i = 1; i < length; i++) {
+    _Bounds bounds = sorted[i];
+    uint32_t j = i;
+    while(j > 0 && sorted[j - 1].min_x > bounds.min_x) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = bounds;
+  }
+}
+
+// ====================================================================================================================
+// narrowphase
+static void _push_contact(_Contacts * contacts, const _Proxy * a, const _Proxy * b, R nx, R ny, R px, R py, R depth) {
+  Vector_space_for(contacts, 1);
+  *Vector_push(contacts) = (Physics2DContact) {
+    .a = a->entity,
+    .b = b->entity,
+    .normal = pga2d_direction(nx, ny),
+    .point = pga2d_point(px, py),
+    .depth = depth,
+  };
+}
+
+static void _circle_circle(_Contacts * contacts, const _Proxy * a, const _Proxy * b) {
+  R dx = b->x - a->x, dy = b->y - a->y;
+  R r = a->radius + b->radius;
+  R d2 = dx * dx + dy * dy;
+  if(d2 >= r * r) {
+    return;
+  }
+  R d = R_sqrt(d2);
+  R nx = 1, ny = 0;
+  if(d > R_EPSILON) {
+    nx = dx / d;
+    ny = dy / d;
+  }
+  _push_contact(contacts, a, b, nx, ny, a->x + nx * a->radius, a->y + ny * a->radius, r - d);
+}
+
+// normal points from the rectangle to the circle
+static bool _rectangle_circle_test(const _Proxy * rectangle, const _Proxy * circle, R * nx, R * ny, R * px, R * py, R * depth) {
+  R c = rectangle->cos, s = rectangle->sin;
+  R hw = rectangle->half_width, hh = rectangle->half_height;
+
+  R dx = circle->x - rectangle->x, dy = circle->y - rectangle->y;
+  R lx = c * dx + s * dy;
+  R ly = -s * dx + c * dy;
+
+  R qx = lx < -hw ? -hw : lx > hw ? hw : lx;
+  R qy = ly < -hh ? -hh : ly > hh ? hh : ly;
+
+  R ox = lx - qx, oy = ly - qy;
+  R d2 = ox * ox + oy * oy;
+  if(d2 >= circle->radius * circle->radius) {
+    return false;
+  }
+
+  R lnx, lny, d;
+  if(d2 > R_EPSILON) {
+    // center outside, push along the offset to the closest point
+    d = R_sqrt(d2);
+    lnx = ox / d;
+    lny = oy / d;
+    *depth = circle->radius - d;
+  } else {
+    // center inside, push out through the nearest side
+    R fx = hw - R_abs(lx), fy = hh - R_abs(ly);
+    if(fx < fy) {
+      lnx = lx < 0 ? -1 : 1;
+      lny = 0;
+      qx = lnx * hw;
+      *depth = circle->radius + fx;
+    } else {
+      lnx = 0;
+      lny = ly < 0 ? -1 : 1;
+      qy = lny * hh;
+      *depth = circle->radius + fy;
+    }
+  }
+
+  *nx = c * lnx - s * lny;
+  *ny = s * lnx + c * lny;
+  *px = rectangle->x + c * qx - s * qy;
+  *py = rectangle->y + s * qx + c * qy;
+  return true;
+}
+
+static R _project_rectangle(const _Proxy * rectangle, R ax, R ay) {
+  return rectangle->half_width * R_abs(rectangle->cos * ax + rectangle->sin * ay)
+       + rectangle->half_height * R_abs(-rectangle->sin * ax + rectangle->cos * ay);
+}
+
+static void _rectangle_rectangle(_Contacts * contacts, const _Proxy * a, const _Proxy * b) {
+  R axes[4][2] = {
+    { a->cos, a->sin }, { -a->sin, a->cos },
+    { b->cos, b->sin }, { -b->sin, b->cos },
+  };
+  R dx = b->x - a->x, dy = b->y - a->y;
+
+  R depth = R_MAX, nx = 0, ny = 0;
+  for(uint32_t i = 0; i < 4; i++) {
+    R ax = axes[i][0], ay = axes[i][1];
+    R distance = dx * ax + dy * ay;
+    R overlap = _project_rectangle(a, ax, ay) + _project_rectangle(b, ax, ay) - R_abs(distance);
+    if(overlap <= 0) {
+      return;
+    }
+    if(overlap < depth) {
+      depth = overlap;
+      nx = distance < 0 ? -ax : ax;
+      ny = distance < 0 ? -ay : ay;
+    }
+  }
+
+  // the corner of b deepest along the normal
+  R bx = b->cos * nx + b->sin * ny;
+  R by = -b->sin * nx + b->cos * ny;
+  R cx = (bx > 0 ? -1 : 1) * b->half_width;
+  R cy = (by > 0 ? -1 : 1) * b->half_height;
+  R px = b->x + b->cos * cx - b->sin * cy;
+  R py = b->y + b->sin * cx + b->cos * cy;
+
+  _push_contact(contacts, a, b, nx, ny, px, py, depth);
+}
+
+static void _narrowphase(_Contacts * contacts, const _Proxy * a, const _Proxy * b) {
+  R nx, ny, px, py, depth;
+  if(a->radius > 0 && b->radius > 0) {
+    _circle_circle(contacts, a, b);
+  } else if(a->radius > 0) {
+    if(_rectangle_circle_test(b, a, &nx, &ny, &px, &py, &depth)) {
+      _push_contact(contacts, a, b, -nx, -ny, px, py, depth);
+    }
+  } else if(b->radius > 0) {
+    if(_rectangle_circle_test(a, b, &nx, &ny, &px, &py, &depth)) {
+      _push_contact(contacts, a, b, nx, ny, px, py, depth);
+    }
+  } else {
+    _rectangle_rectangle(contacts, a, b);
+  }
+}
+
+// ====================================================================================================================
+static void _sweep(void * user_data, uint32_t worker, uint32_t begin, uint32_t end) {
+  (void)user_data;
+  (void)worker;
+
+  _Contacts * contacts = &_collision.chunks[begin / COLLISION_GRAIN];
+  contacts->length = 0;
+
+  const _Bounds * sorted = _collision.sorted.data;
+  const _Proxy * proxies = _collision.proxies.data;
+  uint32_t length = _collision.sorted.length;
+
+  for(uint32_t i = begin; i < end; i++) {
+    const _Bounds * a = &sorted[i];
+    const _Proxy * pa = &proxies[a->proxy];
+    for(uint32_t j = i + 1; j < length && sorted[j].min_x <= a->max_x; j++) {
+      const _Bounds * b = &sorted[j];
+      if(b->min_y > a->max_y || b->max_y < a->min_y) {
+        continue;
+      }
+      const _Proxy * pb = &proxies[b->proxy];
+      if((pa->mask & pb->mask) == 0) {
+        continue;
+      }
+      _narrowphase(contacts, pa, pb);
+    }
+  }
+}
+
+void physics_collide2d(void) {
+  _broadphase_update();
+
+  uint32_t length = _collision.sorted.length;
+  uint32_t num_chunks = (length + COLLISION_GRAIN - 1) / COLLISION_GRAIN;
+  if(num_chunks > _collision.num_chunks) {
+    _collision.chunks = memory_realloc(_collision.chunks, sizeof(_Contacts) * _collision.num_chunks, sizeof(_Contacts) * num_chunks, alignof(_Contacts));
+    memory_clear(_collision.chunks + _collision.num_chunks, sizeof(_Contacts) * (num_chunks - _collision.num_chunks));
+    _collision.num_chunks = num_chunks;
+  }
+
+  if(parallel_collision) {
+    platform_parallel_for(length, COLLISION_GRAIN, _sweep, NULL);
+  } else {
+    for(uint32_t begin = 0; begin < length; begin += COLLISION_GRAIN) {
+      _sweep(NULL, 0, begin, length - begin < COLLISION_GRAIN ? length : begin + COLLISION_GRAIN);
+    }
+  }
+
+  _collision.contacts.length = 0;
+  for(uint32_t i = 0; i < num_chunks; i++) {
+    const _Contacts * chunk = &_collision.chunks[i];
+    if(chunk->length == 0) {
+      continue;
+    }
+    Vector_space_for(&_collision.contacts, chunk->length);
+    memory_copy(_collision.contacts.data + _collision.contacts.length, sizeof(Physics2DContact) * chunk->length, chunk->data, sizeof(Physics2DContact) * chunk->length);
+    _collision.contacts.length += chunk->length;
+  }
+}
+
+const Physics2DContact * physics_contacts2d(uint32_t * count) {
+  *count = _collision.contacts.length;
+  return _collision.contacts.data;
+}
+
+// ====================================================================================================================
+// benchmark
+ECS_QUERY(_collision_benchmark_move
+  , write(LocalToWorld2D, transform)
+  , argument(uint32_t, step)
+  , action(
+    // a small orbit per body keeps the sorted order mostly intact, like a real scene
+    R phase = (R)(entity & 0xFFFF) * 0.61803398875f + state->step * 0.05f;
+    R x = pga2d_point_x(transform->position) + R_cos(phase) * 0.05f;
+    R y = pga2d_point_y(transform->position) + R_sin(phase) * 0.05f;
+    transform->position = pga2d_point(x, y);
+    transform->orientation += 0.01f;
+  )
+)
+
+static uint32_t _benchmark_random(uint32_t * seed) {
+  *seed = *seed * 1664525u + 1013904223u;
+  return *seed >> 8;
+}
+
+static void _benchmark_run(const char * name, uint32_t bodies, uint32_t steps) {
+  uint64_t total = 0, worst = 0;
+  uint32_t contacts = 0;
+  for(uint32_t i = 0; i < steps; i++) {
+    _collision_benchmark_move(i);
+
+    uint64_t start = platform_time_nanoseconds();
+    physics_collide2d();
+    uint64_t duration = platform_time_nanoseconds() - start;
+
+    total += duration;
+    worst = duration > worst ? duration : worst;
+    physics_contacts2d(&contacts);
+  }
+  INFO(SOURCE_NAMESPACE, "collision benchmark %s: %u bodies, %u steps, %llu us average, %llu us worst, %u contacts in the last step",
+       name, bodies, steps, (unsigned long long)(total / steps / 1000), (unsigned long long)(worst / 1000), contacts);
+}
+
+void physics_collision2d_benchmark(uint32_t bodies, uint32_t steps) {
+  if(bodies == 0 || steps == 0) {
+    return;
+  }
+
+  // about four bodies per 10x10 area, which keeps a few contacts per body
+  R side = R_sqrt((R)bodies * 25);
+  uint32_t seed = 1;
+
+  struct LocalToWorld2D * transforms = memory_alloc(sizeof(*transforms) * bodies, alignof(struct LocalToWorld2D));
+  struct Physics2DCollision * collisions = memory_alloc(sizeof(*collisions) * bodies, alignof(struct Physics2DCollision));
+  struct Physics2DCircle * circles = memory_alloc(sizeof(*circles) * bodies, alignof(struct Physics2DCircle));
+  struct Physics2DRectangle * rectangles = memory_alloc(sizeof(*rectangles) * bodies, alignof(struct Physics2DRectangle));
+
+  for(uint32_t i = 0; i < bodies; i++) {
+    R x = (_benchmark_random(&seed) & 0xFFFF) / 65536.0f * side;
+    R y = (_benchmark_random(&seed) & 0xFFFF) / 65536.0f * side;
+    transforms[i] = (struct LocalToWorld2D) { .position = pga2d_point(x, y), .orientation = (_benchmark_random(&seed) & 0xFF) / 40.0f };
+    collisions[i] = (struct Physics2DCollision) { .mask = 1 };
+    circles[i] = (struct Physics2DCircle) { .radius = 1 + (_benchmark_random(&seed) & 0xFF) / 256.0f };
+    rectangles[i] = (struct Physics2DRectangle) { .width = circles[i].radius * 2, .height = circles[i].radius };
+  }
+
+  uint32_t num_circles = bodies / 2;
+  ecs_EntityHandle * entities = memory_alloc(sizeof(*entities) * bodies, alignof(ecs_EntityHandle));
+
+  ecs_spawn(&(ecs_EntitySpawnInfo) {
+    .layer = ECS_INVALID_LAYER,
+    .count = num_circles,
+    .num_components = 3,
+    .components = (ecs_EntitySpawnComponent[]) {
+      { .component = LocalToWorld2D_component(), .data = transforms },
+      { .component = Physics2DCollision_component(), .data = collisions },
+      { .component = Physics2DCircle_component(), .data = circles },
+    },
+  }, entities);
+  ecs_spawn(&(ecs_EntitySpawnInfo) {
+    .layer = ECS_INVALID_LAYER,
+    .count = bodies - num_circles,
+    .num_components = 3,
+    .components = (ecs_EntitySpawnComponent[]) {
+      { .component = LocalToWorld2D_component(), .data = transforms + num_circles },
+      { .component = Physics2DCollision_component(), .data = collisions + num_circles },
+      { .component = Physics2DRectangle_component(), .data = rectangles + num_circles },
+    },
+  }, entities + num_circles);
+
+  bool parallel = parallel_collision;
+
+  parallel_collision = false;
+  _benchmark_run("serial", bodies, steps);
+
+  parallel_collision = true;
+  INFO(SOURCE_NAMESPACE, "collision benchmark using %u workers", platform_worker_count());
+  _benchmark_run("parallel", bodies, steps);
+
+  parallel_collision = parallel;
+
+  ecs_despawn(bodies, entities);
+
+  memory_free(entities, sizeof(*entities) * bodies, alignof(ecs_EntityHandle));
+  memory_free(rectangles, sizeof(*rectangles) * bodies, alignof(struct Physics2DRectangle));
+  memory_free(circles, sizeof(*circles) * bodies, alignof(struct Physics2DCircle));
+  memory_free(collisions, sizeof(*collisions) * bodies, alignof(struct Physics2DCollision));
+  memory_free(transforms, sizeof(*transforms) * bodies, alignof(struct LocalToWorld2D));
+}
@@ -0,0 +1,43 @@
+#ifndef physics_local_h_INCLUDED
+#define physics_local_h_INCLUDED
+
+#include "math.h"
+
+// vector registers for the batch kernels of the physics files. LANES is 1 when
+// R is not float or the target has no SSE, the kernels then only run their
+// scalar tails
+#if REAL_PRECISION == 32 && defined(__AVX__)
+#include <immintrin.h>
+#define LANES 8
+typedef __m256 _Lanes;
+#define _lanes_set(X) _mm256_set1_ps(X)
+#define _lanes_load(P) _mm256_loadu_ps(P)
+#define _lanes_store(P, X) _mm256_storeu_ps(P, X)
+#define _lanes_add(A, B) _mm256_add_ps(A, B)
+#define _lanes_sub(A, B) _mm256_sub_ps(A, B)
+#define _lanes_mul(A, B) _mm256_mul_ps(A, B)
+#define _lanes_div(A, B) _mm256_div_ps(A, B)
+#define _lanes_sqrt(A) _mm256_sqrt_ps(A)
+#define _lanes_abs(A) _mm256_andnot_ps(_mm256_set1_ps(-0.0f), A)
+#define _lanes_min(A, B) _mm256_min_ps(A, B)
+#define _lanes_max(A, B) _mm256_max_ps(A, B)
+#elif REAL_PRECISION == 32 && defined(__SSE__)
+#include <xmmintrin.h>
+#define LANES 4
+typedef __m128 _Lanes;
+#define _lanes_set(X) _mm_set1_ps(X)
+#define _lanes_load(P) _mm_loadu_ps(P)
+#define _lanes_store(P, X) _mm_storeu_ps(P, X)
+#define _lanes_add(A, B) _mm_add_ps(A, B)
+#define _lanes_sub(A, B) _mm_sub_ps(A, B)
+#define _lanes_mul(A, B) _mm_mul_ps(A, B)
+#define _lanes_div(A, B) _mm_div_ps(A, B)
+#define _lanes_sqrt(A) _mm_sqrt_ps(A)
+#define _lanes_abs(A) _mm_andnot_ps(_mm_set1_ps(-0.0f), A)
+#define _lanes_min(A, B) _mm_min_ps(A, B)
+#define _lanes_max(A, B) _mm_max_ps(A, B)
+#else
+#define LANES 1
+#endif
+
+#endif // physics_local_h_INCLUDED
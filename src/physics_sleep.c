@@ -0,0 +1,243 @@
+#include "physics.h"
+
+#include "configuration.h"
+#include "vector.h"
+#include "sort.h"
+
+#define SOURCE_NAMESPACE core.physics
+
+static CONFIGURATION_BOOLEAN(SOURCE_NAMESPACE, sleeping, true);
+
+// a body slower than this, in linear and angular velocity, counts as resting
+static CONFIGURATION_REAL(SOURCE_NAMESPACE, sleep_velocity, 0.05f);
+
+// seconds a whole island has to rest before it falls asleep
+static CONFIGURATION_REAL(SOURCE_NAMESPACE, sleep_time, 0.5f);
+
+// ====================================================================================================================
+// islands
+//
+// bodies are linked by this step's contacts. static bodies, the ones without
+// Physics2DBodyMotion, do not link, a pile resting on the ground is one island
+// per pile and not one for everything on the ground
+enum {
+  _BODY_SLEEPING = 1 << 0,
+  _BODY_RESTED = 1 << 1,
+
+  // on the root of an island that has a moving body
+  _BODY_ISLAND_AWAKE = 1 << 2,
+};
+
+typedef struct {
+  ecs_EntityHandle entity;
+  uint32_t parent;
+  uint32_t flags;
+} _Body;
+
+static struct {
+  Vector(_Body) bodies;
+  Vector(ecs_EntityHandle) candidates;
+  Vector(ecs_EntityHandle) wake;
+} _sleep;
+
+static int _compare_body(const void * ap, const void * bp, void * ud) {
+  const _Body * a = (const _Body *)ap;
+  const _Body * b = (const _Body *)bp;
+  return a->entity < b->entity ? -1 : a->entity > b->entity;
+}
+
+static uint32_t _find(uint32_t i) {
+  _Body * bodies = _sleep.bodies.data;
+  while(bodies[i].parent != i) {
+    bodies[i].parent = bodies[bodies[i].parent].parent;
+    i = bodies[i].parent;
+  }
+  return i;
+}
+
+static void _union(uint32_t a, uint32_t b) {
+  a = _find(a);
+  b = _find(b);
+  if(a != b) {
+    _sleep.bodies.data[a > b ? a : b].parent = a > b ? b : a;
+  }
+}
+
+static _Body * _lookup(ecs_EntityHandle entity) {
+  _Body key = { .entity = entity };
+  return Vector_bsearch(&_sleep.bodies, &key, _compare_body, NULL);
+}
+
+static void _push_body(ecs_EntityHandle entity) {
+  const struct Physics2DRest * rest;
+  if(ecs_read_entity_component(entity, Physics2DRest_component(), (const void **)&rest) != ECS_SUCCESS) {
+    return;
+  }
+  const void * sleeping;
+  uint32_t flags = 0;
+  if(ecs_read_entity_component(entity, Physics2DSleeping_component(), &sleeping) == ECS_SUCCESS) {
+    flags |= _BODY_SLEEPING;
+  } else if(rest->time >= sleep_time) {
+    flags |= _BODY_RESTED;
+  }
+  Vector_space_for(&_sleep.bodies, 1);
+  *Vector_push(&_sleep.bodies) = (_Body) { .entity = entity, .flags = flags };
+}
+
+// ====================================================================================================================
+ECS_QUERY(_sleep_rest
+  , write(Physics2DRest, rest)
+  , read(Physics2DMotion, motion)
+  , exclude(Physics2DSleeping)
+  , argument(R, duration)
+  , action(
+    R v = sleep_velocity;
+    pga2d_Bivector B = motion->B;
+    if(B.e01 * B.e01 + B.e02 * B.e02 + B.e12 * B.e12 < v * v) {
+      rest->time += state->duration;
+    } else {
+      rest->time = 0;
+    }
+    if(rest->time >= sleep_time) {
+      Vector_space_for(&_sleep.candidates, 1);
+      *Vector_push(&_sleep.candidates) = entity;
+    }
+  )
+)
+
+// anything that gave a sleeping body motion or force since the last step
+ECS_QUERY(_sleep_pushed
+  , read(Physics2DMotion, motion)
+  , read(Physics2DBodyMotion, body)
+  , read(Physics2DSleeping, sleeping)
+  , modified(Physics2DMotion)
+  , modified(Physics2DBodyMotion)
+  , argument(R, unused)
+  , action(
+    (void)state;
+    (void)sleeping;
+    pga2d_Bivector B = motion->B;
+    pga2d_AntiBivector F = body->F;
+    if(B.e01 != 0 || B.e02 != 0 || B.e12 != 0 || F.e0 != 0 || F.e1 != 0 || F.e2 != 0) {
+      Vector_space_for(&_sleep.wake, 1);
+      *Vector_push(&_sleep.wake) = entity;
+    }
+  )
+)
+
+ECS_QUERY(_sleep_all
+  , read(Physics2DSleeping, sleeping)
+  , argument(R, unused)
+  , action(
+    (void)state;
+    (void)sleeping;
+    Vector_space_for(&_sleep.wake, 1);
+    *Vector_push(&_sleep.wake) = entity;
+  )
+)
+
+void physics_wake2d(ecs_EntityHandle entity) {
+  if(ecs_remove_component_from_entity(entity, Physics2DSleeping_component()) != ECS_SUCCESS) {
+    return;
+  }
+  struct Physics2DRest * rest = Physics2DRest_write(entity);
+  if(rest != NULL) {
+    rest->time = 0;
+  }
+}
+
+static void _fall_asleep(ecs_EntityHandle entity, uint64_t step) {
+  struct Physics2DMotion * motion = Physics2DMotion_write(entity);
+  struct Physics2DBodyMotion * body = Physics2DBodyMotion_write(entity);
+  memory_clear(&motion->B, sizeof(motion->B));
+  memory_clear(&body->forque, sizeof(body->forque));
+
+  ecs_add_component_to_entity(entity, Physics2DSleeping_component(), &(struct Physics2DSleeping) { .since_step = step });
+}
+
+void physics_sleep2d(R duration) {
+  _sleep.candidates.length = 0;
+  _sleep.wake.length = 0;
+  _sleep.bodies.length = 0;
+
+  if(!sleeping) {
+    // wake everything that is still asleep from before the switch
+    _sleep_all(0);
+    for(uint32_t i = 0; i < _sleep.wake.length; i++) {
+      physics_wake2d(_sleep.wake.data[i]);
+    }
+    return;
+  }
+
+  // pushed bodies wake first so they keep their island awake below
+  _sleep_pushed(0);
+  for(uint32_t i = 0; i < _sleep.wake.length; i++) {
+    physics_wake2d(_sleep.wake.data[i]);
+  }
+  _sleep.wake.length = 0;
+
+  _sleep_rest(duration);
+
+  uint32_t num_contacts;
+  const Physics2DContact * contacts = physics_contacts2d(&num_contacts);
+
+  for(uint32_t i = 0; i < num_contacts; i++) {
+    _push_body(contacts[i].a);
+    _push_body(contacts[i].b);
+  }
+
+  // unique bodies, then one set per island
+  if(_sleep.bodies.length > 1) {
+    Vector_qsort(&_sleep.bodies, _compare_body, NULL);
+  }
+  uint32_t length = 0;
+  for(uint32_t i = 0; i < _sleep.bodies.length; i++) {
+    if(length == 0 || _sleep.bodies.data[length - 1].entity != _sleep.bodies.data[i].entity) {
+      _sleep.bodies.data[length] = _sleep.bodies.data[i];
+      _sleep.bodies.data[length].parent = length;
+      length++;
+    }
+  }
+  _sleep.bodies.length = length;
+
+  for(uint32_t i = 0; i < num_contacts; i++) {
+    _Body * a = _lookup(contacts[i].a);
+    _Body * b = _lookup(contacts[i].b);
+    if(a != NULL && b != NULL) {
+      _union(a - _sleep.bodies.data, b - _sleep.bodies.data);
+    }
+  }
+
+  // an island with a moving body stays awake as a whole
+  for(uint32_t i = 0; i < length; i++) {
+    if(!(_sleep.bodies.data[i].flags & (_BODY_SLEEPING | _BODY_RESTED))) {
+      _sleep.bodies.data[_find(i)].flags |= _BODY_ISLAND_AWAKE;
+    }
+  }
+  for(uint32_t i = 0; i < length; i++) {
+    _Body * body = &_sleep.bodies.data[i];
+    if(!(_sleep.bodies.data[_find(i)].flags & _BODY_ISLAND_AWAKE)) {
+      continue;
+    }
+    if(body->flags & _BODY_SLEEPING) {
+      Vector_space_for(&_sleep.wake, 1);
+      *Vector_push(&_sleep.wake) = body->entity;
+    }
+    body->flags &= ~_BODY_RESTED;
+  }
+
+  uint64_t step = Physics2DWorld_read_resource()->steps;
+
+  for(uint32_t i = 0; i < _sleep.candidates.length; i++) {
+    ecs_EntityHandle entity = _sleep.candidates.data[i];
+    _Body * body = _lookup(entity);
+    if(body != NULL && !(body->flags & _BODY_RESTED)) {
+      continue;
+    }
+    _fall_asleep(entity, step);
+  }
+
+  for(uint32_t i = 0; i < _sleep.wake.length; i++) {
+    physics_wake2d(_sleep.wake.data[i]);
+  }
+}
@@ -0,0 +1,556 @@
+#include "physics.h"
+#include "physics_local.h"
+
+#include "transform.h"
+#include "platform.h"
+#include "configuration.h"
+#include "vector.h"
+#include "sort.h"
+
+#define SOURCE_NAMESPACE core.physics
+
+// velocity iterations over every contact per step
+static CONFIGURATION_INTEGER(SOURCE_NAMESPACE, solver_iterations, 8);
+
+// fraction of the penetration beyond solver_slop pushed out per step
+static CONFIGURATION_REAL(SOURCE_NAMESPACE, solver_bias, 0.2f);
+static CONFIGURATION_REAL(SOURCE_NAMESPACE, solver_slop, 0.005f);
+
+static CONFIGURATION_REAL(SOURCE_NAMESPACE, contact_friction, 0.3f);
+
+// start from the impulses of the previous step for contacts that persist
+static CONFIGURATION_BOOLEAN(SOURCE_NAMESPACE, warm_starting, true);
+
+// solve the rows of one color on the worker threads
+static CONFIGURATION_BOOLEAN(SOURCE_NAMESPACE, parallel_solver, true);
+
+// rows handed to one worker at a time, a multiple of LANES
+#define SOLVER_GRAIN 256
+
+// rows no color is left for go into one extra batch that is solved serially
+#define SOLVER_COLORS 64
+
+// ====================================================================================================================
+// bodies
+//
+// velocities are kept in world space as the linear velocity of the center and
+// the angular velocity, which is what the contact rows work with. a body with
+// no inverse mass and inertia is only read: static, kinematic or asleep
+typedef struct {
+  ecs_EntityHandle entity;
+  R vx, vy, w;
+  R inverse_mass, inverse_inertia;
+  R x, y;
+  R cos, sin;
+
+  // colors of the rows touching this body so far
+  uint64_t colors;
+} _Body;
+
+// one contact before it is sorted into the color batches
+typedef struct {
+  uint32_t a, b;
+  uint32_t color;
+  R nx, ny;
+  R rax, ray, rbx, rby;
+  R depth;
+  R jn, jt;
+} _Contact;
+
+typedef struct {
+  ecs_EntityHandle a, b;
+  R jn, jt;
+} _Impulse;
+
+typedef Vector(_Impulse) _Impulses;
+
+// contact rows as separate arrays, ordered by color, so lanes load straight
+// from them
+typedef struct {
+  uint32_t * a;
+  uint32_t * b;
+  R * nx;
+  R * ny;
+  R * rax;
+  R * ray;
+  R * rbx;
+  R * rby;
+  R * normal_mass;
+  R * tangent_mass;
+  R * bias;
+  R * jn;
+  R * jt;
+} _Rows;
+
+static struct {
+  Vector(_Body) bodies;
+  Vector(_Contact) contacts;
+
+  _Rows rows;
+  uint32_t capacity;
+
+  // color c holds rows [color_begin[c], color_begin[c + 1])
+  uint32_t color_begin[SOLVER_COLORS + 2];
+  uint32_t num_colors;
+
+  // impulses of the last step sorted by entity pair, for warm starting
+  _Impulses impulses;
+  _Impulses previous;
+
+  // rows of the color being solved
+  uint32_t batch;
+  R friction;
+} _solver;
+
+static int _compare_body(const void * ap, const void * bp, void * ud) {
+  const _Body * a = (const _Body *)ap;
+  const _Body * b = (const _Body *)bp;
+  return a->entity < b->entity ? -1 : a->entity > b->entity;
+}
+
+static int _compare_impulse(const void * ap, const void * bp, void * ud) {
+  const _Impulse * a = (const _Impulse *)ap;
+  const _Impulse * b = (const _Impulse *)bp;
+  if(a->a != b->a) {
+    return a->a < b->a ? -1 : 1;
+  }
+  return a->b < b->b ? -1 : a->b > b->b;
+}
+
+static void _push_body(ecs_EntityHandle entity) {
+  Vector_space_for(&_solver.bodies, 1);
+  *Vector_push(&_solver.bodies) = (_Body) { .entity = entity };
+}
+
+static uint32_t _lookup_body(ecs_EntityHandle entity) {
+  _Body key = { .entity = entity };
+  return (_Body *)Vector_bsearch(&_solver.bodies, &key, _compare_body, NULL) - _solver.bodies.data;
+}
+
+static void _load_body(_Body * body) {
+  const struct LocalToWorld2D * transform = LocalToWorld2D_read(body->entity);
+  if(transform != NULL) {
+    body->x = pga2d_point_x(transform->position);
+    body->y = pga2d_point_y(transform->position);
+    body->cos = R_cos(transform->orientation);
+    body->sin = R_sin(transform->orientation);
+  } else {
+    body->cos = 1;
+  }
+
+  // the motion is in body space, e01 and e02 move the center along the body's
+  // x and y axes and e12 turns it counter clockwise. the orientation turns the
+  // other way, the body's x axis points at (cos, -sin)
+  const struct Physics2DMotion * motion = Physics2DMotion_read(body->entity);
+  if(motion != NULL) {
+    pga2d_Bivector B = motion->B;
+    body->vx = B.e01 * body->cos + B.e02 * body->sin;
+    body->vy = B.e02 * body->cos - B.e01 * body->sin;
+    body->w = B.e12;
+  }
+
+  const struct Physics2DBodyMotion * body_motion = Physics2DBodyMotion_read(body->entity);
+  if(body_motion == NULL || Physics2DSleeping_read(body->entity) != NULL || Parent2D_read(body->entity) != NULL) {
+    return;
+  }
+
+  // e0 carries the mass, e1 and e2 the moments around the two axes, which add
+  // up to the moment around the center
+  const struct Physics2DMassProperties * properties = Physics2DMassProperties_read(body->entity);
+  if(properties == NULL) {
+    return;
+  }
+  pga2d_AntiBivector I = properties->I;
+  body->inverse_mass = I.e0 > 0 ? 1 / I.e0 : 0;
+  body->inverse_inertia = I.e1 + I.e2 > 0 ? 1 / (I.e1 + I.e2) : 0;
+}
+
+static void _store_body(const _Body * body) {
+  Physics2DMotion_write(body->entity)->B = (pga2d_Bivector) {
+    .e01 = body->vx * body->cos - body->vy * body->sin,
+    .e02 = body->vx * body->sin + body->vy * body->cos,
+    .e12 = body->w,
+  };
+}
+
+// ====================================================================================================================
+// rows
+static void _rows_reserve(uint32_t count) {
+  if(count <= _solver.capacity) {
+    return;
+  }
+  uint32_t capacity = _solver.capacity ? _solver.capacity : 256;
+  while(capacity < count) {
+    capacity *= 2;
+  }
+
+#define _ROWS_REALLOC(FIELD) \
+  _solver.rows.FIELD = memory_realloc(_solver.rows.FIELD, sizeof(*_solver.rows.FIELD) * _solver.capacity, sizeof(*_solver.rows.FIELD) * capacity, alignof(R));
+  _ROWS_REALLOC(a)
+  _ROWS_REALLOC(b)
+  _ROWS_REALLOC(nx)
+  _ROWS_REALLOC(ny)
+  _ROWS_REALLOC(rax)
+  _ROWS_REALLOC(ray)
+  _ROWS_REALLOC(rbx)
+  _ROWS_REALLOC(rby)
+  _ROWS_REALLOC(normal_mass)
+  _ROWS_REALLOC(tangent_mass)
+  _ROWS_REALLOC(bias)
+  _ROWS_REALLOC(jn)
+  _ROWS_REALLOC(jt)
+#undef _ROWS_REALLOC
+
+  _solver.capacity = capacity;
+}
+
+// greedy coloring, a row takes the first color neither of its movable bodies
+// has yet. rows of one color share no movable body and can run in any order
+static uint32_t _color(_Contact * contact) {
+  _Body * a = &_solver.bodies.data[contact->a];
+  _Body * b = &_solver.bodies.data[contact->b];
+  bool a_moves = a->inverse_mass > 0 || a->inverse_inertia > 0;
+  bool b_moves = b->inverse_mass > 0 || b->inverse_inertia > 0;
+
+  uint64_t used = (a_moves ? a->colors : 0) | (b_moves ? b->colors : 0);
+  if(used == ~(uint64_t)0) {
+    return SOLVER_COLORS;
+  }
+  uint32_t color = __builtin_ctzll(~used);
+  if(a_moves) {
+    a->colors |= (uint64_t)1 << color;
+  }
+  if(b_moves) {
+    b->colors |= (uint64_t)1 << color;
+  }
+  return color;
+}
+
+static void _build_rows(R duration) {
+  uint32_t count = _solver.contacts.length;
+  _rows_reserve(count);
+
+  uint32_t histogram[SOLVER_COLORS + 1] = { 0 };
+  for(uint32_t i = 0; i < count; i++) {
+    _Contact * contact = &_solver.contacts.data[i];
+    contact->color = _color(contact);
+    histogram[contact->color]++;
+  }
+
+  _solver.num_colors = 0;
+  uint32_t begin = 0;
+  for(uint32_t c = 0; c <= SOLVER_COLORS; c++) {
+    _solver.color_begin[c] = begin;
+    begin += histogram[c];
+    if(histogram[c] > 0) {
+      _solver.num_colors = c + 1;
+    }
+  }
+  _solver.color_begin[SOLVER_COLORS + 1] = begin;
+
+  R bias = solver_bias / duration;
+  _Rows * rows = &_solver.rows;
+  for(uint32_t i = 0; i < count; i++) {
+    const _Contact * contact = &_solver.contacts.data[i];
+    uint32_t r = _solver.color_begin[contact->color] + --histogram[contact->color];
+    const _Body * a = &_solver.bodies.data[contact->a];
+    const _Body * b = &_solver.bodies.data[contact->b];
+
+    R nx = contact->nx, ny = contact->ny;
+    R tx = -ny, ty = nx;
+    R ran = contact->rax * ny - contact->ray * nx;
+    R rbn = contact->rbx * ny - contact->rby * nx;
+    R rat = contact->rax * ty - contact->ray * tx;
+    R rbt = contact->rbx * ty - contact->rby * tx;
+    R k_normal = a->inverse_mass + b->inverse_mass + a->inverse_inertia * ran * ran + b->inverse_inertia * rbn * rbn;
+    R k_tangent = a->inverse_mass + b->inverse_mass + a->inverse_inertia * rat * rat + b->inverse_inertia * rbt * rbt;
+
+    rows->a[r] = contact->a;
+    rows->b[r] = contact->b;
+    rows->nx[r] = nx;
+    rows->ny[r] = ny;
+    rows->rax[r] = contact->rax;
+    rows->ray[r] = contact->ray;
+    rows->rbx[r] = contact->rbx;
+    rows->rby[r] = contact->rby;
+    rows->normal_mass[r] = k_normal > 0 ? 1 / k_normal : 0;
+    rows->tangent_mass[r] = k_tangent > 0 ? 1 / k_tangent : 0;
+    rows->bias[r] = -bias * (contact->depth > solver_slop ? contact->depth - solver_slop : 0);
+    rows->jn[r] = contact->jn;
+    rows->jt[r] = contact->jt;
+  }
+}
+
+// adds the impulse (px, py) at b and its opposite at a. bodies that do not move
+// can be shared by rows on other workers and are not written
+static inline void _apply(_Body * a, _Body * b, R rax, R ray, R rbx, R rby, R px, R py) {
+  if(a->inverse_mass > 0 || a->inverse_inertia > 0) {
+    a->vx -= a->inverse_mass * px;
+    a->vy -= a->inverse_mass * py;
+    a->w -= a->inverse_inertia * (rax * py - ray * px);
+  }
+  if(b->inverse_mass > 0 || b->inverse_inertia > 0) {
+    b->vx += b->inverse_mass * px;
+    b->vy += b->inverse_mass * py;
+    b->w += b->inverse_inertia * (rbx * py - rby * px);
+  }
+}
+
+static void _warm_start(void) {
+  const _Rows * rows = &_solver.rows;
+  for(uint32_t r = 0, n = _solver.contacts.length; r < n; r++) {
+    R px = rows->jn[r] * rows->nx[r] - rows->jt[r] * rows->ny[r];
+    R py = rows->jn[r] * rows->ny[r] + rows->jt[r] * rows->nx[r];
+    _apply(&_solver.bodies.data[rows->a[r]], &_solver.bodies.data[rows->b[r]], rows->rax[r], rows->ray[r], rows->rbx[r], rows->rby[r], px, py);
+  }
+}
+
+// ====================================================================================================================
+// solver
+static inline void _solve_row(uint32_t r) {
+  _Rows * rows = &_solver.rows;
+  _Body * a = &_solver.bodies.data[rows->a[r]];
+  _Body * b = &_solver.bodies.data[rows->b[r]];
+  R nx = rows->nx[r], ny = rows->ny[r];
+  R rax = rows->rax[r], ray = rows->ray[r], rbx = rows->rbx[r], rby = rows->rby[r];
+
+  // relative velocity of the contact point
+  R dvx = (b->vx - b->w * rby) - (a->vx - a->w * ray);
+  R dvy = (b->vy + b->w * rbx) - (a->vy + a->w * rax);
+
+  R jt = rows->jt[r];
+  R limit = _solver.friction * rows->jn[r];
+  R dt = -rows->tangent_mass[r] * (dvx * -ny + dvy * nx);
+  R jt_new = R_max(-limit, R_min(jt + dt, limit));
+  dt = jt_new - jt;
+  rows->jt[r] = jt_new;
+
+  R jn = rows->jn[r];
+  R dn = -rows->normal_mass[r] * (dvx * nx + dvy * ny + rows->bias[r]);
+  R jn_new = R_max(jn + dn, 0);
+  dn = jn_new - jn;
+  rows->jn[r] = jn_new;
+
+  _apply(a, b, rax, ray, rbx, rby, dn * nx - dt * ny, dn * ny + dt * nx);
+}
+
+// rows of one color touch distinct bodies, so the lanes gather, solve and
+// scatter without stepping on each other
+static void _solve_rows(void * user_data, uint32_t worker, uint32_t begin, uint32_t end) {
+  (void)user_data;
+  (void)worker;
+  begin += _solver.batch;
+  end += _solver.batch;
+
+  uint32_t r = begin;
+#if LANES > 1
+  _Rows * rows = &_solver.rows;
+  _Body * bodies = _solver.bodies.data;
+  _Lanes zero = _lanes_set(0);
+  _Lanes friction = _lanes_set(_solver.friction);
+  for(; r + LANES <= end; r += LANES) {
+    float v[6][LANES], m[4][LANES];
+    for(uint32_t l = 0; l < LANES; l++) {
+      const _Body * a = &bodies[rows->a[r + l]];
+      const _Body * b = &bodies[rows->b[r + l]];
+      v[0][l] = a->vx;
+      v[1][l] = a->vy;
+      v[2][l] = a->w;
+      v[3][l] = b->vx;
+      v[4][l] = b->vy;
+      v[5][l] = b->w;
+      m[0][l] = a->inverse_mass;
+      m[1][l] = a->inverse_inertia;
+      m[2][l] = b->inverse_mass;
+      m[3][l] = b->inverse_inertia;
+    }
+    _Lanes avx = _lanes_load(v[0]), avy = _lanes_load(v[1]), aw = _lanes_load(v[2]);
+    _Lanes bvx = _lanes_load(v[3]), bvy = _lanes_load(v[4]), bw = _lanes_load(v[5]);
+    _Lanes nx = _lanes_load(rows->nx + r), ny = _lanes_load(rows->ny + r);
+    _Lanes rax = _lanes_load(rows->rax + r), ray = _lanes_load(rows->ray + r);
+    _Lanes rbx = _lanes_load(rows->rbx + r), rby = _lanes_load(rows->rby + r);
+
+    _Lanes dvx = _lanes_sub(_lanes_sub(bvx, _lanes_mul(bw, rby)), _lanes_sub(avx, _lanes_mul(aw, ray)));
+    _Lanes dvy = _lanes_sub(_lanes_add(bvy, _lanes_mul(bw, rbx)), _lanes_add(avy, _lanes_mul(aw, rax)));
+
+    _Lanes jt = _lanes_load(rows->jt + r);
+    _Lanes limit = _lanes_mul(friction, _lanes_load(rows->jn + r));
+    _Lanes vt = _lanes_sub(_lanes_mul(dvy, nx), _lanes_mul(dvx, ny));
+    _Lanes jt_new = _lanes_sub(jt, _lanes_mul(_lanes_load(rows->tangent_mass + r), vt));
+    jt_new = _lanes_max(_lanes_sub(zero, limit), _lanes_min(jt_new, limit));
+    _Lanes dt = _lanes_sub(jt_new, jt);
+    _lanes_store(rows->jt + r, jt_new);
+
+    _Lanes jn = _lanes_load(rows->jn + r);
+    _Lanes vn = _lanes_add(_lanes_add(_lanes_mul(dvx, nx), _lanes_mul(dvy, ny)), _lanes_load(rows->bias + r));
+    _Lanes jn_new = _lanes_max(_lanes_sub(jn, _lanes_mul(_lanes_load(rows->normal_mass + r), vn)), zero);
+    _Lanes dn = _lanes_sub(jn_new, jn);
+    _lanes_store(rows->jn + r, jn_new);
+
+    _Lanes px = _lanes_sub(_lanes_mul(dn, nx), _lanes_mul(dt, ny));
+    _Lanes py = _lanes_add(_lanes_mul(dn, ny), _lanes_mul(dt, nx));
+    _Lanes am = _lanes_load(m[0]), ai = _lanes_load(m[1]), bm = _lanes_load(m[2]), bi = _lanes_load(m[3]);
+
+    _lanes_store(v[0], _lanes_sub(avx, _lanes_mul(am, px)));
+    _lanes_store(v[1], _lanes_sub(avy, _lanes_mul(am, py)));
+    _lanes_store(v[2], _lanes_sub(aw, _lanes_mul(ai, _lanes_sub(_lanes_mul(rax, py), _lanes_mul(ray, px)))));
+    _lanes_store(v[3], _lanes_add(bvx, _lanes_mul(bm, px)));
+    _lanes_store(v[4], _lanes_add(bvy, _lanes_mul(bm, py)));
+    _lanes_store(v[5], _lanes_add(bw, _lanes_mul(bi, _lanes_sub(_lanes_mul(rbx, py), _lanes_mul(rby, px)))));
+
+    // same as _apply, bodies that do not move are left alone
+    for(uint32_t l = 0; l < LANES; l++) {
+      _Body * a = &bodies[rows->a[r + l]];
+      _Body * b = &bodies[rows->b[r + l]];
+      if(m[0][l] > 0 || m[1][l] > 0) {
+        a->vx = v[0][l];
+        a->vy = v[1][l];
+        a->w = v[2][l];
+      }
+      if(m[2][l] > 0 || m[3][l] > 0) {
+        b->vx = v[3][l];
+        b->vy = v[4][l];
+        b->w = v[5][l];
+      }
+    }
+  }
+#endif
+  for(; r < end; r++) {
+    _solve_row(r);
+  }
+}
+
+static void _solve_color(uint32_t color) {
+  uint32_t begin = _solver.color_begin[color];
+  uint32_t count = _solver.color_begin[color + 1] - begin;
+  _solver.batch = begin;
+
+  // the overflow batch may share bodies between rows
+  if(parallel_solver && color < SOLVER_COLORS) {
+    platform_parallel_for(count, SOLVER_GRAIN, _solve_rows, NULL);
+  } else {
+    for(uint32_t r = begin; r < begin + count; r++) {
+      _solve_row(r);
+    }
+  }
+}
+
+// ====================================================================================================================
+static void _gather_contacts(const Physics2DContact * contacts, uint32_t num_contacts) {
+  _solver.bodies.length = 0;
+  _solver.contacts.length = 0;
+
+  for(uint32_t i = 0; i < num_contacts; i++) {
+    _push_body(contacts[i].a);
+    _push_body(contacts[i].b);
+  }
+  if(_solver.bodies.length > 1) {
+    Vector_qsort(&_solver.bodies, _compare_body, NULL);
+  }
+  uint32_t length = 0;
+  for(uint32_t i = 0; i < _solver.bodies.length; i++) {
+    if(length == 0 || _solver.bodies.data[length - 1].entity != _solver.bodies.data[i].entity) {
+      _solver.bodies.data[length++] = _solver.bodies.data[i];
+    }
+  }
+  _solver.bodies.length = length;
+
+  for(uint32_t i = 0; i < length; i++) {
+    _load_body(&_solver.bodies.data[i]);
+  }
+
+  for(uint32_t i = 0; i < num_contacts; i++) {
+    const Physics2DContact * contact = &contacts[i];
+    uint32_t a = _lookup_body(contact->a);
+    uint32_t b = _lookup_body(contact->b);
+    const _Body * body_a = &_solver.bodies.data[a];
+    const _Body * body_b = &_solver.bodies.data[b];
+    if(body_a->inverse_mass + body_a->inverse_inertia + body_b->inverse_mass + body_b->inverse_inertia <= 0) {
+      continue;
+    }
+
+    R px = pga2d_point_x(contact->point), py = pga2d_point_y(contact->point);
+    _Contact row = {
+      .a = a,
+      .b = b,
+      .nx = pga2d_direction_x(contact->normal),
+      .ny = pga2d_direction_y(contact->normal),
+      .rax = px - body_a->x,
+      .ray = py - body_a->y,
+      .rbx = px - body_b->x,
+      .rby = py - body_b->y,
+      .depth = contact->depth,
+    };
+
+    // the pair can come out of the broadphase either way around. the normal and
+    // the tangent flip with it and so does the impulse on b, which leaves both
+    // impulses as they were
+    if(warm_starting && _solver.previous.length > 0) {
+      bool swap = contact->a > contact->b;
+      _Impulse key = { .a = swap ? contact->b : contact->a, .b = swap ? contact->a : contact->b };
+      const _Impulse * found = Vector_bsearch(&_solver.previous, &key, _compare_impulse, NULL);
+      if(found != NULL) {
+        row.jn = found->jn;
+        row.jt = found->jt;
+      }
+    }
+
+    Vector_space_for(&_solver.contacts, 1);
+    *Vector_push(&_solver.contacts) = row;
+  }
+}
+
+static void _store_impulses(void) {
+  _solver.impulses.length = 0;
+  const _Rows * rows = &_solver.rows;
+  for(uint32_t r = 0, n = _solver.contacts.length; r < n; r++) {
+    ecs_EntityHandle a = _solver.bodies.data[rows->a[r]].entity;
+    ecs_EntityHandle b = _solver.bodies.data[rows->b[r]].entity;
+    bool swap = a > b;
+    Vector_space_for(&_solver.impulses, 1);
+    *Vector_push(&_solver.impulses) = (_Impulse) {
+      .a = swap ? b : a,
+      .b = swap ? a : b,
+      .jn = rows->jn[r],
+      .jt = rows->jt[r],
+    };
+  }
+  if(_solver.impulses.length > 1) {
+    Vector_qsort(&_solver.impulses, _compare_impulse, NULL);
+  }
+
+  _Impulses swap = _solver.previous;
+  _solver.previous = _solver.impulses;
+  _solver.impulses = swap;
+}
+
+void physics_solve2d(R duration) {
+  uint32_t num_contacts;
+  const Physics2DContact * contacts = physics_contacts2d(&num_contacts);
+
+  _gather_contacts(contacts, num_contacts);
+  _build_rows(duration);
+  _solver.friction = contact_friction;
+
+  if(warm_starting) {
+    _warm_start();
+  }
+  for(int32_t i = 0; i < solver_iterations; i++) {
+    for(uint32_t c = 0; c < _solver.num_colors; c++) {
+      _solve_color(c);
+    }
+  }
+
+  for(uint32_t i = 0; i < _solver.bodies.length; i++) {
+    const _Body * body = &_solver.bodies.data[i];
+    if(body->inverse_mass > 0 || body->inverse_inertia > 0) {
+      _store_body(body);
+    }
+  }
+
+  _store_impulses();
+
+  struct Physics2DWorld * world = Physics2DWorld_write_resource();
+  world->solver_rows = _solver.contacts.length;
+  world->solver_colors = _solver.num_colors;
+}
@@ -3,6 +3,7 @@
 #include "format.h"
 
 #include <stdarg.h>
+#include <stdatomic.h>
 
 #include <uv.h>
 
@@ -14,6 +15,9 @@ static uv_loop_t _loop;
 
 static CONFIGURATION_INTEGER(SOURCE_NAMESPACE.libuv, threadpool_size, 8); 
 
+// 0 uses one thread per available core, the main thread included
+static CONFIGURATION_INTEGER(SOURCE_NAMESPACE, worker_threads, 0);
+
 void platform_initialize_arguments(int argc, char ** argv) {
   _argc = argc;
   _argv = uv_setup_args(argc, argv);
@@ -81,6 +85,131 @@ void platform_schedule_interval(bool (*f)(void), uint64_t milliseconds) {
   uv_timer_start(timer, _schedule_interval_cb, 0, milliseconds);
 }
 
+uint64_t platform_time_nanoseconds(void) {
+  return uv_hrtime();
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+static struct {
+  bool started;
+  uv_mutex_t mutex;
+  uv_cond_t start;
+  uv_cond_t done;
+  uint32_t num_threads;
+  uv_thread_t * threads;
+
+  // current job, generation changes once per platform_parallel_for
+  uint64_t generation;
+  uint32_t busy;
+  platform_ParallelFunction f;
+  void * user_data;
+  uint32_t count;
+  uint32_t grain;
+  _Atomic uint32_t next;
+} _workers;
+
+static void _parallel_run(uint32_t worker) {
+  for(;;) {
+    uint32_t begin = atomic_fetch_add_explicit(&_workers.next, _workers.grain, memory_order_relaxed);
+    if(begin >= _workers.count) {
+      break;
+    }
+    uint32_t end = _workers.count - begin < _workers.grain ? _workers.count : begin + _workers.grain;
+    _workers.f(_workers.user_data, worker, begin, end);
+  }
+}
+
+static void _worker_main(void * arg) {
+  uint32_t worker = (uint32_t)(uintptr_t)arg;
+  uint64_t seen = 0;
+
+  uv_mutex_lock(&_workers.mutex);
+  for(;;) {
+    while(_workers.generation == seen) {
+      uv_cond_wait(&_workers.start, &_workers.mutex);
+    }
+    seen = _workers.generation;
+    uv_mutex_unlock(&_workers.mutex);
+
+    _parallel_run(worker);
+
+    uv_mutex_lock(&_workers.mutex);
+    if(--_workers.busy == 0) {
+      uv_cond_signal(&_workers.done);
+    }
+  }
+}
+
+static void _workers_start(void) {
+  _workers.started = true;
+
+  int64_t count = worker_threads;
+  if(count <= 0) {
+    count = uv_available_parallelism();
+  }
+  _workers.num_threads = count > 1 ? count - 1 : 0;
+
+  uv_mutex_init(&_workers.mutex);
+  uv_cond_init(&_workers.start);
+  uv_cond_init(&_workers.done);
+
+  if(_workers.num_threads > 0) {
+    _workers.threads = memory_alloc(sizeof(uv_thread_t) * _workers.num_threads, alignof(uv_thread_t));
+  }
+  for(uint32_t i = 0; i < _workers.num_threads; i++) {
+    uv_thread_create(&_workers.threads[i], _worker_main, (void *)(uintptr_t)i);
+  }
+}
+
+uint32_t platform_worker_count(void) {
+  if(!_workers.started) {
+    _workers_start();
+  }
+  return _workers.num_threads + 1;
+}
+
+void platform_parallel_for(uint32_t count, uint32_t grain, platform_ParallelFunction f, void * user_data) {
+  if(count == 0) {
+    return;
+  }
+  if(grain == 0) {
+    grain = 1;
+  }
+  if(!_workers.started) {
+    _workers_start();
+  }
+
+  // the main thread is the last worker
+  uint32_t main_worker = _workers.num_threads;
+
+  if(count <= grain || _workers.num_threads == 0) {
+    for(uint32_t begin = 0; begin < count; begin += grain) {
+      f(user_data, main_worker, begin, count - begin < grain ? count : begin + grain);
+    }
+    return;
+  }
+
+  uv_mutex_lock(&_workers.mutex);
+  _workers.f = f;
+  _workers.user_data = user_data;
+  _workers.count = count;
+  _workers.grain = grain;
+  atomic_store_explicit(&_workers.next, 0, memory_order_relaxed);
+  _workers.busy = _workers.num_threads;
+  _workers.generation++;
+  uv_cond_broadcast(&_workers.start);
+  uv_mutex_unlock(&_workers.mutex);
+
+  _parallel_run(main_worker);
+
+  uv_mutex_lock(&_workers.mutex);
+  while(_workers.busy > 0) {
+    uv_cond_wait(&_workers.done, &_workers.mutex);
+  }
+  uv_mutex_unlock(&_workers.mutex);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
 struct platform_File {
   uv_fs_t req;
   uv_file file;
@@ -232,3 +361,25 @@ bool platform_File_close_synchronous(struct platform_File * file) {
   return uv_fs_close(&_loop, &file->req, file->file, NULL) >= 0;
 }
 
+// ---------------------------------------------------------------------------------------------------------------------
+static bool _make_directory(const char * path) {
+  uv_fs_t req;
+  int result = uv_fs_mkdir(&_loop, &req, path, 0750, NULL);
+  uv_fs_req_cleanup(&req);
+  return result >= 0 || result == UV_EEXIST;
+}
+
+bool platform_make_directory_synchronous(const char * path) {
+  char partial[1024];
+  size_t length = 0;
+  for(; path[length] != 0 && length + 1 < sizeof(partial); length++) {
+    if(path[length] == '/' && length > 0) {
+      partial[length] = 0;
+      _make_directory(partial);
+    }
+    partial[length] = path[length];
+  }
+  partial[length] = 0;
+  return path[length] == 0 && _make_directory(partial);
+}
+
@@ -19,6 +19,18 @@ void platform_run(void);
 void platform_schedule(void (*f)(void));
 void platform_schedule_interval(bool (*f)(void), uint64_t milliseconds);
 
+// monotonic clock for timing, not related to the wall clock
+uint64_t platform_time_nanoseconds(void);
+
+// worker is in [0, platform_worker_count()) and can index per thread scratch
+// data. the calling thread takes part in the work. not reentrant, only call
+// from the main thread
+typedef void (*platform_ParallelFunction)(void * user_data, uint32_t worker, uint32_t begin, uint32_t end);
+
+uint32_t platform_worker_count(void);
+
+void platform_parallel_for(uint32_t count, uint32_t grain, platform_ParallelFunction f, void * user_data);
+
 struct platform_File;
 size_t platform_File_size(void);
 
@@ -43,5 +55,8 @@ bool platform_File_read_synchronous(struct platform_File * file, int64_t offset,
 void platform_File_close(struct platform_File * file, void (* result)(struct platform_File *, bool));
 bool platform_File_close_synchronous(struct platform_File * file);
 
+// makes the missing parents too, true when the directory exists after
+bool platform_make_directory_synchronous(const char * path);
+
 void platform_file_exists(const char * path, void (* result)(bool));
 bool platform_file_exists_synchronous(const char * path);
@@ -0,0 +1,355 @@
+#include "profile.h"
+
+#include "gl.h"
+#include "configuration.h"
+#include "platform.h"
+#include "format.h"
+#include "log.h"
+#include "math.h"
+#include "string.h"
+#include "vector.h"
+
+#include <stdarg.h>
+
+#define SOURCE_NAMESPACE core.profile
+
+static CONFIGURATION_BOOLEAN(SOURCE_NAMESPACE, enabled, false);
+
+// frames per window of profile_stats
+static CONFIGURATION_INTEGER(SOURCE_NAMESPACE, window, 300);
+
+// log every window's stats
+static CONFIGURATION_BOOLEAN(SOURCE_NAMESPACE, report, true);
+
+// every resolved scope goes to this file as chrome trace events, the cpu on one
+// track and the gpu on another
+static CONFIGURATION_STRING(SOURCE_NAMESPACE, trace_path, NULL);
+
+#define PROFILE_NO_QUERY UINT32_MAX
+
+typedef struct {
+  const char * name;
+  uint64_t cpu_begin, cpu_end;
+
+  // of two timestamps in the frame's queries, the begin and the end
+  uint32_t query;
+} _Scope;
+
+typedef struct {
+  bool recorded;
+
+  // cpu minus gpu clock, taken when the frame began
+  int64_t gpu_offset;
+
+  Vector(_Scope) scopes;
+  Vector(GLuint) queries;
+  uint32_t num_queries;
+} _Frame;
+
+typedef struct {
+  const char * name;
+  bool gpu;
+
+  // the frame being resolved
+  uint32_t frame_calls;
+  uint64_t frame_cpu, frame_gpu;
+
+  uint32_t frames, calls;
+  uint64_t cpu_min, cpu_max, cpu_total;
+  uint64_t gpu_min, gpu_max, gpu_total;
+} _Accumulator;
+
+static struct {
+  bool active;
+  uint64_t number;
+  _Frame frames[PROFILE_FRAMES];
+  Vector(uint32_t) open;
+
+  uint32_t window_frames;
+  Vector(_Accumulator) accumulators;
+  Vector(struct profile_Stats) stats;
+
+  struct platform_File * trace;
+  bool trace_failed;
+  uint64_t trace_offset;
+  uint64_t trace_origin;
+  Vector(char) trace_buffer;
+} _profile;
+
+static _Thread_local bool _owner;
+
+static inline _Frame * _current(void) {
+  return &_profile.frames[_profile.number % PROFILE_FRAMES];
+}
+
+// ====================================================================================================================
+// scopes
+static _Scope * _begin(const char * name) {
+  if(!_owner || !_profile.active) {
+    return NULL;
+  }
+  _Frame * frame = _current();
+  Vector_space_for(&_profile.open, 1);
+  *Vector_push(&_profile.open) = frame->scopes.length;
+  Vector_space_for(&frame->scopes, 1);
+  _Scope * scope = Vector_push(&frame->scopes);
+  *scope = (_Scope) { .name = name, .query = PROFILE_NO_QUERY, .cpu_begin = platform_time_nanoseconds() };
+  return scope;
+}
+
+void profile_begin(const char * name) {
+  _begin(name);
+}
+
+void profile_begin_gl(const char * name) {
+  _Scope * scope = _begin(name);
+  if(scope == NULL) {
+    return;
+  }
+  _Frame * frame = _current();
+  if(frame->num_queries + 2 > frame->queries.length) {
+    Vector_set_capacity(&frame->queries, frame->num_queries + 2);
+    glGenQueries(frame->num_queries + 2 - frame->queries.length, frame->queries.data + frame->queries.length);
+    frame->queries.length = frame->num_queries + 2;
+  }
+  scope->query = frame->num_queries;
+  frame->num_queries += 2;
+  glQueryCounter(frame->queries.data[scope->query], GL_TIMESTAMP);
+}
+
+void profile_end(void) {
+  if(!_owner || !_profile.active || _profile.open.length == 0) {
+    return;
+  }
+  _Frame * frame = _current();
+  _Scope * scope = &frame->scopes.data[*Vector_pop(&_profile.open)];
+  if(scope->query != PROFILE_NO_QUERY) {
+    glQueryCounter(frame->queries.data[scope->query + 1], GL_TIMESTAMP);
+  }
+  scope->cpu_end = platform_time_nanoseconds();
+}
+
+// ====================================================================================================================
+// trace
+static void _trace(const char * format, ...) {
+  va_list ap;
+  va_start(ap, format);
+  int length = format_count_v(format, ap);
+  va_end(ap);
+
+  Vector_space_for(&_profile.trace_buffer, length + 1);
+  va_start(ap, format);
+  format_string_v(_profile.trace_buffer.data + _profile.trace_buffer.length, length + 1, format, ap);
+  va_end(ap);
+  _profile.trace_buffer.length += length;
+}
+
+static void _trace_flush(void) {
+  uint64_t written;
+  if(!platform_File_write_synchronous(_profile.trace, _profile.trace_offset, _profile.trace_buffer.data,
+                                      _profile.trace_buffer.length, &written)) {
+    ERROR(SOURCE_NAMESPACE, "trace write failed, tracing stops");
+    _profile.trace_buffer.length = 0;
+    _profile.trace_failed = true;
+    profile_shutdown();
+    return;
+  }
+  _profile.trace_offset += written;
+  _profile.trace_buffer.length = 0;
+}
+
+// the json array form, events are led by a comma so the file loads even when
+// the closing bracket was never written
+static void _trace_open(uint64_t now) {
+  _profile.trace = memory_alloc(platform_File_size(), 8);
+  if(!platform_File_open_synchronous(_profile.trace, (const char *)trace_path, platform_File_CREATE | platform_File_WRITE | platform_File_TRUNCATE)) {
+    ERROR(SOURCE_NAMESPACE, "could not open %s for the trace", (const char *)trace_path);
+    memory_free(_profile.trace, platform_File_size(), 8);
+    _profile.trace = NULL;
+    _profile.trace_failed = true;
+    return;
+  }
+  _profile.trace_offset = 0;
+  _profile.trace_origin = now;
+  _trace("[\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"cpu\"}}");
+  _trace(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"gpu\"}}");
+  _trace_flush();
+}
+
+// microseconds with the nanoseconds after the point, printed as integers
+static void _trace_event(const char * name, uint32_t track, uint64_t begin, uint64_t duration) {
+  uint64_t ts = begin > _profile.trace_origin ? begin - _profile.trace_origin : 0;
+  _trace(",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%llu.%03u,\"dur\":%llu.%03u}", name, track,
+         (unsigned long long)(ts / 1000), (uint32_t)(ts % 1000), (unsigned long long)(duration / 1000), (uint32_t)(duration % 1000));
+}
+
+// ====================================================================================================================
+// results
+static _Accumulator * _accumulator(const char * name) {
+  for(uint32_t i = 0; i < _profile.accumulators.length; i++) {
+    _Accumulator * accumulator = &_profile.accumulators.data[i];
+    if(accumulator->name == name || string_equals(accumulator->name, name)) {
+      return accumulator;
+    }
+  }
+  Vector_space_for(&_profile.accumulators, 1);
+  _Accumulator * accumulator = Vector_push(&_profile.accumulators);
+  *accumulator = (_Accumulator) { .name = name, .cpu_min = UINT64_MAX, .gpu_min = UINT64_MAX };
+  return accumulator;
+}
+
+static void _publish(void) {
+  _profile.stats.length = 0;
+  Vector_space_for(&_profile.stats, _profile.accumulators.length);
+  for(uint32_t i = 0; i < _profile.accumulators.length; i++) {
+    _Accumulator * accumulator = &_profile.accumulators.data[i];
+    if(accumulator->frames == 0) {
+      continue;
+    }
+    struct profile_Stats * stats = Vector_push(&_profile.stats);
+    *stats = (struct profile_Stats) {
+        .name = accumulator->name
+      , .frames = accumulator->frames
+      , .calls = accumulator->calls
+      , .cpu_min = accumulator->cpu_min
+      , .cpu_avg = accumulator->cpu_total / accumulator->frames
+      , .cpu_max = accumulator->cpu_max
+      };
+    if(accumulator->gpu) {
+      stats->gpu_min = accumulator->gpu_min;
+      stats->gpu_avg = accumulator->gpu_total / accumulator->frames;
+      stats->gpu_max = accumulator->gpu_max;
+    }
+
+    // whole microseconds, format gets %f wrong for the small values most scopes take
+    if(report) {
+      INFO(SOURCE_NAMESPACE, "%s: cpu %llu/%llu/%llu us, gpu %llu/%llu/%llu us, %u calls in %u frames", stats->name,
+           (unsigned long long)(stats->cpu_min / 1000), (unsigned long long)(stats->cpu_avg / 1000),
+           (unsigned long long)(stats->cpu_max / 1000), (unsigned long long)(stats->gpu_min / 1000),
+           (unsigned long long)(stats->gpu_avg / 1000), (unsigned long long)(stats->gpu_max / 1000), stats->calls,
+           stats->frames);
+    }
+
+    *accumulator = (_Accumulator) { .name = accumulator->name, .cpu_min = UINT64_MAX, .gpu_min = UINT64_MAX };
+  }
+  _profile.window_frames = 0;
+}
+
+// PROFILE_FRAMES frames after it was recorded, the queries are as good as done
+// and reading them does not wait on the GPU
+static void _resolve(_Frame * frame) {
+  for(uint32_t i = 0; i < _profile.accumulators.length; i++) {
+    _Accumulator * accumulator = &_profile.accumulators.data[i];
+    accumulator->frame_calls = 0;
+    accumulator->frame_cpu = 0;
+    accumulator->frame_gpu = 0;
+  }
+
+  for(uint32_t i = 0; i < frame->scopes.length; i++) {
+    const _Scope * scope = &frame->scopes.data[i];
+    _Accumulator * accumulator = _accumulator(scope->name);
+    uint64_t cpu = scope->cpu_end - scope->cpu_begin;
+    accumulator->frame_calls++;
+    accumulator->frame_cpu += cpu;
+    if(_profile.trace != NULL) {
+      _trace_event(scope->name, 0, scope->cpu_begin, cpu);
+    }
+
+    if(scope->query == PROFILE_NO_QUERY) {
+      continue;
+    }
+    GLuint64 begin, end;
+    glGetQueryObjectui64v(frame->queries.data[scope->query], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(frame->queries.data[scope->query + 1], GL_QUERY_RESULT, &end);
+    accumulator->gpu = true;
+    accumulator->frame_gpu += end - begin;
+    if(_profile.trace != NULL) {
+      _trace_event(scope->name, 1, (uint64_t)((int64_t)begin + frame->gpu_offset), end - begin);
+    }
+  }
+
+  for(uint32_t i = 0; i < _profile.accumulators.length; i++) {
+    _Accumulator * accumulator = &_profile.accumulators.data[i];
+    if(accumulator->frame_calls == 0) {
+      continue;
+    }
+    accumulator->frames++;
+    accumulator->calls += accumulator->frame_calls;
+    accumulator->cpu_min = min(accumulator->cpu_min, accumulator->frame_cpu);
+    accumulator->cpu_max = max(accumulator->cpu_max, accumulator->frame_cpu);
+    accumulator->cpu_total += accumulator->frame_cpu;
+    if(accumulator->gpu) {
+      accumulator->gpu_min = min(accumulator->gpu_min, accumulator->frame_gpu);
+      accumulator->gpu_max = max(accumulator->gpu_max, accumulator->frame_gpu);
+      accumulator->gpu_total += accumulator->frame_gpu;
+    }
+  }
+
+  if(_profile.trace != NULL) {
+    _trace_flush();
+  }
+
+  frame->recorded = false;
+  if(++_profile.window_frames >= (window > 0 ? window : 1)) {
+    _publish();
+  }
+}
+
+// ====================================================================================================================
+void profile_frame(void) {
+  _owner = true;
+
+  // scopes left open end with the frame, the whole frame is the first one
+  if(_profile.active) {
+    while(_profile.open.length > 0) {
+      profile_end();
+    }
+    _current()->recorded = true;
+    _profile.number++;
+  }
+
+  _profile.active = enabled;
+  if(!_profile.active) {
+    for(uint32_t i = 0; i < PROFILE_FRAMES; i++) {
+      _profile.frames[i].recorded = false;
+    }
+    return;
+  }
+
+  uint64_t now = platform_time_nanoseconds();
+  if(_profile.trace == NULL && !_profile.trace_failed && string_size(trace_path) > 0) {
+    _trace_open(now);
+  }
+
+  _Frame * frame = _current();
+  if(frame->recorded) {
+    _resolve(frame);
+  }
+  frame->scopes.length = 0;
+  frame->num_queries = 0;
+
+  GLint64 gpu_now;
+  glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+  frame->gpu_offset = (int64_t)now - gpu_now;
+
+  profile_begin_gl("frame");
+}
+
+const struct profile_Stats * profile_stats(uint32_t * count) {
+  *count = _profile.stats.length;
+  return _profile.stats.data;
+}
+
+void profile_shutdown(void) {
+  if(_profile.trace == NULL) {
+    return;
+  }
+  _trace("\n]\n");
+  uint64_t written;
+  platform_File_write_synchronous(_profile.trace, _profile.trace_offset, _profile.trace_buffer.data,
+                                  _profile.trace_buffer.length, &written);
+  _profile.trace_buffer.length = 0;
+  platform_File_close_synchronous(_profile.trace);
+  memory_free(_profile.trace, platform_File_size(), 8);
+  _profile.trace = NULL;
+}
@@ -0,0 +1,39 @@
+#ifndef __LIBRARY_CORE_PROFILE_H__
+#define __LIBRARY_CORE_PROFILE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// named scopes timed on the CPU, and with profile_begin_gl on the GPU through
+// timestamp queries that are read back when the frame comes around again in
+// the ring of PROFILE_FRAMES. scopes nest, the name is kept and has to live as
+// long as the program, a string literal.
+//
+// only the thread that calls profile_frame records, scopes anywhere else cost
+// a check and are dropped
+#define PROFILE_FRAMES 4
+
+void profile_begin(const char * name);
+void profile_begin_gl(const char * name);
+void profile_end(void);
+
+// ends the current frame and begins the next, once per swap
+void profile_frame(void);
+
+// per scope name over the last complete window of core.profile.window frames.
+// times are nanoseconds of one frame, every call in a frame adds up, over
+// the frames the scope ran in. gpu times stay 0 without profile_begin_gl
+struct profile_Stats {
+  const char * name;
+  uint32_t frames;
+  uint32_t calls;
+  uint64_t cpu_min, cpu_avg, cpu_max;
+  uint64_t gpu_min, gpu_avg, gpu_max;
+};
+
+const struct profile_Stats * profile_stats(uint32_t * count);
+
+// finishes the trace file
+void profile_shutdown(void);
+
+#endif
@@ -7,9 +7,8 @@ bool sort_binary_search(const void *key, const void *ptr, size_t count, size_t s
                           size_t *not_found) {
   size_t low = 0;
   size_t high = count;
-  int64_t middle;
-  while(high >= low && high <= count) {
-    middle = (low + high) >> 1;
+  while(low < high) {
+    size_t middle = (low + high) >> 1;
     const void *test = (uint8_t *)ptr + middle * size;
     int cmp = comp(key, test, ud);
     if(cmp == 0) {
@@ -18,10 +17,10 @@ bool sort_binary_search(const void *key, const void *ptr, size_t count, size_t s
     } else if(cmp > 0) {
       low = middle + 1;
     } else {
-      high = middle - 1;
+      high = middle;
     }
   }
-  *not_found = middle;
+  *not_found = low;
   return false;
 }
 
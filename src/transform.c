@@ -25,14 +25,14 @@ ECS_QUERY(translation_rotation_query, read(Translation2D, translation), modified
 ECS_QUERY(parent_world_query, read(Transform2D, transform), write(LocalToWorld2D, local_to_world), modified(Transform2D), exclude(Parent2D), action(
   local_to_world->motor = transform->value;
   local_to_world->position = pga2d_sandwich_bm(pga2d_point(0, 0), local_to_world->motor);
-  local_to_world->orientation = asinf(local_to_world->motor.e12) * 2;
+  local_to_world->orientation = atan2f(local_to_world->motor.e12, local_to_world->motor.one) * 2;
 ))
 
 ECS_QUERY(child_world_query, read(Transform2D, transform), read(Parent2D, parent), write(LocalToWorld2D, local_to_world), modified(Transform2D), modified(Parent2D), action(
   const struct LocalToWorld2D *parent_local_to_world = LocalToWorld2D_read(parent->value);
   local_to_world->motor = pga2d_mul_mm(parent_local_to_world->motor, transform->value);
   local_to_world->position = pga2d_sandwich_bm(pga2d_point(0, 0), local_to_world->motor);
-  local_to_world->orientation = asinf(local_to_world->motor.e12) * 2;
+  local_to_world->orientation = atan2f(local_to_world->motor.e12, local_to_world->motor.one) * 2;
 ))
 
 void transform_update2d_serial(void) {
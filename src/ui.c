@@ -2116,7 +2116,9 @@ static inline void _ui_start(void) {
 void ui_image(struct Image * img) {
   _ui_start();
   struct LoadedResource * resource = LoadedResource_from_image(img);
-  uilib_image(_ui, resource->image.width, resource->image.height, 0, 0, 1, 1, resource->id);
+  // an image packed into an atlas page covers only its rectangle of the texture
+  const struct GraphicsImage * image = &resource->image;
+  uilib_image(_ui, image->width, image->height, image->s0, image->t0, image->s1, image->t1, resource->id);
 }
 
 void ui_alignFractions(float x, float y) {
@@ -41,7 +41,9 @@
     ) : true                                                                                                                                 \
   )
 
-#define Vector_space_for(V, C) Vector_set_capacity(V, (((V)->length + (C)) + (((V)->length + (C)) >> 1)))
+// grows by half again only when the room is missing, so pushing one at a time is amortized
+#define Vector_space_for(V, C) \
+  ( ((V)->length + (C) <= (V)->capacity) ? true : Vector_set_capacity(V, (((V)->length + (C)) + (((V)->length + (C)) >> 1))) )
 
 #define Vector_qsort(V, F, U) sort_qsort((V)->data, (V)->length, sizeof(*(V)->data), F, U)
 
@@ -37,6 +37,10 @@ char *PREFIX = NULL;
 char *prefix = NULL;
 
 int p = 0, n = 0, d = 0;
+int simd = 0;
+int report = 0;
+int benchmark = 0;
+int fixed = 0;
 int first_basis;
 int num_dimensions;
 int num_grades;
@@ -157,6 +161,166 @@ BasisRef _dual(BasisRef a) {
 BasisRef *_cayley_table;  // num_basis*num_basis ; [a * num_basis + b] = c
 BasisRef *_product_table; // num_basis*num_basis ; [c * num_basis + a] = b
 
+enum Op {
+  OP_NEGATE,
+  OP_DUAL,
+  OP_UNDUAL,
+  OP_POLAR,
+  OP_REVERSE,
+  OP_INVOLUTE,
+  OP_CONJUGATE,
+  OP_ADD,
+  OP_SUBTRACT,
+  OP_GEOMETRIC_PRODUCT,
+  OP_OUTER_PRODUCT,
+  OP_REGRESSIVE_PRODUCT,
+  OP_COMMUTATOR_PRODUCT,
+  OP_INNER_PRODUCT,
+  OP_LEFT_DOT_PRODUCT,
+  NUM_OPS
+};
+
+struct {
+  const char *lower;
+  const char *upper;
+  int argument_count;
+} op[] = {{"negate", "NEGATE", 1},
+          {"dual", "DUAL", 1},
+          {"undual", "UNDUAL", 1},
+          {"polar", "POLAR", 1},
+          {"reverse", "REVERSE", 1},
+          {"involute", "INVOLUTE", 1},
+          {"conjugate", "CONJUGATE", 1},
+          {"add", "ADD", 2},
+          {"subtract", "SUBTRACT", 2},
+          {"geometric_product", "GEOMETRIC_PRODUCT", 2},
+          {"outer_product", "OUTER_PRODUCT", 2},
+          {"regressive_product", "REGRESSIVE_PRODUCT", 2},
+          {"commutator_product", "COMMUTATOR_PRODUCT", 2},
+          {"inner_product", "INNER_PRODUCT", 2},
+          {"left_dot_product", "LEFT_DOT_PRODUCT", 2}};
+
+// one signed term of an output blade, a is the blade read from X and b the one
+// read from Y. a term of a unary operation or of add/subtract reads only one
+// side, the other is -1. a sign of 0 is an explicit zero
+typedef struct {
+  int sign;
+  int a;
+  int b;
+} Term;
+
+// fills the terms of output blade i of an operation, at most 2 * num_basis
+int _op_terms(enum Op o, int i, Term *terms) {
+  int count = 0;
+  switch(o) {
+  case OP_NEGATE:
+    terms[count++] = (Term){-1, i, -1};
+    break;
+  case OP_DUAL: {
+    BasisRef dual = _dual((BasisRef){.basis = i, .sign = 1});
+    terms[count++] = (Term){dual.sign, dual.basis, -1};
+    break;
+  }
+  case OP_UNDUAL: {
+    BasisRef dual = _dual((BasisRef){.basis = i, .sign = 1});
+    BasisRef dual2 = _dual((BasisRef){.basis = num_basis - i - 1, .sign = 1});
+    terms[count++] = (Term){dual2.sign, dual.basis, -1};
+    break;
+  }
+  case OP_POLAR:
+    for(int j = 0; j < num_basis; j++) {
+      BasisRef polar = _mul_basis_ref((BasisRef){.basis = j, .sign = 1}, (BasisRef){.basis = num_basis - 1, .sign = 1});
+      if(polar.basis == i) {
+        terms[count++] = (Term){polar.sign, polar.basis, -1};
+      }
+    }
+    break;
+  case OP_REVERSE:
+    terms[count++] = (Term){basis[i].grade % 4 < 2 ? 1 : -1, i, -1};
+    break;
+  case OP_INVOLUTE:
+    terms[count++] = (Term){basis[i].grade % 2 < 1 ? 1 : -1, i, -1};
+    break;
+  case OP_CONJUGATE:
+    terms[count++] = (Term){(basis[i].grade + 1) % 4 < 2 ? 1 : -1, i, -1};
+    break;
+  case OP_ADD:
+    terms[count++] = (Term){1, i, -1};
+    terms[count++] = (Term){1, -1, i};
+    break;
+  case OP_SUBTRACT:
+    terms[count++] = (Term){1, i, -1};
+    terms[count++] = (Term){-1, -1, i};
+    break;
+  case OP_GEOMETRIC_PRODUCT:
+  case OP_OUTER_PRODUCT:
+  case OP_INNER_PRODUCT:
+  case OP_LEFT_DOT_PRODUCT:
+    for(int j = 0; j < num_basis; j++) {
+      BasisRef b = _product_table[i * num_basis + j];
+      int ga = basis[j].grade, gb = basis[b.basis].grade, gc = basis[i].grade;
+      if((o == OP_OUTER_PRODUCT && ga + gb != gc) || (o == OP_INNER_PRODUCT && abs(gb - ga) != gc) || (o == OP_LEFT_DOT_PRODUCT && gb - ga != gc)) {
+        continue;
+      }
+      if(b.sign) {
+        terms[count++] = (Term){b.sign, j, b.basis};
+      }
+    }
+    break;
+  case OP_REGRESSIVE_PRODUCT:
+    // instead of the Product table use Cayley table and select based on output
+    for(int j = 0; j < num_basis; j++) {
+      BasisRef a = (BasisRef){j, 1}, ad = _dual(a);
+
+      for(int k = 0; k < num_basis; k++) {
+        BasisRef b = (BasisRef){k, 1}, bd = _dual(b);
+
+        BasisRef c = _cayley_table[ad.basis * num_basis + bd.basis], cd = _dual(c);
+
+        // limit output to dual basis
+        if(cd.basis != i) {
+          continue;
+        }
+
+        // and then non-dual grade selection of outer product
+        if(basis[ad.basis].grade + basis[bd.basis].grade != basis[c.basis].grade) {
+          continue;
+        }
+
+        int sign = ad.sign * bd.sign * c.sign * cd.sign;
+        if(sign) {
+          terms[count++] = (Term){sign, a.basis, b.basis};
+        }
+      }
+    }
+    break;
+  case OP_COMMUTATOR_PRODUCT:
+    // instead of the Product table use Cayley table and select based on output
+    for(int j = 0; j < num_basis; j++) {
+      for(int k = 0; k < num_basis; k++) {
+        BasisRef ab = _cayley_table[j * num_basis + k];
+        BasisRef ba = _cayley_table[k * num_basis + j];
+
+        if(ab.basis == ba.basis && ab.sign == ba.sign) {
+          continue;
+        }
+
+        if(ab.basis != i) {
+          continue;
+        }
+
+        if(ab.sign) {
+          terms[count++] = (Term){ab.sign, j, k};
+        }
+      }
+    }
+    break;
+  default:
+    break;
+  }
+  return count;
+}
+
 void grades(char c) {
   for(int i = 0; i < num_grades; i++) {
     printf("%s%c%i", i ? "," : "", c, i);
@@ -169,6 +333,89 @@ void values(char c) {
   }
 }
 
+void _type_names(int grades, const char *suffix) {
+  if(grades == 1 << 0) {
+    printf(", %s_Scalar%s", prefix, suffix);
+  } else if(grades == 1 << 1) {
+    printf(", %s_Vector%s", prefix, suffix);
+  } else if(grades == 1 << 2) {
+    printf(", %s_Bivector%s", prefix, suffix);
+  } else if(grades == 1 << 3) {
+    printf(", %s_Trivector%s", prefix, suffix);
+  }
+
+  if(grades == 1 << (num_grades - 1)) {
+    printf(", %s_AntiScalar%s", prefix, suffix);
+  } else if(grades == 1 << (num_grades - 2)) {
+    printf(", %s_AntiVector%s", prefix, suffix);
+  } else if(grades == 1 << (num_grades - 3)) {
+    printf(", %s_AntiBivector%s", prefix, suffix);
+  } else if(grades == 1 << (num_grades - 4)) {
+    printf(", %s_AntiTrivector%s", prefix, suffix);
+  }
+}
+
+void _type_code(int grades, char *out) {
+  for(int j = 0; j < num_grades; j++) {
+    *out++ = (grades & (1 << j)) ? '1' : '0';
+  }
+  *out = 0;
+}
+
+void _grade_codes(void) {
+  // type coding
+  char gcodes[] = "svbtq___";
+  if(num_grades > 5) {
+    gcodes[num_grades - 2] = 'V';
+  }
+  gcodes[num_grades - 1] = 'S';
+  gcodes[num_grades] = 0;
+
+  for(int i = 0; i < num_grades; i++) {
+    _add_code(gcodes[i], 1 << i);
+  }
+}
+
+void _unary_macro(enum Op o) {
+  Term terms[2 * num_basis];
+  printf("#define %s_OP_%s(RETURN, ", PREFIX, op[o].upper);
+  values('X');
+  printf(", ...) RETURN(" NL);
+  for(int i = 0; i < num_basis; i++) {
+    int count = _op_terms(o, i, terms);
+    printf(i ? "  , " : "    ");
+    for(int j = 0; j < count; j++) {
+      if(terms[j].sign == -1) {
+        printf("%s_NEG(X%s)", PREFIX, basis[terms[j].a].name);
+      } else if(terms[j].sign == 1) {
+        printf("X%s", basis[terms[j].a].name);
+      } else {
+        printf("0");
+      }
+    }
+    printf(NL);
+  }
+  printf("  , ## __VA_ARGS__)\n");
+}
+
+void _binary_macro(enum Op o) {
+  Term terms[2 * num_basis];
+  printf("#define %s_OP_%s(RETURN, ", PREFIX, op[o].upper);
+  values('X');
+  printf(", ");
+  values('Y');
+  printf(", ...) RETURN(" NL);
+  for(int i = 0; i < num_basis; i++) {
+    int count = _op_terms(o, i, terms);
+    printf("  %s0", i ? ", " : "  ");
+    for(int j = 0; j < count; j++) {
+      printf(" %s_%s_MUL(X%s,Y%s)", PREFIX, terms[j].sign == -1 ? "SUB" : "ADD", basis[terms[j].a].name, basis[terms[j].b].name);
+    }
+    printf(NL);
+  }
+  printf("  , ## __VA_ARGS__)\n");
+}
+
 const char *header = "#ifndef _%1$s_H_\n"
                      "#define _%1$s_H_\n"
                      "// %2$i positive dimension(s)\n"
@@ -221,13 +468,1028 @@ const char *header = "#ifndef _%1$s_H_\n"
                      "#define %1$s_ADD_MUL(X, Y) %1$s_IF(%1$s_OR(%1$s_IS_ZERO(X), %1$s_IS_ZERO(Y)))( )( +(X*Y) )\n"
                      "#define %1$s_SUB_MUL(X, Y) %1$s_IF(%1$s_OR(%1$s_IS_ZERO(X), %1$s_IS_ZERO(Y)))( )( -(X*Y) )\n";
 
+const char *soa_header = "#ifndef _%1$s_SOA_H_\n"
+                         "#define _%1$s_SOA_H_\n"
+                         "// batch kernels over a struct of arrays, one float array per blade. rows go\n"
+                         "// %1$s_SOA_LANES at a time through SSE or AVX and the rest one by one, define\n"
+                         "// %1$s_SOA_NO_SIMD for the plain C version. the output may alias an input\n"
+                         "#include <stdint.h>\n"
+                         "#if !defined(%1$s_SOA_NO_SIMD) && defined(__AVX__)\n"
+                         "#include <immintrin.h>\n"
+                         "#define %1$s_SOA_LANES 8\n"
+                         "#define %1$s_SOA_LANE __m256\n"
+                         "#define %1$s_SOA_LOAD(P) _mm256_loadu_ps(P)\n"
+                         "#define %1$s_SOA_STORE(P, X) _mm256_storeu_ps(P, X)\n"
+                         "#define %1$s_SOA_ZERO() _mm256_setzero_ps()\n"
+                         "#define %1$s_SOA_ADD(X, Y) _mm256_add_ps(X, Y)\n"
+                         "#define %1$s_SOA_SUB(X, Y) _mm256_sub_ps(X, Y)\n"
+                         "#define %1$s_SOA_MUL(X, Y) _mm256_mul_ps(X, Y)\n"
+                         "#elif !defined(%1$s_SOA_NO_SIMD) && (defined(__SSE__) || defined(_M_X64))\n"
+                         "#include <xmmintrin.h>\n"
+                         "#define %1$s_SOA_LANES 4\n"
+                         "#define %1$s_SOA_LANE __m128\n"
+                         "#define %1$s_SOA_LOAD(P) _mm_loadu_ps(P)\n"
+                         "#define %1$s_SOA_STORE(P, X) _mm_storeu_ps(P, X)\n"
+                         "#define %1$s_SOA_ZERO() _mm_setzero_ps()\n"
+                         "#define %1$s_SOA_ADD(X, Y) _mm_add_ps(X, Y)\n"
+                         "#define %1$s_SOA_SUB(X, Y) _mm_sub_ps(X, Y)\n"
+                         "#define %1$s_SOA_MUL(X, Y) _mm_mul_ps(X, Y)\n"
+                         "#endif\n";
+
+// operations the batch kernels and the benchmark cover, the same the macros
+// have. polar and undual need the degenerate metric
+int _batch_op(enum Op o) {
+  return !((o == OP_POLAR || o == OP_UNDUAL) && !d);
+}
+
+// the terms of output blade i that survive the grades of the operands, the
+// rest read blades the operand types do not have
+int _live_terms(enum Op o, int i, int x_grades, int y_grades, Term *terms) {
+  int count = _op_terms(o, i, terms), live = 0;
+  for(int j = 0; j < count; j++) {
+    Term t = terms[j];
+    if(t.sign == 0 || (t.a >= 0 && !(x_grades & (1 << basis[t.a].grade))) || (t.b >= 0 && !(y_grades & (1 << basis[t.b].grade)))) {
+      continue;
+    }
+    terms[live++] = t;
+  }
+  return live;
+}
+
+void _soa_value(Term t, int lanes) {
+  if(t.a >= 0 && t.b >= 0) {
+    if(lanes) {
+      printf("%s_SOA_MUL(x_%s, y_%s)", PREFIX, basis[t.a].name, basis[t.b].name);
+    } else {
+      printf("x_%s * y_%s", basis[t.a].name, basis[t.b].name);
+    }
+  } else {
+    printf("%c_%s", t.a >= 0 ? 'x' : 'y', basis[t.a >= 0 ? t.a : t.b].name);
+  }
+}
+
+void _soa_expression(const Term *terms, int count, int lanes) {
+  if(count == 0) {
+    printf(lanes ? "%s_SOA_ZERO()" : "0", PREFIX);
+    return;
+  }
+  if(lanes) {
+    for(int j = count - 1; j > 0; j--) {
+      printf("%s_SOA_%s(", PREFIX, terms[j].sign < 0 ? "SUB" : "ADD");
+    }
+    if(terms[0].sign < 0) {
+      printf("%s_SOA_SUB(%s_SOA_ZERO(), ", PREFIX, PREFIX);
+      _soa_value(terms[0], lanes);
+      printf(")");
+    } else {
+      _soa_value(terms[0], lanes);
+    }
+    for(int j = 1; j < count; j++) {
+      printf(", ");
+      _soa_value(terms[j], lanes);
+      printf(")");
+    }
+  } else {
+    for(int j = 0; j < count; j++) {
+      printf(j ? (terms[j].sign < 0 ? " - " : " + ") : (terms[j].sign < 0 ? "-" : ""));
+      _soa_value(terms[j], lanes);
+    }
+  }
+}
+
+// one pass over the rows, lanes picks the vector or the scalar spelling
+void _soa_loop(enum Op o, int x_grades, int y_grades, int z_grades, int lanes) {
+  Term terms[2 * num_basis];
+  const char *type = lanes ? "" : "float";
+  char lane_type[64];
+  if(lanes) {
+    snprintf(lane_type, sizeof(lane_type), "%s_SOA_LANE", PREFIX);
+    type = lane_type;
+  }
+  const char *indent = "    ";
+
+  // every blade read before the first store so z may alias x or y
+  for(int side = 0; side < 2; side++) {
+    int grades = side ? y_grades : x_grades;
+    for(int j = 0; j < num_basis; j++) {
+      int read = 0;
+      for(int i = 0; i < num_basis && !read; i++) {
+        if(!(z_grades & (1 << basis[i].grade))) {
+          continue;
+        }
+        int count = _live_terms(o, i, x_grades, y_grades, terms);
+        for(int k = 0; k < count; k++) {
+          read |= (side ? terms[k].b : terms[k].a) == j;
+        }
+      }
+      if(!read || !(grades & (1 << basis[j].grade))) {
+        continue;
+      }
+      if(lanes) {
+        printf("%s%s %c_%s = %s_SOA_LOAD(%c.%s + i);\n", indent, type, side ? 'y' : 'x', basis[j].name, PREFIX, side ? 'y' : 'x', basis[j].name);
+      } else {
+        printf("%s%s %c_%s = %c.%s[i];\n", indent, type, side ? 'y' : 'x', basis[j].name, side ? 'y' : 'x', basis[j].name);
+      }
+    }
+  }
+  for(int i = 0; i < num_basis; i++) {
+    if(!(z_grades & (1 << basis[i].grade))) {
+      continue;
+    }
+    int count = _live_terms(o, i, x_grades, y_grades, terms);
+    printf("%s%s z_%s = ", indent, type, basis[i].name);
+    _soa_expression(terms, count, lanes);
+    printf(";\n");
+  }
+  for(int i = 0; i < num_basis; i++) {
+    if(!(z_grades & (1 << basis[i].grade))) {
+      continue;
+    }
+    if(lanes) {
+      printf("%s%s_SOA_STORE(z.%s + i, z_%s);\n", indent, PREFIX, basis[i].name, basis[i].name);
+    } else {
+      printf("%sz.%s[i] = z_%s;\n", indent, basis[i].name, basis[i].name);
+    }
+  }
+}
+
+// grades of the result of an operation on these operand grades, 0 when it is
+// zero throughout
+int _soa_grades(enum Op o, int x_grades, int y_grades) {
+  Term terms[2 * num_basis];
+  int z_grades = 0;
+  for(int i = 0; i < num_basis; i++) {
+    if(_live_terms(o, i, x_grades, y_grades, terms) > 0) {
+      z_grades |= 1 << basis[i].grade;
+    }
+  }
+  return z_grades;
+}
+
+// y_code is -1 for unary operations
+void _soa_kernel(enum Op o, int x_code, int y_code) {
+  int x_grades = codes[x_code].grades;
+  int y_grades = y_code >= 0 ? codes[y_code].grades : 0;
+  int z_grades = _soa_grades(o, x_grades, y_grades);
+  if(z_grades == 0) {
+    return;
+  }
+
+  char x_type[num_grades + 1], y_type[num_grades + 1], z_type[num_grades + 1];
+  _type_code(x_grades, x_type);
+  _type_code(y_grades, y_type);
+  _type_code(z_grades, z_type);
+
+  if(y_code >= 0) {
+    printf("static inline void %s_%s_%c%c_soa(%s_%s_soa z, %s_%s_soa x, %s_%s_soa y, uint32_t count) {\n", prefix, op[o].lower, codes[x_code].code,
+           codes[y_code].code, prefix, z_type, prefix, x_type, prefix, y_type);
+  } else {
+    printf("static inline void %s_%s_%c_soa(%s_%s_soa z, %s_%s_soa x, uint32_t count) {\n", prefix, op[o].lower, codes[x_code].code, prefix, z_type,
+           prefix, x_type);
+  }
+  printf("  uint32_t i = 0;\n");
+  printf("#ifdef %s_SOA_LANES\n", PREFIX);
+  printf("  for(; i + %s_SOA_LANES <= count; i += %s_SOA_LANES) {\n", PREFIX, PREFIX);
+  _soa_loop(o, x_grades, y_grades, z_grades, 1);
+  printf("  }\n");
+  printf("#endif\n");
+  printf("  for(; i < count; i++) {\n");
+  _soa_loop(o, x_grades, y_grades, z_grades, 0);
+  printf("  }\n");
+  printf("}\n");
+}
+
+// the op aliases, mul for geometric_product and so on, of the kernels with this
+// suffix
+void _kernel_aliases(const char *suffix) {
+  for(unsigned int i = 0; i < num_op_alias; i++) {
+    enum Op o = 0;
+    while(o < NUM_OPS && strcmp(op[o].lower, op_alias[i].to)) {
+      o++;
+    }
+    if(o == NUM_OPS || !_batch_op(o)) {
+      continue;
+    }
+    for(int j = 0; j < num_codes; j++) {
+      if(!op_alias[i].binary) {
+        if(_soa_grades(o, codes[j].grades, 0)) {
+          printf("#define %s_%s_%c%s %s_%s_%c%s\n", prefix, op_alias[i].from, codes[j].code, suffix, prefix, op[o].lower, codes[j].code, suffix);
+        }
+        continue;
+      }
+      for(int k = 0; k < num_codes; k++) {
+        if(_soa_grades(o, codes[j].grades, codes[k].grades)) {
+          printf("#define %s_%s_%c%c%s %s_%s_%c%c%s\n", prefix, op_alias[i].from, codes[j].code, codes[k].code, suffix, prefix, op[o].lower,
+                 codes[j].code, codes[k].code, suffix);
+        }
+      }
+    }
+  }
+}
+
+void generate_soa(void) {
+  for(int i = 1; i < 1 << num_grades; i++) {
+    char code[num_grades + 1];
+    _type_code(i, code);
+
+    printf("typedef struct %s_%s_soa { float", prefix, code);
+    int first = 1;
+    for(int j = 0; j < num_basis; j++) {
+      if(i & (1 << basis[j].grade)) {
+        printf("%s *%s", first ? "" : ",", basis[j].name);
+        first = 0;
+      }
+    }
+    printf("; } %s_%s_soa", prefix, code);
+    _type_names(i, "_soa");
+    printf(";\n");
+  }
+
+  _grade_codes();
+
+  for(enum Op o = 0; o < NUM_OPS; o++) {
+    if(!_batch_op(o)) {
+      continue;
+    }
+    for(int i = 0; i < num_codes; i++) {
+      if(op[o].argument_count == 1) {
+        _soa_kernel(o, i, -1);
+        continue;
+      }
+      for(int j = 0; j < num_codes; j++) {
+        _soa_kernel(o, i, j);
+      }
+    }
+  }
+
+  _kernel_aliases("_soa");
+
+  printf("#endif // _%s_SOA_H_\n", PREFIX);
+}
+
+// ====================================================================================================================
+// fixed point
+//
+// every operation again over FixedPoint16 from fixed_point.h, as functions on
+// their own structs. each output blade is one wide integer sum saturated once
+const char *fixed_header = "#ifndef _%1$s_FIXED_H_\n"
+                           "#define _%1$s_FIXED_H_\n"
+                           "// the operations in Q16.16 fixed point, include fixed_point.h first. each\n"
+                           "// output blade is one integer sum saturated once, a result is the same bits\n"
+                           "// on every platform and compiler. %2$s_to_fixed_<code> and\n"
+                           "// %2$s_from_fixed_<code> convert from and to the float types\n"
+                           "#include \"%2$s.h\"\n";
+
+void _fixed_value(Term t) {
+  if(t.a >= 0 && t.b >= 0) {
+    printf("FixedPoint16_WIDE_MUL(x.%s, y.%s)", basis[t.a].name, basis[t.b].name);
+  } else {
+    printf("(int64_t)%c.%s", t.a >= 0 ? 'x' : 'y', basis[t.a >= 0 ? t.a : t.b].name);
+  }
+}
+
+// y_code is -1 for unary operations
+void _fixed_kernel(enum Op o, int x_code, int y_code) {
+  Term terms[2 * num_basis];
+  int x_grades = codes[x_code].grades;
+  int y_grades = y_code >= 0 ? codes[y_code].grades : 0;
+  int z_grades = _soa_grades(o, x_grades, y_grades);
+  if(z_grades == 0) {
+    return;
+  }
+
+  char x_type[num_grades + 1], y_type[num_grades + 1], z_type[num_grades + 1];
+  _type_code(x_grades, x_type);
+  _type_code(y_grades, y_type);
+  _type_code(z_grades, z_type);
+
+  if(y_code >= 0) {
+    printf("static inline %s_%s_fixed %s_%s_%c%c_fixed(%s_%s_fixed x, %s_%s_fixed y) {\n", prefix, z_type, prefix, op[o].lower, codes[x_code].code,
+           codes[y_code].code, prefix, x_type, prefix, y_type);
+  } else {
+    printf("static inline %s_%s_fixed %s_%s_%c_fixed(%s_%s_fixed x) {\n", prefix, z_type, prefix, op[o].lower, codes[x_code].code, prefix, x_type);
+  }
+  printf("  %s_%s_fixed z;\n", prefix, z_type);
+  for(int i = 0; i < num_basis; i++) {
+    if(!(z_grades & (1 << basis[i].grade))) {
+      continue;
+    }
+    int count = _live_terms(o, i, x_grades, y_grades, terms);
+    printf("  z.%s = ", basis[i].name);
+    if(count == 0) {
+      printf("0");
+    } else if(count == 1 && terms[0].sign > 0 && (terms[0].a < 0 || terms[0].b < 0)) {
+      printf("%c.%s", terms[0].a >= 0 ? 'x' : 'y', basis[terms[0].a >= 0 ? terms[0].a : terms[0].b].name);
+    } else {
+      // products and plain blades do not mix within one operation
+      printf("FixedPoint16_%s(", terms[0].a >= 0 && terms[0].b >= 0 ? "narrow" : "saturate");
+      for(int j = 0; j < count; j++) {
+        printf(j ? (terms[j].sign < 0 ? " - " : " + ") : (terms[j].sign < 0 ? "-" : ""));
+        _fixed_value(terms[j]);
+      }
+      printf(")");
+    }
+    printf(";\n");
+  }
+  printf("  return z;\n");
+  printf("}\n");
+}
+
+void _fixed_conversion(int code) {
+  int grades = codes[code].grades;
+  char type[num_grades + 1];
+  _type_code(grades, type);
+
+  printf("static inline %s_%s_fixed %s_to_fixed_%c(%s_%s x) {\n", prefix, type, prefix, codes[code].code, prefix, type);
+  printf("  return (%s_%s_fixed){", prefix, type);
+  int first = 1;
+  for(int j = 0; j < num_basis; j++) {
+    if(grades & (1 << basis[j].grade)) {
+      printf("%s.%s = FixedPoint16_from_float(x.%s)", first ? "" : ", ", basis[j].name, basis[j].name);
+      first = 0;
+    }
+  }
+  printf("};\n");
+  printf("}\n");
+
+  printf("static inline %s_%s %s_from_fixed_%c(%s_%s_fixed x) {\n", prefix, type, prefix, codes[code].code, prefix, type);
+  printf("  return (%s_%s){", prefix, type);
+  first = 1;
+  for(int j = 0; j < num_basis; j++) {
+    if(grades & (1 << basis[j].grade)) {
+      printf("%s.%s = FixedPoint16_to_float(x.%s)", first ? "" : ", ", basis[j].name, basis[j].name);
+      first = 0;
+    }
+  }
+  printf("};\n");
+  printf("}\n");
+}
+
+void generate_fixed(void) {
+  for(int i = 1; i < 1 << num_grades; i++) {
+    char code[num_grades + 1];
+    _type_code(i, code);
+
+    printf("typedef struct %s_%s_fixed { FixedPoint16", prefix, code);
+    int first = 1;
+    for(int j = 0; j < num_basis; j++) {
+      if(i & (1 << basis[j].grade)) {
+        printf("%s %s", first ? "" : ",", basis[j].name);
+        first = 0;
+      }
+    }
+    printf("; } %s_%s_fixed", prefix, code);
+    _type_names(i, "_fixed");
+    printf(";\n");
+  }
+
+  _grade_codes();
+
+  for(int i = 0; i < num_codes; i++) {
+    _fixed_conversion(i);
+  }
+
+  for(enum Op o = 0; o < NUM_OPS; o++) {
+    if(!_batch_op(o)) {
+      continue;
+    }
+    for(int i = 0; i < num_codes; i++) {
+      if(op[o].argument_count == 1) {
+        _fixed_kernel(o, i, -1);
+        continue;
+      }
+      for(int j = 0; j < num_codes; j++) {
+        _fixed_kernel(o, i, j);
+      }
+    }
+  }
+
+  _kernel_aliases("_fixed");
+
+  printf("#endif // _%s_FIXED_H_\n", PREFIX);
+}
+
+// ====================================================================================================================
+// fused operations
+//
+// a sandwich r x ~r written as two products repeats r_a r_b pairs across blades
+// and computes blades whose terms cancel. expanded into one polynomial per
+// output blade the cancelled blades drop out, the pairs are computed once and
+// shared, and each output blade is a row of a matrix over the blades of x
+typedef struct {
+  int mul;
+  int add;
+} Flops;
+
+int _reverse_sign(int blade) {
+  return basis[blade].grade % 4 < 2 ? 1 : -1;
+}
+
+// the flops of a product as the macros emit it, only blades in z_grades
+Flops _product_flops(enum Op o, int x_grades, int y_grades, int z_grades) {
+  Term terms[2 * num_basis];
+  Flops flops = {0, 0};
+  for(int i = 0; i < num_basis; i++) {
+    if(!(z_grades & (1 << basis[i].grade))) {
+      continue;
+    }
+    int count = _live_terms(o, i, x_grades, y_grades, terms);
+    for(int j = 0; j < count; j++) {
+      flops.mul += terms[j].a >= 0 && terms[j].b >= 0;
+    }
+    flops.add += count > 1 ? count - 1 : 0;
+  }
+  return flops;
+}
+
+// coefficient of r_a r_b x_k, a <= b, in output blade i of r x ~r
+int *_sandwich_coefficients;
+
+#define SANDWICH(I, A, B, K) _sandwich_coefficients[(((I) * num_basis + (A)) * num_basis + (B)) * num_basis + (K)]
+
+// expands r x ~r, returns the grades of the result
+int _sandwich_expand(int x_grades, int r_grades) {
+  if(_sandwich_coefficients == NULL) {
+    _sandwich_coefficients = calloc(num_basis * num_basis * num_basis * num_basis, sizeof(int));
+  }
+  memset(_sandwich_coefficients, 0, num_basis * num_basis * num_basis * num_basis * sizeof(int));
+
+  Term outer[2 * num_basis], inner[2 * num_basis];
+  int p_grades = _soa_grades(OP_GEOMETRIC_PRODUCT, r_grades, x_grades);
+  for(int i = 0; i < num_basis; i++) {
+    int outer_count = _live_terms(OP_GEOMETRIC_PRODUCT, i, p_grades, r_grades, outer);
+    for(int j = 0; j < outer_count; j++) {
+      int rr = outer[j].b;
+      int sign = outer[j].sign * _reverse_sign(rr);
+      int inner_count = _live_terms(OP_GEOMETRIC_PRODUCT, outer[j].a, r_grades, x_grades, inner);
+      for(int k = 0; k < inner_count; k++) {
+        int ra = inner[k].a;
+        SANDWICH(i, MIN(ra, rr), MAX(ra, rr), inner[k].b) += sign * inner[k].sign;
+      }
+    }
+  }
+
+  int z_grades = 0;
+  for(int i = 0; i < num_basis; i++) {
+    for(int a = 0; a < num_basis; a++) {
+      for(int b = a; b < num_basis; b++) {
+        for(int k = 0; k < num_basis; k++) {
+          if(SANDWICH(i, a, b, k)) {
+            z_grades |= 1 << basis[i].grade;
+          }
+        }
+      }
+    }
+  }
+  return z_grades;
+}
+
+int _gcd(int a, int b) {
+  while(b) {
+    int t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// the sum of coefficient * pair of entry (i, k), a common factor taken out.
+// printed when print is set, returns the flops
+Flops _entry(int i, int k, int print) {
+  Flops flops = {0, 0};
+  int factor = 0, count = 0;
+  for(int a = 0; a < num_basis; a++) {
+    for(int b = a; b < num_basis; b++) {
+      factor = _gcd(factor, abs(SANDWICH(i, a, b, k)));
+      count += SANDWICH(i, a, b, k) != 0;
+    }
+  }
+  if(factor > 1) {
+    if(print) {
+      printf(count > 1 ? "%i * (" : "%i * ", factor);
+    }
+    flops.mul++;
+  }
+  int first = 1;
+  for(int a = 0; a < num_basis; a++) {
+    for(int b = a; b < num_basis; b++) {
+      int c = SANDWICH(i, a, b, k) / (factor ? factor : 1);
+      if(c == 0) {
+        continue;
+      }
+      if(print) {
+        printf("%s", first ? (c < 0 ? "-" : "") : (c < 0 ? " - " : " + "));
+        if(abs(c) != 1) {
+          printf("%i * ", abs(c));
+        }
+        printf("r_%s_%s", basis[a].name, basis[b].name);
+      }
+      flops.mul += abs(c) != 1;
+      flops.add += !first;
+      first = 0;
+    }
+  }
+  if(factor > 1 && count > 1 && print) {
+    printf(")");
+  }
+  return flops;
+}
+
+// 1 when the pairs of entry (i, k) are those of (j, l), -1 when negated
+int _same_entry(int i, int k, int j, int l) {
+  int same = 1, negated = 1, any = 0;
+  for(int a = 0; a < num_basis; a++) {
+    for(int b = a; b < num_basis; b++) {
+      int x = SANDWICH(i, a, b, k), y = SANDWICH(j, a, b, l);
+      same &= x == y;
+      negated &= x == -y;
+      any |= x != 0;
+    }
+  }
+  return !any ? 0 : same ? 1 : negated ? -1 : 0;
+}
+
+int _entry_terms(int i, int k) {
+  int count = 0, unit = 1;
+  for(int a = 0; a < num_basis; a++) {
+    for(int b = a; b < num_basis; b++) {
+      count += SANDWICH(i, a, b, k) != 0;
+      unit &= abs(SANDWICH(i, a, b, k)) < 2;
+    }
+  }
+  // a lone pair with a coefficient still needs the multiply of an entry
+  return count == 1 && !unit ? 2 : count;
+}
+
+// prints the sandwich function when print is set, returns its flops
+Flops _sandwich(int x_code, int r_code, int z_grades, int print) {
+  Flops flops = {0, 0};
+  char x_type[num_grades + 1], r_type[num_grades + 1], z_type[num_grades + 1];
+  _type_code(codes[x_code].grades, x_type);
+  _type_code(codes[r_code].grades, r_type);
+  _type_code(z_grades, z_type);
+
+  // entry (i, k) is shared with the first equal entry, name[i * nb + k] holds
+  // that entry's index + 1, negative when negated
+  int *name = calloc(num_basis * num_basis, sizeof(int));
+
+  if(print) {
+    printf("static inline %s_%s %s_sandwich_%c%c(%s_%s x, %s_%s r) {\n", prefix, z_type, prefix, codes[x_code].code, codes[r_code].code, prefix, x_type,
+           prefix, r_type);
+  }
+  for(int a = 0; a < num_basis; a++) {
+    for(int b = a; b < num_basis; b++) {
+      int used = 0;
+      for(int i = 0; i < num_basis && !used; i++) {
+        for(int k = 0; k < num_basis && !used; k++) {
+          used = SANDWICH(i, a, b, k) != 0;
+        }
+      }
+      if(used) {
+        if(print) {
+          printf("  float r_%s_%s = r.%s * r.%s;\n", basis[a].name, basis[b].name, basis[a].name, basis[b].name);
+        }
+        flops.mul++;
+      }
+    }
+  }
+  for(int e = 0; e < num_basis * num_basis; e++) {
+    int i = e / num_basis, k = e % num_basis;
+    if(_entry_terms(i, k) < 2) {
+      continue;
+    }
+    for(int f = 0; f < e && !name[e]; f++) {
+      int same = name[f] == f + 1 ? _same_entry(i, k, f / num_basis, f % num_basis) : 0;
+      name[e] = same * (f + 1);
+    }
+    if(name[e] == 0) {
+      name[e] = e + 1;
+      if(print) {
+        printf("  float m_%s_%s = ", basis[i].name, basis[k].name);
+      }
+      Flops entry = _entry(i, k, print);
+      if(print) {
+        printf(";\n");
+      }
+      flops.mul += entry.mul;
+      flops.add += entry.add;
+    }
+  }
+  if(print) {
+    printf("  return (%s_%s) {\n", prefix, z_type);
+    printf("    ._ = 0\n");
+  }
+  for(int i = 0; i < num_basis; i++) {
+    if(!(z_grades & (1 << basis[i].grade))) {
+      continue;
+    }
+    if(print) {
+      printf("  , .%s = ", basis[i].name);
+    }
+    int first = 1;
+    for(int k = 0; k < num_basis; k++) {
+      int terms = _entry_terms(i, k);
+      if(terms == 0) {
+        continue;
+      }
+      int negate = 0;
+      if(print) {
+        if(terms == 1) {
+          // a single pair, sign folded into the sum
+          for(int a = 0; a < num_basis; a++) {
+            for(int b = a; b < num_basis; b++) {
+              if(SANDWICH(i, a, b, k)) {
+                negate = SANDWICH(i, a, b, k) < 0;
+                printf("%sx.%s * r_%s_%s", first ? (negate ? "-" : "") : (negate ? " - " : " + "), basis[k].name, basis[a].name, basis[b].name);
+              }
+            }
+          }
+        } else {
+          int shared = name[i * num_basis + k];
+          negate = shared < 0;
+          shared = abs(shared) - 1;
+          printf("%sx.%s * m_%s_%s", first ? (negate ? "-" : "") : (negate ? " - " : " + "), basis[k].name, basis[shared / num_basis].name,
+                 basis[shared % num_basis].name);
+        }
+      }
+      flops.mul++;
+      flops.add += !first;
+      first = 0;
+    }
+    if(print) {
+      printf(first ? "0\n" : "\n");
+    }
+  }
+  if(print) {
+    printf("  };\n");
+    printf("}\n");
+  }
+  free(name);
+  return flops;
+}
+
+// the same, once the sandwich was written as r x then (r x) ~r
+Flops _sandwich_product_flops(int x_grades, int r_grades, int z_grades) {
+  int p_grades = _soa_grades(OP_GEOMETRIC_PRODUCT, r_grades, x_grades);
+  Flops a = _product_flops(OP_GEOMETRIC_PRODUCT, r_grades, x_grades, p_grades);
+  Flops b = _product_flops(OP_GEOMETRIC_PRODUCT, p_grades, r_grades, z_grades);
+  return (Flops){a.mul + b.mul, a.add + b.add};
+}
+
+// <x ~x>_0 with the conjugate, the square of the norm of the math header
+Flops _norm_squared(int x_code, int print) {
+  Flops flops = {0, 0};
+  char x_type[num_grades + 1];
+  _type_code(codes[x_code].grades, x_type);
+  if(print) {
+    printf("static inline float %s_norm_squared_%c(%s_%s x) {\n", prefix, codes[x_code].code, prefix, x_type);
+    printf("  return ");
+  }
+  int first = 1;
+  for(int a = 0; a < num_basis; a++) {
+    if(!(codes[x_code].grades & (1 << basis[a].grade))) {
+      continue;
+    }
+    // the conjugate only flips signs, so x_a pairs with itself
+    BasisRef c = _cayley_table[a * num_basis + a];
+    int sign = c.sign * ((basis[a].grade + 1) % 4 < 2 ? 1 : -1);
+    if(sign == 0) {
+      continue;
+    }
+    if(print) {
+      printf("%sx.%s * x.%s", first ? (sign < 0 ? "-" : "") : (sign < 0 ? " - " : " + "), basis[a].name, basis[a].name);
+    }
+    flops.mul++;
+    flops.add += !first;
+    first = 0;
+  }
+  if(print) {
+    printf(first ? "0;\n}\n" : ";\n}\n");
+  }
+  return flops;
+}
+
+void generate_fused(void) {
+  for(int i = 0; i < num_codes; i++) {
+    for(int j = 0; j < num_codes; j++) {
+      int z_grades = _sandwich_expand(codes[i].grades, codes[j].grades);
+      if(z_grades == 0) {
+        continue;
+      }
+      Flops products = _sandwich_product_flops(codes[i].grades, codes[j].grades, z_grades);
+      Flops fused = _sandwich(i, j, z_grades, 0);
+      printf("// %i mul %i add, %i mul %i add as two products\n", fused.mul, fused.add, products.mul, products.add);
+      _sandwich(i, j, z_grades, 1);
+    }
+  }
+  for(int i = 0; i < num_codes; i++) {
+    _norm_squared(i, 1);
+  }
+}
+
+// multiplies and adds of every product and fused operation
+void generate_report(void) {
+  printf("%-24s %-8s %6s %6s %12s %12s\n", "operation", "operands", "mul", "add", "product mul", "product add");
+  for(enum Op o = OP_GEOMETRIC_PRODUCT; o < NUM_OPS; o++) {
+    for(int i = 0; i < num_codes; i++) {
+      for(int j = 0; j < num_codes; j++) {
+        int z_grades = _soa_grades(o, codes[i].grades, codes[j].grades);
+        if(z_grades == 0) {
+          continue;
+        }
+        Flops flops = _product_flops(o, codes[i].grades, codes[j].grades, z_grades);
+        printf("%-24s %c%-7c %6i %6i\n", op[o].lower, codes[i].code, codes[j].code, flops.mul, flops.add);
+      }
+    }
+  }
+  Flops total_fused = {0, 0}, total_products = {0, 0};
+  for(int i = 0; i < num_codes; i++) {
+    for(int j = 0; j < num_codes; j++) {
+      int z_grades = _sandwich_expand(codes[i].grades, codes[j].grades);
+      if(z_grades == 0) {
+        continue;
+      }
+      Flops products = _sandwich_product_flops(codes[i].grades, codes[j].grades, z_grades);
+      Flops fused = _sandwich(i, j, z_grades, 0);
+      printf("%-24s %c%-7c %6i %6i %12i %12i\n", "sandwich", codes[i].code, codes[j].code, fused.mul, fused.add, products.mul, products.add);
+      total_fused.mul += fused.mul;
+      total_fused.add += fused.add;
+      total_products.mul += products.mul;
+      total_products.add += products.add;
+    }
+  }
+  for(int i = 0; i < num_codes; i++) {
+    int grades = codes[i].grades;
+    Flops fused = _norm_squared(i, 0);
+    Flops products = _product_flops(OP_GEOMETRIC_PRODUCT, grades, grades, 1);
+    printf("%-24s %-8c %6i %6i %12i %12i\n", "norm_squared", codes[i].code, fused.mul, fused.add, products.mul, products.add);
+    total_fused.mul += fused.mul;
+    total_fused.add += fused.add;
+    total_products.mul += products.mul;
+    total_products.add += products.add;
+  }
+  printf("%-24s %-8s %6i %6i %12i %12i\n", "fused total", "", total_fused.mul, total_fused.add, total_products.mul, total_products.add);
+}
+
+// ====================================================================================================================
+// benchmark
+//
+// a program timing every operation of the headers, each code pair through the
+// macros one row at a time, through the batch kernel over the whole array and
+// through the fixed point function one row at a time
+const char *benchmark_header = "#include <stdio.h>\n"
+                               "#include <stdlib.h>\n"
+                               "#include <string.h>\n"
+                               "#include <stdint.h>\n"
+                               "#include <time.h>\n"
+                               "\n"
+                               "#include \"generated/%2$s.h\"\n"
+                               "#include \"generated/%2$s_soa.h\"\n"
+                               "#include \"../src/fixed_point.h\"\n"
+                               "#include \"generated/%2$s_fixed.h\"\n"
+                               "\n"
+                               "#define COUNT (1 << 14)\n"
+                               "#define REPEAT 64\n"
+                               "\n"
+                               "static float _xs[%3$i][COUNT], _ys[%3$i][COUNT], _zs[%3$i][COUNT];\n"
+                               "static float _z[%3$i * COUNT];\n"
+                               "static FixedPoint16 _fz[%3$i * COUNT];\n"
+                               "static const char * _filter;\n"
+                               "\n"
+                               "static uint64_t _now(void) {\n"
+                               "  struct timespec ts;\n"
+                               "  clock_gettime(CLOCK_MONOTONIC, &ts);\n"
+                               "  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;\n"
+                               "}\n"
+                               "\n"
+                               "static float _random(void) {\n"
+                               "  static uint32_t state = 2463534242;\n"
+                               "  state ^= state << 13;\n"
+                               "  state ^= state >> 17;\n"
+                               "  state ^= state << 5;\n"
+                               "  return (float)(state >> 8) / (1 << 24) * 2 - 1;\n"
+                               "}\n"
+                               "\n"
+                               "static int _skip(const char * name) {\n"
+                               "  return _filter != NULL && strstr(name, _filter) == NULL;\n"
+                               "}\n"
+                               "\n"
+                               "// keeps the repeats from being folded into one\n"
+                               "#define _BARRIER() __asm__ volatile(\"\" ::: \"memory\")\n"
+                               "\n"
+                               "static void _column(uint64_t time) {\n"
+                               "  if(time) {\n"
+                               "    printf(\" %%10.3f\", time / ((double)COUNT * REPEAT));\n"
+                               "  } else {\n"
+                               "    printf(\" %%10s\", \"-\");\n"
+                               "  }\n"
+                               "}\n"
+                               "\n"
+                               "static void _report(const char * name, const char * operands, uint64_t scalar, uint64_t batch, uint64_t fixed) {\n"
+                               "  printf(\"%%-24s %%-8s\", name, operands);\n"
+                               "  _column(scalar);\n"
+                               "  _column(batch);\n"
+                               "  _column(fixed);\n"
+                               "  printf(\"\\n\");\n"
+                               "}\n"
+                               "\n";
+
+void _benchmark_soa(char side, int grades) {
+  char type[num_grades + 1];
+  _type_code(grades, type);
+  printf("  %s_%s_soa %cs = {", prefix, type, side);
+  int first = 1;
+  for(int j = 0; j < num_basis; j++) {
+    if(grades & (1 << basis[j].grade)) {
+      printf("%s _%cs[%i]", first ? "" : ",", side, j);
+      first = 0;
+    }
+  }
+  printf(" };\n");
+}
+
+// the argument of a code macro, scalars go in as floats
+void _benchmark_argument(char side, int code) {
+  printf(codes[code].grades == 1 ? "_%c_%c[i].one" : "_%c_%c[i]", side, codes[code].code);
+}
+
+void _benchmark_fixed(enum Op o, int x_code, int y_code, const char *z_type) {
+  char operands[3] = {codes[x_code].code, y_code >= 0 ? codes[y_code].code : 0, 0};
+  printf("  %s_%s_fixed * zf = (%s_%s_fixed *)_fz;\n", prefix, z_type, prefix, z_type);
+  printf("  start = _now();\n");
+  printf("  for(int r = 0; r < REPEAT; r++) {\n");
+  printf("    for(uint32_t i = 0; i < COUNT; i++) {\n");
+  printf("      zf[i] = %s_%s_%s_fixed(_xf_%c[i]", prefix, op[o].lower, operands, codes[x_code].code);
+  if(y_code >= 0) {
+    printf(", _yf_%c[i]", codes[y_code].code);
+  }
+  printf(");\n");
+  printf("    }\n");
+  printf("    _BARRIER();\n");
+  printf("  }\n");
+}
+
+// y_code is -1 for unary operations
+void _benchmark_op(enum Op o, int x_code, int y_code) {
+  int x_grades = codes[x_code].grades;
+  int y_grades = y_code >= 0 ? codes[y_code].grades : 0;
+  int z_grades = _soa_grades(o, x_grades, y_grades);
+  if(z_grades == 0) {
+    return;
+  }
+  char z_type[num_grades + 1], operands[3] = {codes[x_code].code, y_code >= 0 ? codes[y_code].code : 0, 0};
+  _type_code(z_grades, z_type);
+
+  printf("static void _benchmark_%s_%s(void) {\n", op[o].lower, operands);
+  printf("  if(_skip(\"%s\")) {\n", op[o].lower);
+  printf("    return;\n");
+  printf("  }\n");
+  printf("  %s_%s * z = (%s_%s *)_z;\n", prefix, z_type, prefix, z_type);
+  printf("  uint64_t start = _now();\n");
+  printf("  for(int r = 0; r < REPEAT; r++) {\n");
+  printf("    for(uint32_t i = 0; i < COUNT; i++) {\n");
+  printf("      z[i] = %s_%s_%s(", prefix, op[o].lower, operands);
+  _benchmark_argument('x', x_code);
+  if(y_code >= 0) {
+    printf(", ");
+    _benchmark_argument('y', y_code);
+  }
+  printf(");\n");
+  printf("    }\n");
+  printf("    _BARRIER();\n");
+  printf("  }\n");
+  printf("  uint64_t scalar = _now() - start;\n");
+  _benchmark_soa('x', x_grades);
+  if(y_code >= 0) {
+    _benchmark_soa('y', y_grades);
+  }
+  _benchmark_soa('z', z_grades);
+  printf("  start = _now();\n");
+  printf("  for(int r = 0; r < REPEAT; r++) {\n");
+  printf("    %s_%s_%s_soa(zs, xs, %sCOUNT);\n", prefix, op[o].lower, operands, y_code >= 0 ? "ys, " : "");
+  printf("    _BARRIER();\n");
+  printf("  }\n");
+  printf("  uint64_t batch = _now() - start;\n");
+  _benchmark_fixed(o, x_code, y_code, z_type);
+  printf("  _report(\"%s\", \"%s\", scalar, batch, _now() - start);\n", op[o].lower, operands);
+  printf("}\n");
+}
+
+void _benchmark_fused(const char *name, int x_code, int r_code) {
+  char operands[3] = {codes[x_code].code, r_code >= 0 ? codes[r_code].code : 0, 0};
+  printf("static void _benchmark_%s_%s(void) {\n", name, operands);
+  printf("  if(_skip(\"%s\")) {\n", name);
+  printf("    return;\n");
+  printf("  }\n");
+  printf("  uint64_t start = _now();\n");
+  printf("  for(int r = 0; r < REPEAT; r++) {\n");
+  printf("    for(uint32_t i = 0; i < COUNT; i++) {\n");
+  if(r_code >= 0) {
+    printf("      __auto_type z = %s_%s_%s(_x_%c[i], _y_%c[i]);\n", prefix, name, operands, codes[x_code].code, codes[r_code].code);
+    printf("      memcpy(_z + i * %i, &z, sizeof(z));\n", num_basis);
+  } else {
+    printf("      _z[i] = %s_%s_%s(_x_%c[i]);\n", prefix, name, operands, codes[x_code].code);
+  }
+  printf("    }\n");
+  printf("    _BARRIER();\n");
+  printf("  }\n");
+  printf("  _report(\"%s\", \"%s\", _now() - start, 0, 0);\n", name, operands);
+  printf("}\n");
+}
+
+void generate_benchmark(void) {
+  printf(benchmark_header, PREFIX, prefix, num_basis);
+
+  for(int i = 0; i < num_codes; i++) {
+    char type[num_grades + 1];
+    _type_code(codes[i].grades, type);
+    printf("static %s_%s _x_%c[COUNT], _y_%c[COUNT];\n", prefix, type, codes[i].code, codes[i].code);
+    printf("static %s_%s_fixed _xf_%c[COUNT], _yf_%c[COUNT];\n", prefix, type, codes[i].code, codes[i].code);
+  }
+  printf("\n");
+
+  for(enum Op o = 0; o < NUM_OPS; o++) {
+    if(!_batch_op(o)) {
+      continue;
+    }
+    for(int i = 0; i < num_codes; i++) {
+      if(op[o].argument_count == 1) {
+        _benchmark_op(o, i, -1);
+        continue;
+      }
+      for(int j = 0; j < num_codes; j++) {
+        _benchmark_op(o, i, j);
+      }
+    }
+  }
+  for(int i = 0; i < num_codes; i++) {
+    for(int j = 0; j < num_codes; j++) {
+      if(_sandwich_expand(codes[i].grades, codes[j].grades)) {
+        _benchmark_fused("sandwich", i, j);
+      }
+    }
+    _benchmark_fused("norm_squared", i, -1);
+  }
+
+  printf("\nint main(int argc, char * argv[]) {\n");
+  printf("  _filter = argc > 1 ? argv[1] : NULL;\n");
+  printf("  for(int b = 0; b < %i; b++) {\n", num_basis);
+  printf("    for(uint32_t i = 0; i < COUNT; i++) {\n");
+  printf("      _xs[b][i] = _random();\n");
+  printf("      _ys[b][i] = _random();\n");
+  printf("    }\n");
+  printf("  }\n");
+  printf("  for(uint32_t i = 0; i < COUNT; i++) {\n");
+  for(int i = 0; i < num_codes; i++) {
+    for(int j = 0; j < num_basis; j++) {
+      if(codes[i].grades & (1 << basis[j].grade)) {
+        printf("    _x_%c[i].%s = _xs[%i][i];\n", codes[i].code, basis[j].name, j);
+        printf("    _y_%c[i].%s = _ys[%i][i];\n", codes[i].code, basis[j].name, j);
+      }
+    }
+    printf("    _xf_%c[i] = %s_to_fixed_%c(_x_%c[i]);\n", codes[i].code, prefix, codes[i].code, codes[i].code);
+    printf("    _yf_%c[i] = %s_to_fixed_%c(_y_%c[i]);\n", codes[i].code, prefix, codes[i].code, codes[i].code);
+  }
+  printf("  }\n");
+  printf("  printf(\"%%-24s %%-8s %%10s %%10s %%10s\\n\", \"%s\", \"operands\", \"ns scalar\", \"ns batch\", \"ns fixed\");\n", prefix);
+  for(enum Op o = 0; o < NUM_OPS; o++) {
+    if(!_batch_op(o)) {
+      continue;
+    }
+    for(int i = 0; i < num_codes; i++) {
+      for(int j = op[o].argument_count == 1 ? -1 : 0; j < (op[o].argument_count == 1 ? 0 : num_codes); j++) {
+        if(_soa_grades(o, codes[i].grades, j >= 0 ? codes[j].grades : 0)) {
+          printf("  _benchmark_%s_%c", op[o].lower, codes[i].code);
+          printf(j >= 0 ? "%c();\n" : "();\n", j >= 0 ? codes[j].code : 0);
+        }
+      }
+    }
+  }
+  for(int i = 0; i < num_codes; i++) {
+    for(int j = 0; j < num_codes; j++) {
+      if(_sandwich_expand(codes[i].grades, codes[j].grades)) {
+        printf("  _benchmark_sandwich_%c%c();\n", codes[i].code, codes[j].code);
+      }
+    }
+    printf("  _benchmark_norm_squared_%c();\n", codes[i].code);
+  }
+  printf("  return 0;\n");
+  printf("}\n");
+}
+
 void generate(void) {
   first_basis = d ? '0' : '1';
   num_dimensions = p + n + d;
   num_grades = 1 + num_dimensions;
   num_basis = 1 << num_dimensions;
 
-  printf(header, PREFIX, p, n, d, num_dimensions, num_grades);
+  if(simd) {
+    printf(soa_header, PREFIX);
+  } else if(fixed) {
+    printf(fixed_header, PREFIX, prefix);
+  } else if(!report && !benchmark) {
+    printf(header, PREFIX, p, n, d, num_dimensions, num_grades);
+  }
 
   basis = calloc(num_basis, sizeof(*basis));
   basis_by_bits = calloc(num_basis, sizeof(*basis_by_bits));
@@ -305,12 +1567,31 @@ void generate(void) {
     printf("\n");
   }
 
+  if(simd) {
+    generate_soa();
+    return;
+  }
+
+  if(fixed) {
+    generate_fixed();
+    return;
+  }
+
+  if(report) {
+    _grade_codes();
+    generate_report();
+    return;
+  }
+
+  if(benchmark) {
+    _grade_codes();
+    generate_benchmark();
+    return;
+  }
+
   str_build = calloc(num_grades + 1, sizeof(*str_build));
   for(int i = 0; i < 1 << num_grades; i++) {
-    char *s = str_build;
-    for(int j = 0; j < num_grades; j++) {
-      *s++ = (i & (1 << j)) ? '1' : '0';
-    }
+    _type_code(i, str_build);
 
     printf("typedef struct %s_%s {", prefix, str_build);
     printf(" union { ");
@@ -328,25 +1609,7 @@ void generate(void) {
     }
     printf("}; } %s_%s", prefix, str_build);
 
-    if(i == 1 << 0) {
-      printf(", %s_Scalar", prefix);
-    } else if(i == 1 << 1) {
-      printf(", %s_Vector", prefix);
-    } else if(i == 1 << 2) {
-      printf(", %s_Bivector", prefix);
-    } else if(i == 1 << 3) {
-      printf(", %s_Trivector", prefix);
-    }
-
-    if(i == 1 << (num_grades - 1)) {
-      printf(", %s_AntiScalar", prefix);
-    } else if(i == 1 << (num_grades - 2)) {
-      printf(", %s_AntiVector", prefix);
-    } else if(i == 1 << (num_grades - 3)) {
-      printf(", %s_AntiBivector", prefix);
-    } else if(i == 1 << (num_grades - 4)) {
-      printf(", %s_AntiTrivector", prefix);
-    }
+    _type_names(i, "");
 
     printf(";\n");
   }
@@ -461,117 +1724,12 @@ void generate(void) {
     printf("  , ## __VA_ARGS__)\n");
   }
 
-  // negate
-  printf("#define %s_OP_NEGATE(RETURN, ", PREFIX);
-  values('X');
-  printf(", ...) RETURN(" NL);
-  for(int i = 0; i < num_basis; i++) {
-    printf("%s%s_NEG(X%s)" NL, i ? "  , " : "    ", PREFIX, basis[i].name);
-  }
-  printf("  , ## __VA_ARGS__)\n");
-
-  // dual
-  printf("#define %s_OP_DUAL(RETURN, ", PREFIX);
-  values('X');
-  printf(", ...) RETURN(" NL);
-  for(int i = 0; i < num_basis; i++) {
-    BasisRef dual = _dual((BasisRef){.basis = i, .sign = 1});
-    printf(i ? "  , " : "    ");
-    if(dual.sign == -1) {
-      printf("%s_NEG(X%s)", PREFIX, basis[dual.basis].name);
-    } else if(dual.sign == 1) {
-      printf("X%s", basis[dual.basis].name);
-    } else {
-      printf("0");
-    }
-    printf(NL);
-  }
-  printf("  , ## __VA_ARGS__)\n");
-
-  // undual
-  printf("#define %s_OP_UNDUAL(RETURN, ", PREFIX);
-  values('X');
-  printf(", ...) RETURN(" NL);
-  for(int i = 0; i < num_basis; i++) {
-    BasisRef dual = _dual((BasisRef){.basis = i, .sign = 1});
-    BasisRef dual2 = _dual((BasisRef){.basis = num_basis - i - 1, .sign = 1});
-    printf(i ? "  , " : "    ");
-    if(dual2.sign == -1) {
-      printf("%s_NEG(X%s)", PREFIX, basis[dual.basis].name);
-    } else if(dual2.sign == 1) {
-      printf("X%s", basis[dual.basis].name);
-    } else {
-      printf("0");
-    }
-    printf(NL);
-  }
-  printf("  , ## __VA_ARGS__)\n");
-
-  // polar
-  if(d) {
-    printf("#define %s_OP_POLAR(RETURN, ", PREFIX);
-    values('X');
-    printf(", ...) RETURN(" NL);
-    for(int i = 0; i < num_basis; i++) {
-      for(int j = 0; j < num_basis; j++) {
-        BasisRef polar = _mul_basis_ref((BasisRef){.basis = j, .sign = 1}, (BasisRef){.basis = num_basis - 1, .sign = 1});
-        if(polar.basis != i) {
-          continue;
-        }
-
-        printf(i ? "  , " : "    ");
-        if(polar.sign == -1) {
-          printf("%s_NEG(X%s)", PREFIX, basis[polar.basis].name);
-        } else if(polar.sign == 1) {
-          printf("X%s", basis[polar.basis].name);
-        } else {
-          printf("0");
-        }
-      }
-
-      printf(NL);
-    }
-    printf("  , ## __VA_ARGS__)\n");
-  }
-
-  // reverse
-  printf("#define %s_OP_REVERSE(RETURN, ", PREFIX);
-  values('X');
-  printf(", ...) RETURN(" NL);
-  for(int i = 0; i < num_basis; i++) {
-    if(basis[i].grade % 4 < 2) {
-      printf("%sX%s" NL, i ? "  , " : "    ", basis[i].name);
-    } else {
-      printf("%s%s_NEG(X%s)" NL, i ? "  , " : "    ", PREFIX, basis[i].name);
-    }
-  }
-  printf("  , ## __VA_ARGS__)\n");
-
-  // involute
-  printf("#define %s_OP_INVOLUTE(RETURN, ", PREFIX);
-  values('X');
-  printf(", ...) RETURN(" NL);
-  for(int i = 0; i < num_basis; i++) {
-    if(basis[i].grade % 2 < 1) {
-      printf("%sX%s" NL, i ? "  , " : "    ", basis[i].name);
-    } else {
-      printf("%s%s_NEG(X%s)" NL, i ? "  , " : "    ", PREFIX, basis[i].name);
-    }
-  }
-  printf("  , ## __VA_ARGS__)\n");
-
-  // conjugate
-  printf("#define %s_OP_CONJUGATE(RETURN, ", PREFIX);
-  values('X');
-  printf(", ...) RETURN(" NL);
-  for(int i = 0; i < num_basis; i++) {
-    if((basis[i].grade + 1) % 4 < 2) {
-      printf("%sX%s" NL, i ? "  , " : "    ", basis[i].name);
-    } else {
-      printf("%s%s_NEG(X%s)" NL, i ? "  , " : "    ", PREFIX, basis[i].name);
+  for(enum Op o = OP_NEGATE; o <= OP_CONJUGATE; o++) {
+    // polar needs the degenerate metric
+    if(o != OP_POLAR || d) {
+      _unary_macro(o);
     }
   }
-  printf("  , ## __VA_ARGS__)\n");
 
   // binary
   printf("#define %s_BINARY(OP, X, Y) %s_BINARY0(OP, %s_UNPACK X, %s_UNPACK Y)\n", PREFIX, PREFIX, PREFIX, PREFIX);
@@ -676,215 +1834,12 @@ void generate(void) {
   }
   printf("  , ## __VA_ARGS__)\n");
 
-  // geometric product
-  printf("#define %s_OP_GEOMETRIC_PRODUCT(RETURN, ", PREFIX);
-  values('X');
-  printf(", ");
-  values('Y');
-  printf(", ...) RETURN(" NL);
-  for(int i = 0; i < num_basis; i++) {
-    printf("  %s0", i ? ", " : "  ");
-    BasisRef c = (BasisRef){i, 1};
-    for(int j = 0; j < num_basis; j++) {
-      BasisRef a = (BasisRef){j, 1};
-      BasisRef b = _product_table[c.basis * num_basis + a.basis];
-      if(b.sign == -1) {
-        printf(" %s_SUB_MUL(X%s,Y%s)", PREFIX, basis[a.basis].name, basis[b.basis].name);
-      } else if(b.sign == 1) {
-        printf(" %s_ADD_MUL(X%s,Y%s)", PREFIX, basis[a.basis].name, basis[b.basis].name);
-      }
-    }
-    printf(NL);
-  }
-  printf("  , ## __VA_ARGS__)\n");
-
-  // outer product
-  printf("#define %s_OP_OUTER_PRODUCT(RETURN, ", PREFIX);
-  values('X');
-  printf(", ");
-  values('Y');
-  printf(", ...) RETURN(" NL);
-  for(int i = 0; i < num_basis; i++) {
-    printf("  %s0", i ? ", " : "  ");
-    BasisRef c = (BasisRef){i, 1};
-    for(int j = 0; j < num_basis; j++) {
-      BasisRef a = (BasisRef){j, 1};
-      BasisRef b = _product_table[c.basis * num_basis + a.basis];
-      if(basis[a.basis].grade + basis[b.basis].grade != basis[c.basis].grade) {
-        continue;
-      }
-      if(b.sign == -1) {
-        printf(" %s_SUB_MUL(X%s,Y%s)", PREFIX, basis[a.basis].name, basis[b.basis].name);
-      } else if(b.sign == 1) {
-        printf(" %s_ADD_MUL(X%s,Y%s)", PREFIX, basis[a.basis].name, basis[b.basis].name);
-      }
-    }
-    printf(NL);
-  }
-  printf("  , ## __VA_ARGS__)\n");
-
-  // regressive product
-  printf("#define %s_OP_REGRESSIVE_PRODUCT(RETURN, ", PREFIX);
-  values('X');
-  printf(", ");
-  values('Y');
-  printf(", ...) RETURN(" NL);
-  for(int i = 0; i < num_basis; i++) {
-    printf("  %s0", i ? ", " : "  ");
-
-    // instead of the Product table use Cayley table and select based on output
-    for(int j = 0; j < num_basis; j++) {
-      BasisRef a = (BasisRef){j, 1}, ad = _dual(a);
-
-      for(int k = 0; k < num_basis; k++) {
-        BasisRef b = (BasisRef){k, 1}, bd = _dual(b);
-
-        BasisRef c = _cayley_table[ad.basis * num_basis + bd.basis], cd = _dual(c);
-
-        // limit output to dual basis
-        if(cd.basis != i) {
-          continue;
-        }
-
-        // and then non-dual grade selection of outer product
-        if(basis[ad.basis].grade + basis[bd.basis].grade != basis[c.basis].grade) {
-          continue;
-        }
-
-        int sign = ad.sign * bd.sign * c.sign * cd.sign;
-
-        if(sign == -1) {
-          printf(" %s_SUB_MUL(X%s,Y%s)", PREFIX, basis[a.basis].name, basis[b.basis].name);
-        } else if(sign == 1) {
-          printf(" %s_ADD_MUL(X%s,Y%s)", PREFIX, basis[a.basis].name, basis[b.basis].name);
-        }
-      }
-    }
-    printf(NL);
-  }
-  printf("  , ## __VA_ARGS__)\n");
-
-  // commutator product
-  printf("#define %s_OP_COMMUTATOR_PRODUCT(RETURN, ", PREFIX);
-  values('X');
-  printf(", ");
-  values('Y');
-  printf(", ...) RETURN(" NL);
-  for(int i = 0; i < num_basis; i++) {
-    printf("  %s0", i ? ", " : "  ");
-    BasisRef c = (BasisRef){i, 1};
-
-    // instead of the Product table use Cayley table and select based on output
-    for(int j = 0; j < num_basis; j++) {
-      BasisRef a = (BasisRef){j, 1};
-
-      for(int k = 0; k < num_basis; k++) {
-        BasisRef b = (BasisRef){k, 1};
-
-        BasisRef ab = _cayley_table[a.basis * num_basis + b.basis];
-        BasisRef ba = _cayley_table[b.basis * num_basis + a.basis];
-
-        if(ab.basis == ba.basis && ab.sign == ba.sign) {
-          continue;
-        }
-
-        if(ab.basis != c.basis) {
-          continue;
-        }
-
-        if(ab.sign == -1) {
-          printf(" %s_SUB_MUL(X%s,Y%s)", PREFIX, basis[a.basis].name, basis[b.basis].name);
-        } else if(ab.sign == 1) {
-          printf(" %s_ADD_MUL(X%s,Y%s)", PREFIX, basis[a.basis].name, basis[b.basis].name);
-        }
-      }
-    }
-    printf(NL);
-  }
-  printf("  , ## __VA_ARGS__)\n");
-
-  // inner product
-  printf("#define %s_OP_INNER_PRODUCT(RETURN, ", PREFIX);
-  values('X');
-  printf(", ");
-  values('Y');
-  printf(", ...) RETURN(" NL);
-  for(int i = 0; i < num_basis; i++) {
-    printf("  %s0", i ? ", " : "  ");
-    BasisRef c = (BasisRef){i, 1};
-    for(int j = 0; j < num_basis; j++) {
-      BasisRef a = (BasisRef){j, 1};
-      BasisRef b = _product_table[c.basis * num_basis + a.basis];
-      if(abs(basis[b.basis].grade - basis[a.basis].grade) != basis[c.basis].grade) {
-        continue;
-      }
-      if(b.sign == -1) {
-        printf(" %s_SUB_MUL(X%s,Y%s)", PREFIX, basis[a.basis].name, basis[b.basis].name);
-      } else if(b.sign == 1) {
-        printf(" %s_ADD_MUL(X%s,Y%s)", PREFIX, basis[a.basis].name, basis[b.basis].name);
-      }
-    }
-    printf(NL);
-  }
-  printf("  , ## __VA_ARGS__)\n");
-
-  // left dot
-  printf("#define %s_OP_LEFT_DOT_PRODUCT(RETURN, ", PREFIX);
-  values('X');
-  printf(", ");
-  values('Y');
-  printf(", ...) RETURN(" NL);
-  for(int i = 0; i < num_basis; i++) {
-    printf("  %s0", i ? ", " : "  ");
-    BasisRef c = (BasisRef){i, 1};
-    for(int j = 0; j < num_basis; j++) {
-      BasisRef a = (BasisRef){j, 1};
-      BasisRef b = _product_table[c.basis * num_basis + a.basis];
-      if((basis[b.basis].grade - basis[a.basis].grade) != basis[c.basis].grade) {
-        continue;
-      }
-      if(b.sign == -1) {
-        printf(" %s_SUB_MUL(X%s,Y%s)", PREFIX, basis[a.basis].name, basis[b.basis].name);
-      } else if(b.sign == 1) {
-        printf(" %s_ADD_MUL(X%s,Y%s)", PREFIX, basis[a.basis].name, basis[b.basis].name);
-      }
-    }
-    printf(NL);
+  for(enum Op o = OP_GEOMETRIC_PRODUCT; o <= OP_LEFT_DOT_PRODUCT; o++) {
+    _binary_macro(o);
   }
-  printf("  , ## __VA_ARGS__)\n");
 
   // cpp interface
-  // type coding
-  char gcodes[] = "svbtq___";
-  if(num_grades > 5) {
-    gcodes[num_grades - 2] = 'V';
-  }
-  gcodes[num_grades - 1] = 'S';
-  gcodes[num_grades] = 0;
-
-  for(int i = 0; i < num_grades; i++) {
-    _add_code(gcodes[i], 1 << i);
-  }
-
-  struct {
-    const char *lower;
-    const char *upper;
-    int argument_count;
-  } op[] = {{"negate", "NEGATE", 1},
-            {"dual", "DUAL", 1},
-            {"undual", "UNDUAL", 1},
-            {"polar", "POLAR", 1},
-            {"reverse", "REVERSE", 1},
-            {"involute", "INVOLUTE", 1},
-            {"conjugate", "CONJUGATE", 1},
-            {"add", "ADD", 2},
-            {"subtract", "SUBTRACT", 2},
-            {"geometric_product", "GEOMETRIC_PRODUCT", 2},
-            {"outer_product", "OUTER_PRODUCT", 2},
-            {"regressive_product", "REGRESSIVE_PRODUCT", 2},
-            {"commutator_product", "COMMUTATOR_PRODUCT", 2},
-            {"inner_product", "INNER_PRODUCT", 2},
-            {"left_dot_product", "LEFT_DOT_PRODUCT", 2}};
+  _grade_codes();
 
   if(d == 0) {
     op[2].lower = NULL;
@@ -946,6 +1901,8 @@ void generate(void) {
     }
   }
 
+  generate_fused();
+
   printf("#endif // _%s_H_\n", PREFIX);
 }
 
@@ -957,7 +1914,9 @@ int main(int argc, char *argv[]) {
   struct option longopts[] = {{"positive", required_argument, NULL, 'p'},   {"negative", required_argument, NULL, 'n'},
                               {"degenerate", required_argument, NULL, 'd'}, {"prefix", required_argument, NULL, 0},
                               {"unary", required_argument, NULL, 0},        {"binary", required_argument, NULL, 0},
-                              {"code", required_argument, NULL, 0},         {NULL, no_argument, NULL, 0}};
+                              {"code", required_argument, NULL, 0},         {"simd", no_argument, NULL, 0},
+                              {"report", no_argument, NULL, 0},             {"benchmark", no_argument, NULL, 0},
+                              {"fixed", no_argument, NULL, 0},              {NULL, no_argument, NULL, 0}};
 
   printf("%s", license);
   printf("// generated with gen_geometric_algebra (author Sarah Burns <mystical.unicat@gmail.com>)\n");
@@ -995,7 +1954,20 @@ int main(int argc, char *argv[]) {
           grades |= (1 << (optarg[i] - '0'));
         }
         _add_code(optarg[0], grades);
+        break;
       }
+      case 7:
+        simd = 1;
+        break;
+      case 8:
+        report = 1;
+        break;
+      case 9:
+        benchmark = 1;
+        break;
+      case 10:
+        fixed = 1;
+        break;
       default:
         break;
       }